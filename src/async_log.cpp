@@ -0,0 +1,239 @@
+#include "async_log.h"
+#include "util.h"
+#include <chrono>
+#include <algorithm>
+
+namespace orange {
+
+const char* AsyncLogWriter::ToString(Policy policy) {
+    switch (policy)
+    {
+#define XX(name) \
+    case AsyncLogWriter::name : \
+    return #name
+
+    XX(BLOCK);
+    XX(DROP_OLDEST);
+    XX(DROP_NEWEST);
+#undef XX
+    default:
+        return "BLOCK";
+    }
+}
+
+AsyncLogWriter::Policy AsyncLogWriter::FromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::toupper);
+#define XX(name) \
+    if(v == #name) { \
+        return AsyncLogWriter::name; \
+    }
+
+    XX(BLOCK);
+    XX(DROP_OLDEST);
+    XX(DROP_NEWEST);
+#undef XX
+    return AsyncLogWriter::BLOCK;
+}
+
+AsyncLogWriter::AsyncLogWriter(write_cb write, flush_cb flush, const Config& config)
+    : m_write(write)
+    , m_flush(flush)
+    , m_config(config) {
+    if(m_config.buffer_size == 0) {
+        m_config.buffer_size = Config().buffer_size;
+    }
+    if(m_config.buffer_count == 0) {
+        m_config.buffer_count = 1;
+    }
+    if(m_config.flush_interval == 0) {
+        m_config.flush_interval = Config().flush_interval;
+    }
+    m_current = takeFree(0);
+    m_thread = std::thread(std::bind(&AsyncLogWriter::run, this));
+}
+
+AsyncLogWriter::AsyncLogWriter(write_cb write, flush_cb flush)
+    : AsyncLogWriter(write, flush, Config()) {
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cond.notify_one();
+    }
+    m_thread.join();
+}
+
+void AsyncLogWriter::append(const char* data, size_t len) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_current->avail() < len && !rotate(lock, len)) {
+        ++m_dropped;
+        return;
+    }
+    m_current->append(data, len);
+    m_queued += len;
+    if(m_queued > m_highWater) {
+        m_highWater = m_queued;
+    }
+}
+
+void AsyncLogWriter::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // 必须等到flush之后取走的那一批写完，才能保证之前追加的数据都已写出
+    uint64_t need = m_takenBatch + 1;
+    m_flushRequested = true;
+    m_cond.notify_one();
+    m_written.wait(lock, [this, need]() { return m_writtenBatch >= need; });
+}
+
+void AsyncLogWriter::requestFlush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_flushRequested) {
+        m_flushRequested = true;
+        m_cond.notify_one();
+    }
+}
+
+void AsyncLogWriter::drainTo(int fd) {
+    for(auto& i : m_pending) {
+        if(i) {
+            WriteAll(fd, i->data(), i->size());
+        }
+    }
+    Buffer* current = m_current.get();
+    if(current) {
+        WriteAll(fd, current->data(), current->size());
+    }
+}
+
+uint64_t AsyncLogWriter::getHighWater() const {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_highWater;
+}
+
+uint64_t AsyncLogWriter::getDropped() const {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_dropped;
+}
+
+bool AsyncLogWriter::rotate(std::unique_lock<std::mutex>& lock, size_t len) {
+    // 前台缓冲区本身占一块，超长日志多出来的部分计入积压
+    size_t extra = units(len) - 1;
+    if(extra > m_config.buffer_count) {
+        return false;
+    }
+    while(m_current->avail() < len) {
+        if(m_current->size() == 0) {
+            // 空缓冲区也放不下，说明是一条超长日志，单独分配一块
+            if(m_backlog + extra <= m_config.buffer_count) {
+                recycle(std::move(m_current));
+                m_current = takeFree(len);
+                return true;
+            }
+        } else if(m_backlog + units(m_current->capacity()) + extra <= m_config.buffer_count) {
+            m_backlog += units(m_current->capacity());
+            m_pending.push_back(std::move(m_current));
+            m_current = takeFree(len);
+            m_cond.notify_one();
+            return true;
+        }
+
+        switch(m_config.policy) {
+            case DROP_OLDEST:
+                // 只剩后台线程正在写的批次时没有可丢的，丢弃当前日志
+                if(m_pending.empty()) {
+                    return false;
+                }
+                m_dropped += m_pending.front()->records();
+                m_queued -= m_pending.front()->size();
+                m_backlog -= units(m_pending.front()->capacity());
+                recycle(std::move(m_pending.front()));
+                m_pending.pop_front();
+                break;
+            case DROP_NEWEST:
+                return false;
+            default:
+                // 被唤醒后前台缓冲区可能已被后台线程换走，重新判断
+                m_cond.notify_one();
+                m_notFull.wait(lock);
+                break;
+        }
+    }
+    return true;
+}
+
+AsyncLogWriter::Buffer::ptr AsyncLogWriter::takeFree(size_t min_capacity) {
+    if(min_capacity <= m_config.buffer_size && !m_free.empty()) {
+        Buffer::ptr buf = std::move(m_free.back());
+        m_free.pop_back();
+        return buf;
+    }
+    return Buffer::ptr(new Buffer(std::max(m_config.buffer_size, min_capacity)));
+}
+
+void AsyncLogWriter::recycle(Buffer::ptr buf) {
+    // 超长日志的专用缓冲区以及多余的缓冲区直接释放
+    if(buf->capacity() != m_config.buffer_size
+            || m_free.size() >= m_config.buffer_count) {
+        return;
+    }
+    buf->reset();
+    m_free.push_back(std::move(buf));
+}
+
+void AsyncLogWriter::run() {
+    std::vector<Buffer::ptr> batch;
+    while(true) {
+        uint64_t batch_id = 0;
+        bool stop = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if(m_pending.empty() && !m_flushRequested && !m_stopping) {
+                m_cond.wait_for(lock, std::chrono::milliseconds(m_config.flush_interval));
+            }
+            // 交换前台缓冲区，生产者继续写新的缓冲区；积压已满时留给下一批，flush和停止时必须带上
+            if(m_current->size() > 0 && (m_flushRequested || m_stopping
+                    || m_backlog + units(m_current->capacity()) <= m_config.buffer_count)) {
+                m_backlog += units(m_current->capacity());
+                m_pending.push_back(std::move(m_current));
+                m_current = takeFree(0);
+            }
+            for(auto& i : m_pending) {
+                batch.push_back(std::move(i));
+            }
+            // 正在写的批次继续占用积压额度和字节数，写完才释放
+            m_pending.clear();
+            m_flushRequested = false;
+            batch_id = ++m_takenBatch;
+            stop = m_stopping;
+        }
+
+        for(auto& i : batch) {
+            m_write(i->data(), i->size());
+        }
+        if(!batch.empty() && m_flush) {
+            m_flush();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for(auto& i : batch) {
+                m_backlog -= units(i->capacity());
+                m_queued -= i->size();
+                recycle(std::move(i));
+            }
+            m_writtenBatch = batch_id;
+            m_written.notify_all();
+            m_notFull.notify_all();
+        }
+        batch.clear();
+
+        if(stop) {
+            break;
+        }
+    }
+}
+
+}
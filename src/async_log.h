@@ -0,0 +1,215 @@
+#ifndef __ORANGE_ASYNC_LOG_H__
+#define __ORANGE_ASYNC_LOG_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+namespace orange {
+
+/**
+ * @brief 异步日志写入器
+ * @details 生产者把已经格式化好的日志追加到前台缓冲区，后台线程交换缓冲区后
+ *          按批次写入，调用线程不再承担磁盘IO
+ */
+class AsyncLogWriter {
+public:
+    typedef std::shared_ptr<AsyncLogWriter> ptr;
+    typedef std::function<void (const char* data, size_t len)> write_cb;
+    typedef std::function<void ()> flush_cb;
+
+    /**
+     * @brief 待写缓冲区达到上限时的处理策略
+     */
+    enum Policy {
+        /// 阻塞生产者，直到后台线程腾出空间
+        BLOCK = 0,
+        /// 丢弃最旧的一块待写缓冲区
+        DROP_OLDEST = 1,
+        /// 丢弃当前写入的日志
+        DROP_NEWEST = 2
+    };
+
+    static const char* ToString(Policy policy);
+    /**
+     * @brief 字符串转策略，不识别时返回BLOCK
+     */
+    static Policy FromString(const std::string& str);
+
+    /**
+     * @brief 异步写入配置
+     */
+    struct Config {
+        // 单块缓冲区大小(字节)
+        size_t buffer_size = 4 * 1024 * 1024;
+        // 最多允许积压的满缓冲区个数，包括后台线程正在写的，超长日志的缓冲区按buffer_size的倍数计
+        size_t buffer_count = 8;
+        // 积压达到上限时的策略
+        Policy policy = BLOCK;
+        // 后台线程最长多久写一次(毫秒)
+        uint32_t flush_interval = 1000;
+
+        bool operator==(const Config& oth) const {
+            return buffer_size == oth.buffer_size
+                && buffer_count == oth.buffer_count
+                && policy == oth.policy
+                && flush_interval == oth.flush_interval;
+        }
+    };
+
+    /**
+     * @brief 构造并启动后台线程
+     * @param[in] write 在后台线程中写出一段数据
+     * @param[in] flush 一批数据写完后调用
+     * @param[in] config 缓冲区配置
+     */
+    AsyncLogWriter(write_cb write, flush_cb flush, const Config& config);
+    AsyncLogWriter(write_cb write, flush_cb flush);
+
+    /**
+     * @brief 写完所有已提交的数据后停止后台线程
+     */
+    ~AsyncLogWriter();
+
+    /**
+     * @brief 追加一条日志，只做内存拷贝
+     * @details 积压达到上限时按policy处理，超长日志也一样，加上前台缓冲区最多占用
+     *          (buffer_count + 1) * buffer_size 字节(flush时多一块)。超过这个大小的日志永远放不下，直接丢弃
+     */
+    void append(const char* data, size_t len);
+
+    /**
+     * @brief 等待调用前追加的日志全部写出
+     */
+    void flush();
+
+    /**
+     * @brief 请求后台线程尽快写出，不等待
+     */
+    void requestFlush();
+
+    /**
+     * @brief 进程崩溃时把还没交给后台线程的缓冲区直接写入fd
+     * @details 不加锁、不分配内存，只在致命信号处理函数中使用。
+     *          后台线程正在写的那一批可能只写出一部分
+     */
+    void drainTo(int fd);
+
+    const Config& getConfig() const { return m_config; }
+
+    /**
+     * @brief 被丢弃的日志条数
+     */
+    uint64_t getDropped() const;
+
+    /**
+     * @brief 还没写完的数据最多积压过多少字节，包括后台线程正在写的
+     */
+    uint64_t getHighWater() const;
+private:
+    /**
+     * @brief 日志缓冲区
+     */
+    class Buffer {
+    public:
+        typedef std::unique_ptr<Buffer> ptr;
+
+        Buffer(size_t capacity)
+            : m_data(new char[capacity])
+            , m_capacity(capacity) {
+        }
+
+        void append(const char* data, size_t len) {
+            memcpy(m_data.get() + m_size, data, len);
+            m_size += len;
+            ++m_records;
+        }
+
+        void reset() { m_size = 0; m_records = 0; }
+
+        const char* data() const { return m_data.get(); }
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+        size_t avail() const { return m_capacity - m_size; }
+        uint64_t records() const { return m_records; }
+    private:
+        std::unique_ptr<char[]> m_data;
+        size_t m_capacity;
+        size_t m_size = 0;
+        uint64_t m_records = 0;
+    };
+
+    /**
+     * @brief 前台缓冲区写满后放入待写队列，返回false表示当前日志被丢弃
+     */
+    bool rotate(std::unique_lock<std::mutex>& lock, size_t len);
+
+    /**
+     * @brief 容量为capacity的缓冲区占多少块积压额度
+     */
+    size_t units(size_t capacity) const {
+        return (std::max(capacity, m_config.buffer_size) + m_config.buffer_size - 1) / m_config.buffer_size;
+    }
+
+    /**
+     * @brief 取一块空闲缓冲区
+     */
+    Buffer::ptr takeFree(size_t min_capacity);
+
+    /**
+     * @brief 归还缓冲区
+     */
+    void recycle(Buffer::ptr buf);
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+private:
+    write_cb m_write;
+    flush_cb m_flush;
+    Config m_config;
+
+    mutable std::mutex m_mutex;
+    // 通知后台线程有数据可写
+    std::condition_variable m_cond;
+    // 通知生产者待写队列有空位
+    std::condition_variable m_notFull;
+    // 通知flush调用者一批数据已写完
+    std::condition_variable m_written;
+
+    // 前台缓冲区
+    Buffer::ptr m_current;
+    // 写满待写出的缓冲区
+    std::deque<Buffer::ptr> m_pending;
+    // 空闲缓冲区
+    std::vector<Buffer::ptr> m_free;
+
+    // 后台线程已取走的批次号
+    uint64_t m_takenBatch = 0;
+    // 后台线程已写完的批次号
+    uint64_t m_writtenBatch = 0;
+    // 是否有flush请求
+    bool m_flushRequested = false;
+    bool m_stopping = false;
+    uint64_t m_dropped = 0;
+    // 待写队列和后台线程正在写的缓冲区占用的积压额度
+    size_t m_backlog = 0;
+    // 前台、待写和正在写的缓冲区中的字节数及其最大值
+    uint64_t m_queued = 0;
+    uint64_t m_highWater = 0;
+
+    std::thread m_thread;
+};
+
+}
+
+#endif
@@ -0,0 +1,543 @@
+#include "binlog.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <ctype.h>
+#include <map>
+#include <chrono>
+#include <functional>
+
+namespace orange {
+
+/**
+ * @brief 全局的调用点和日志器注册表
+ */
+class BinLogRegistry {
+public:
+    uint32_t addSite(BinLogSite* site) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_sites.push_back(site);
+        return m_sites.size() - 1;
+    }
+
+    uint32_t getLoggerId(Logger* logger) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = m_loggerIds.find(logger);
+        if(it != m_loggerIds.end() && m_loggers[it->second] == logger->getName()) {
+            return it->second;
+        }
+        uint32_t id = m_loggers.size();
+        m_loggers.push_back(logger->getName());
+        m_loggerIds[logger] = id;
+        return id;
+    }
+
+    /**
+     * @brief 复制from之后注册的调用点和日志器
+     */
+    void snapshot(size_t site_from, std::vector<BinLogSite*>& sites,
+                  size_t logger_from, std::vector<std::string>& loggers) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if(site_from < m_sites.size()) {
+            sites.assign(m_sites.begin() + site_from, m_sites.end());
+        }
+        if(logger_from < m_loggers.size()) {
+            loggers.assign(m_loggers.begin() + logger_from, m_loggers.end());
+        }
+    }
+private:
+    std::mutex m_mutex;
+    std::vector<BinLogSite*> m_sites;
+    std::vector<std::string> m_loggers;
+    std::map<Logger*, uint32_t> m_loggerIds;
+};
+
+typedef Singleton<BinLogRegistry> BinLogRegistryMgr;
+
+BinLogSite::BinLogSite(LogLevel::Level level, const char* file, int32_t line, const char* fmt)
+    : m_level(level)
+    , m_file(file)
+    , m_line(line)
+    , m_fmt(fmt) {
+    m_id = BinLogRegistryMgr::GetInstance()->addSite(this);
+}
+
+/**
+ * @brief 向out追加一条记录
+ */
+static void AppendRecord(std::string& out, uint8_t type, const std::string& payload) {
+    binlog::RecordHeader rh;
+    memset(&rh, 0, sizeof(rh));
+    rh.type = type;
+    rh.len = payload.size();
+    out.append((const char*)&rh, sizeof(rh));
+    out.append(payload);
+}
+
+template<class T>
+static void AppendPod(std::string& out, const T& v) {
+    out.append((const char*)&v, sizeof(v));
+}
+
+static void AppendString(std::string& out, const char* str, size_t len) {
+    uint32_t n = len;
+    AppendPod(out, n);
+    out.append(str, len);
+}
+
+BinLogWriter::BinLogWriter()
+    : m_open(false)
+    , m_generation(0)
+    , m_dropped(0) {
+}
+
+BinLogWriter::~BinLogWriter() {
+    close();
+}
+
+bool BinLogWriter::open(const std::string& path, size_t ring_size, uint32_t flush_interval) {
+    close();
+
+    std::unique_lock<std::mutex> drain_lock(m_drainMutex);
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(m_fd < 0) {
+        return false;
+    }
+    m_ringSize = ring_size;
+    m_flushInterval = flush_interval ? flush_interval : 100;
+    m_sitesWritten = 0;
+    m_loggersWritten = 0;
+
+    std::string header(binlog::FILE_MAGIC, sizeof(binlog::FILE_MAGIC));
+    writeFile(header);
+    drain_lock.unlock();
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+    ++m_generation;
+    m_open.store(true, std::memory_order_release);
+    m_thread = std::thread(std::bind(&BinLogWriter::run, this));
+    return true;
+}
+
+void BinLogWriter::close() {
+    if(!m_open.exchange(false)) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cond.notify_one();
+    }
+    m_thread.join();
+    drain();
+
+    std::unique_lock<std::mutex> drain_lock(m_drainMutex);
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_rings.clear();
+    }
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void BinLogWriter::flush() {
+    if(isOpen()) {
+        drain();
+    }
+}
+
+BinLogWriter::ThreadRing* BinLogWriter::getThreadRing() {
+    static thread_local ThreadRing s_ring;
+    uint64_t generation = m_generation.load(std::memory_order_acquire);
+    if(s_ring.generation != generation) {
+        s_ring.ring.reset(new SpscRingBuffer(m_ringSize));
+        s_ring.generation = generation;
+        s_ring.thread = GetThreadId();
+        s_ring.logger = nullptr;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_rings.push_back(s_ring.ring);
+    }
+    return &s_ring;
+}
+
+char* BinLogWriter::reserve(ThreadRing* ring, size_t len) {
+    if(len > ring->ring->capacity() / 2) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    char* p = nullptr;
+    // 环形缓冲区满时等待后台线程写出
+    while(!(p = ring->ring->reserve(len))) {
+        if(!isOpen()) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        m_cond.notify_one();
+        std::this_thread::yield();
+    }
+    return p;
+}
+
+uint32_t BinLogWriter::getLoggerId(ThreadRing* ring, Logger* logger) {
+    if(ring->logger != logger) {
+        ring->loggerId = BinLogRegistryMgr::GetInstance()->getLoggerId(logger);
+        ring->logger = logger;
+    }
+    return ring->loggerId;
+}
+
+void BinLogWriter::run() {
+    while(true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if(m_stopping) {
+                break;
+            }
+            m_cond.wait_for(lock, std::chrono::milliseconds(m_flushInterval));
+            if(m_stopping) {
+                break;
+            }
+        }
+        drain();
+    }
+}
+
+void BinLogWriter::drain() {
+    std::unique_lock<std::mutex> drain_lock(m_drainMutex);
+    if(m_fd < 0) {
+        return;
+    }
+
+    std::vector<SpscRingBuffer::ptr> rings;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // 线程退出后只剩这里持有，写完即可移除
+        for(auto it = m_rings.begin(); it != m_rings.end();) {
+            if(it->use_count() == 1 && (*it)->empty()) {
+                it = m_rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        rings = m_rings;
+    }
+
+    // 先取各缓冲区的写位置，再写字典，保证这些记录引用的调用点都已写出
+    std::vector<uint64_t> ends;
+    ends.reserve(rings.size());
+    for(auto& i : rings) {
+        ends.push_back(i->writePos());
+    }
+
+    m_writeBuf.clear();
+    writeDictionary(m_writeBuf);
+
+    for(size_t i = 0; i < rings.size(); ++i) {
+        uint64_t pos = rings[i]->readPos();
+        size_t len = 0;
+        const char* data = nullptr;
+        while((data = rings[i]->read(pos, ends[i], len))) {
+            m_writeBuf.append(data, len);
+            if(m_writeBuf.size() >= 1024 * 1024) {
+                writeFile(m_writeBuf);
+                m_writeBuf.clear();
+            }
+        }
+        rings[i]->release(pos);
+    }
+    writeFile(m_writeBuf);
+}
+
+void BinLogWriter::writeDictionary(std::string& out) {
+    std::vector<BinLogSite*> sites;
+    std::vector<std::string> loggers;
+    BinLogRegistryMgr::GetInstance()->snapshot(m_sitesWritten, sites, m_loggersWritten, loggers);
+
+    std::string payload;
+    for(auto site : sites) {
+        payload.clear();
+        AppendPod(payload, site->getId());
+        AppendPod(payload, (uint32_t)site->getLevel());
+        AppendPod(payload, site->getLine());
+        AppendString(payload, site->getFile(), strlen(site->getFile()));
+        AppendString(payload, site->getFormat(), strlen(site->getFormat()));
+        AppendRecord(out, binlog::SITE, payload);
+    }
+    for(size_t i = 0; i < loggers.size(); ++i) {
+        payload.clear();
+        AppendPod(payload, (uint32_t)(m_loggersWritten + i));
+        AppendString(payload, loggers[i].c_str(), loggers[i].size());
+        AppendRecord(out, binlog::LOGGER, payload);
+    }
+    m_sitesWritten += sites.size();
+    m_loggersWritten += loggers.size();
+}
+
+void BinLogWriter::writeFile(const std::string& data) {
+    const char* p = data.c_str();
+    size_t left = data.size();
+    while(left > 0) {
+        ssize_t n = ::write(m_fd, p, left);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        p += n;
+        left -= n;
+    }
+}
+
+BinLogReader::BinLogReader()
+    : m_unknown(new Logger("unknown")) {
+}
+
+BinLogReader::~BinLogReader() {
+}
+
+bool BinLogReader::open(const std::string& path) {
+    m_in.open(path, std::ios::binary);
+    if(!m_in) {
+        return false;
+    }
+    char magic[sizeof(binlog::FILE_MAGIC)];
+    if(!m_in.read(magic, sizeof(magic))
+            || memcmp(magic, binlog::FILE_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 从p读取一个定长值，越界返回false
+ */
+template<class T>
+static bool ReadPod(const char*& p, const char* end, T& v) {
+    if(end - p < (ptrdiff_t)sizeof(T)) {
+        return false;
+    }
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+static bool ReadString(const char*& p, const char* end, std::string& str) {
+    uint32_t len = 0;
+    if(!ReadPod(p, end, len) || end - p < (ptrdiff_t)len) {
+        return false;
+    }
+    str.assign(p, len);
+    p += len;
+    return true;
+}
+
+const LogEvent* BinLogReader::next() {
+    binlog::RecordHeader rh;
+    while(m_in.read((char*)&rh, sizeof(rh))) {
+        m_payload.resize(rh.len);
+        if(rh.len && !m_in.read(&m_payload[0], rh.len)) {
+            return nullptr;
+        }
+        const char* p = m_payload.c_str();
+        const char* end = p + m_payload.size();
+
+        if(rh.type == binlog::SITE) {
+            std::unique_ptr<Site> site(new Site);
+            uint32_t id = 0;
+            uint32_t level = 0;
+            if(!ReadPod(p, end, id) || !ReadPod(p, end, level) || !ReadPod(p, end, site->line)
+                    || !ReadString(p, end, site->file) || !ReadString(p, end, site->fmt)) {
+                return nullptr;
+            }
+            site->level = (LogLevel::Level)level;
+            if(m_sites.size() <= id) {
+                m_sites.resize(id + 1);
+            }
+            m_sites[id] = std::move(site);
+        } else if(rh.type == binlog::LOGGER) {
+            uint32_t id = 0;
+            std::string name;
+            if(!ReadPod(p, end, id) || !ReadString(p, end, name)) {
+                return nullptr;
+            }
+            if(m_loggers.size() <= id) {
+                m_loggers.resize(id + 1);
+            }
+            m_loggers[id].reset(new Logger(name));
+        } else if(rh.type == binlog::EVENT) {
+            binlog::EventHeader eh;
+            if(!ReadPod(p, end, eh) || eh.site >= m_sites.size() || !m_sites[eh.site]) {
+                continue;
+            }
+            const Site& site = *m_sites[eh.site];
+            Logger* logger = eh.logger < m_loggers.size() && m_loggers[eh.logger]
+                            ? m_loggers[eh.logger].get() : m_unknown.get();
+
+            m_message.clear();
+            decodeMessage(site.fmt, p, end, m_message);
+            if(!m_event) {
+                m_event.reset(new LogEvent(logger, site.level, site.file.c_str(), site.line,
+                            0, eh.thread, eh.fiber, 0));
+            } else {
+                m_event->reset(logger, site.level, site.file.c_str(), site.line,
+                            0, eh.thread, eh.fiber, 0);
+            }
+            m_event->setTimeNS(eh.time);
+            m_event->getStream().write(m_message.c_str(), m_message.size());
+            return m_event.get();
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief 解码后的参数
+ */
+struct DecodedArg {
+    char type = 0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    std::string s;
+};
+
+static bool ReadArg(const char*& p, const char* end, DecodedArg& arg) {
+    if(p >= end) {
+        return false;
+    }
+    arg.type = *p++;
+    switch(arg.type) {
+        case binlog::ARG_INT:
+            if(!ReadPod(p, end, arg.i)) return false;
+            arg.u = arg.i;
+            arg.d = arg.i;
+            return true;
+        case binlog::ARG_UINT:
+        case binlog::ARG_POINTER:
+            if(!ReadPod(p, end, arg.u)) return false;
+            arg.i = arg.u;
+            arg.d = arg.u;
+            return true;
+        case binlog::ARG_DOUBLE:
+            if(!ReadPod(p, end, arg.d)) return false;
+            arg.i = arg.d;
+            arg.u = arg.d;
+            return true;
+        case binlog::ARG_STRING:
+            return ReadString(p, end, arg.s);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 用snprintf把一个参数按spec格式化后追加到out
+ */
+template<class T>
+static void AppendFormatted(std::string& out, const std::string& spec, T v) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf), spec.c_str(), v);
+    if(n < 0) {
+        return;
+    }
+    if((size_t)n < sizeof(buf)) {
+        out.append(buf, n);
+        return;
+    }
+    std::string big(n + 1, '\0');
+    snprintf(&big[0], big.size(), spec.c_str(), v);
+    out.append(big.c_str(), n);
+}
+
+void BinLogReader::decodeMessage(const std::string& fmt, const char* args, const char* end, std::string& out) {
+    DecodedArg arg;
+    for(size_t i = 0; i < fmt.size(); ++i) {
+        if(fmt[i] != '%') {
+            out.push_back(fmt[i]);
+            continue;
+        }
+        if(i + 1 < fmt.size() && fmt[i + 1] == '%') {
+            out.push_back('%');
+            ++i;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion，去掉长度修饰后按实际参数类型重新拼接
+        std::string spec = "%";
+        size_t n = i + 1;
+        while(n < fmt.size() && strchr("-+ #0'", fmt[n])) {
+            spec.push_back(fmt[n++]);
+        }
+        while(n < fmt.size() && (isdigit(fmt[n]) || fmt[n] == '.' || fmt[n] == '*')) {
+            if(fmt[n] == '*') {
+                // 宽度/精度来自参数
+                if(!ReadArg(args, end, arg)) {
+                    return;
+                }
+                spec.append(std::to_string(arg.i));
+            } else {
+                spec.push_back(fmt[n]);
+            }
+            ++n;
+        }
+        while(n < fmt.size() && strchr("hlLqjzt", fmt[n])) {
+            ++n;
+        }
+        if(n >= fmt.size()) {
+            out.append(fmt, i, std::string::npos);
+            return;
+        }
+
+        char conv = fmt[n];
+        i = n;
+        if(!ReadArg(args, end, arg)) {
+            out.append("<<missing argument>>");
+            continue;
+        }
+        switch(conv) {
+            case 'd':
+            case 'i':
+                AppendFormatted(out, spec + "ll" + conv, (long long)arg.i);
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                AppendFormatted(out, spec + "ll" + conv, (unsigned long long)arg.u);
+                break;
+            case 'c':
+                AppendFormatted(out, spec + conv, (int)arg.i);
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                AppendFormatted(out, spec + conv, arg.d);
+                break;
+            case 's':
+                if(arg.type == binlog::ARG_STRING) {
+                    AppendFormatted(out, spec + conv, arg.s.c_str());
+                } else {
+                    AppendFormatted(out, spec + "lld", (long long)arg.i);
+                }
+                break;
+            case 'p':
+                AppendFormatted(out, spec + conv, (void*)(uintptr_t)arg.u);
+                break;
+            default:
+                out.append(fmt, i, 1);
+                break;
+        }
+    }
+}
+
+}
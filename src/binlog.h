@@ -0,0 +1,432 @@
+#ifndef __ORANGE_BINLOG_H__
+#define __ORANGE_BINLOG_H__
+
+#include "log.h"
+#include "ring_buffer.h"
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <type_traits>
+
+/**
+ * @brief 使用二进制模式将日志级别为level的日志写入logger
+ * @details 调用点的格式串、文件、行号只注册一次，每条日志只把参数的原始字节和时间戳
+ *          写入线程级环形缓冲区，由后台线程落盘，之后用 orange_logdecode 还原成文本。
+ *          fmt 必须是字符串字面量，格式与 printf 相同。BinLogMgr 未打开时退化为 ORANGE_LOG_FMT_LEVEL
+ */
+#define ORANGE_LOG_BIN_LEVEL(logger, level, fmt, ...) \
+    do { \
+        if(ORANGE_LOG_MIN_LEVEL <= level && logger->isEnabled(level)) { \
+            static orange::BinLogSite s_orange_binlog_site(level, __FILE__, __LINE__, fmt); \
+            orange::BinLog(s_orange_binlog_site, logger, __VA_ARGS__); \
+        } \
+    } while(0)
+
+/**
+ * @brief 使用二进制模式将日志级别为DEBUG的日志写入logger
+ */
+#define ORANGE_LOG_BIN_DEBUG(logger, fmt, ...) ORANGE_LOG_BIN_LEVEL(logger, orange::LogLevel::DEBUG, fmt, __VA_ARGS__)
+
+/**
+ * @brief 使用二进制模式将日志级别为INFO的日志写入logger
+ */
+#define ORANGE_LOG_BIN_INFO(logger, fmt, ...) ORANGE_LOG_BIN_LEVEL(logger, orange::LogLevel::INFO, fmt, __VA_ARGS__)
+
+/**
+ * @brief 使用二进制模式将日志级别为WARN的日志写入logger
+ */
+#define ORANGE_LOG_BIN_WARN(logger, fmt, ...) ORANGE_LOG_BIN_LEVEL(logger, orange::LogLevel::WARN, fmt, __VA_ARGS__)
+
+/**
+ * @brief 使用二进制模式将日志级别为ERROR的日志写入logger
+ */
+#define ORANGE_LOG_BIN_ERROR(logger, fmt, ...) ORANGE_LOG_BIN_LEVEL(logger, orange::LogLevel::ERROR, fmt, __VA_ARGS__)
+
+/**
+ * @brief 使用二进制模式将日志级别为FATAL的日志写入logger
+ */
+#define ORANGE_LOG_BIN_FATAL(logger, fmt, ...) ORANGE_LOG_BIN_LEVEL(logger, orange::LogLevel::FATAL, fmt, __VA_ARGS__)
+
+namespace orange {
+
+/**
+ * @brief 二进制日志调用点的静态信息
+ */
+class BinLogSite {
+public:
+    /**
+     * @brief 构造时注册到全局调用点表
+     * @param[in] fmt 格式串，必须是静态存储的字符串
+     */
+    BinLogSite(LogLevel::Level level, const char* file, int32_t line, const char* fmt);
+
+    uint32_t getId() const { return m_id; }
+    LogLevel::Level getLevel() const { return m_level; }
+    const char* getFile() const { return m_file; }
+    int32_t getLine() const { return m_line; }
+    const char* getFormat() const { return m_fmt; }
+private:
+    uint32_t m_id;
+    LogLevel::Level m_level;
+    const char* m_file;
+    int32_t m_line;
+    const char* m_fmt;
+};
+
+namespace binlog {
+
+/**
+ * @brief 文件中的记录类型
+ */
+enum RecordType {
+    SITE = 1,       // 调用点
+    LOGGER = 2,     // 日志器名称
+    EVENT = 3       // 日志事件
+};
+
+/**
+ * @brief 参数类型标记
+ */
+enum ArgType {
+    ARG_INT = 'i',
+    ARG_UINT = 'u',
+    ARG_DOUBLE = 'd',
+    ARG_STRING = 's',
+    ARG_POINTER = 'p'
+};
+
+/**
+ * @brief 记录头
+ */
+struct RecordHeader {
+    uint8_t type;
+    uint8_t reserved[3];
+    // 记录内容长度(不包括记录头)
+    uint32_t len;
+};
+
+/**
+ * @brief 日志事件头，之后紧跟编码后的参数
+ */
+struct EventHeader {
+    uint32_t site;
+    uint32_t logger;
+    uint32_t thread;
+    uint32_t fiber;
+    // 墙上时间(纳秒)
+    uint64_t time;
+};
+
+// 文件头魔数
+static const char FILE_MAGIC[8] = {'O', 'R', 'G', 'B', 'L', 'O', 'G', '1'};
+
+template<class T, class Enable = void>
+struct Arg;
+
+/**
+ * @brief 有符号整数及枚举
+ */
+template<class T>
+struct Arg<T, typename std::enable_if<(std::is_integral<T>::value && std::is_signed<T>::value)
+                                      || std::is_enum<T>::value>::type> {
+    static size_t Size(const T&) { return 1 + sizeof(int64_t); }
+    static char* Write(char* p, const T& v) {
+        int64_t x = (int64_t)v;
+        *p = ARG_INT;
+        memcpy(p + 1, &x, sizeof(x));
+        return p + 1 + sizeof(x);
+    }
+};
+
+/**
+ * @brief 无符号整数
+ */
+template<class T>
+struct Arg<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type> {
+    static size_t Size(const T&) { return 1 + sizeof(uint64_t); }
+    static char* Write(char* p, const T& v) {
+        uint64_t x = (uint64_t)v;
+        *p = ARG_UINT;
+        memcpy(p + 1, &x, sizeof(x));
+        return p + 1 + sizeof(x);
+    }
+};
+
+/**
+ * @brief 浮点数
+ */
+template<class T>
+struct Arg<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+    static size_t Size(const T&) { return 1 + sizeof(double); }
+    static char* Write(char* p, const T& v) {
+        double x = (double)v;
+        *p = ARG_DOUBLE;
+        memcpy(p + 1, &x, sizeof(x));
+        return p + 1 + sizeof(x);
+    }
+};
+
+/**
+ * @brief 字符串，长度 + 内容
+ */
+struct StringArg {
+    static size_t Size(const char* v, size_t len) { return 1 + sizeof(uint32_t) + len; }
+    static char* Write(char* p, const char* v, size_t len) {
+        uint32_t n = len;
+        *p = ARG_STRING;
+        memcpy(p + 1, &n, sizeof(n));
+        memcpy(p + 1 + sizeof(n), v, len);
+        return p + 1 + sizeof(n) + len;
+    }
+};
+
+template<>
+struct Arg<const char*> {
+    static const char* Str(const char* v) { return v ? v : "(null)"; }
+    static size_t Size(const char* v) { return StringArg::Size(Str(v), strlen(Str(v))); }
+    static char* Write(char* p, const char* v) { return StringArg::Write(p, Str(v), strlen(Str(v))); }
+};
+
+template<>
+struct Arg<char*> : public Arg<const char*> {
+};
+
+template<>
+struct Arg<std::string> {
+    static size_t Size(const std::string& v) { return StringArg::Size(v.c_str(), v.size()); }
+    static char* Write(char* p, const std::string& v) { return StringArg::Write(p, v.c_str(), v.size()); }
+};
+
+/**
+ * @brief 其他指针按地址记录
+ */
+template<class T>
+struct Arg<T*> {
+    static size_t Size(const T*) { return 1 + sizeof(uint64_t); }
+    static char* Write(char* p, const T* v) {
+        uint64_t x = (uint64_t)(uintptr_t)v;
+        *p = ARG_POINTER;
+        memcpy(p + 1, &x, sizeof(x));
+        return p + 1 + sizeof(x);
+    }
+};
+
+inline size_t ArgsSize() { return 0; }
+
+template<class T, class... Args>
+size_t ArgsSize(const T& v, const Args&... args) {
+    return Arg<typename std::decay<T>::type>::Size(v) + ArgsSize(args...);
+}
+
+inline char* WriteArgs(char* p) { return p; }
+
+template<class T, class... Args>
+char* WriteArgs(char* p, const T& v, const Args&... args) {
+    p = Arg<typename std::decay<T>::type>::Write(p, v);
+    return WriteArgs(p, args...);
+}
+
+/**
+ * @brief 退化为文本日志时把std::string转换成printf可用的参数
+ */
+template<class T>
+const T& PrintfArg(const T& v) { return v; }
+inline const char* PrintfArg(const std::string& v) { return v.c_str(); }
+
+}
+
+/**
+ * @brief 二进制日志写入器
+ * @details 每个写日志的线程拥有一个单生产者单消费者环形缓冲区，
+ *          后台线程定期把所有环形缓冲区中的记录写入文件
+ */
+class BinLogWriter {
+public:
+    BinLogWriter();
+    ~BinLogWriter();
+
+    /**
+     * @brief 打开日志文件并启动后台线程，已打开时先关闭
+     * @param[in] path 文件路径
+     * @param[in] ring_size 每个线程环形缓冲区的大小(字节)
+     * @param[in] flush_interval 后台线程写文件的间隔(毫秒)
+     */
+    bool open(const std::string& path, size_t ring_size = 1024 * 1024, uint32_t flush_interval = 100);
+
+    /**
+     * @brief 写完剩余记录后关闭文件
+     */
+    void close();
+
+    /**
+     * @brief 立即把所有线程中已提交的记录写入文件
+     */
+    void flush();
+
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 环形缓冲区满时被丢弃的记录数
+     */
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 写入一条日志
+     */
+    template<class... Args>
+    void log(const BinLogSite& site, Logger* logger, const Args&... args) {
+        size_t len = sizeof(binlog::RecordHeader) + sizeof(binlog::EventHeader) + binlog::ArgsSize(args...);
+        ThreadRing* ring = getThreadRing();
+        char* p = reserve(ring, len);
+        if(!p) {
+            return;
+        }
+
+        binlog::RecordHeader rh;
+        memset(&rh, 0, sizeof(rh));
+        rh.type = binlog::EVENT;
+        rh.len = len - sizeof(rh);
+        memcpy(p, &rh, sizeof(rh));
+        p += sizeof(rh);
+
+        binlog::EventHeader eh;
+        eh.site = site.getId();
+        eh.logger = getLoggerId(ring, logger);
+        eh.thread = ring->thread;
+        eh.fiber = GetFiberId();
+        eh.time = GetCurrentNS();
+        memcpy(p, &eh, sizeof(eh));
+        p += sizeof(eh);
+
+        binlog::WriteArgs(p, args...);
+        ring->ring->commit();
+    }
+private:
+    /**
+     * @brief 线程级环形缓冲区
+     */
+    struct ThreadRing {
+        SpscRingBuffer::ptr ring;
+        // 所属的打开批次，重新打开文件后需要重新创建
+        uint64_t generation = 0;
+        // 缓存的线程id
+        uint32_t thread = 0;
+        // 最近一次使用的日志器
+        Logger* logger = nullptr;
+        uint32_t loggerId = 0;
+    };
+
+    ThreadRing* getThreadRing();
+    char* reserve(ThreadRing* ring, size_t len);
+    uint32_t getLoggerId(ThreadRing* ring, Logger* logger);
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+
+    /**
+     * @brief 把所有环形缓冲区的记录写入文件
+     */
+    void drain();
+
+    /**
+     * @brief 写出新注册的调用点和日志器
+     */
+    void writeDictionary(std::string& out);
+
+    void writeFile(const std::string& data);
+private:
+    std::atomic<bool> m_open;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<uint64_t> m_dropped;
+    size_t m_ringSize = 0;
+    uint32_t m_flushInterval = 100;
+    int m_fd = -1;
+
+    // 保护环形缓冲区列表和线程状态
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stopping = false;
+    std::vector<SpscRingBuffer::ptr> m_rings;
+    std::thread m_thread;
+
+    // 保证同一时间只有一个消费者
+    std::mutex m_drainMutex;
+    // 已写入当前文件的调用点和日志器个数
+    size_t m_sitesWritten = 0;
+    size_t m_loggersWritten = 0;
+    std::string m_writeBuf;
+};
+
+typedef Singleton<BinLogWriter> BinLogMgr;
+
+/**
+ * @brief 写入一条二进制日志，BinLogMgr 未打开时按printf格式写入文本日志
+ */
+template<class... Args>
+void BinLog(const BinLogSite& site, Logger* logger, const Args&... args) {
+    BinLogWriter* writer = BinLogMgr::GetInstance();
+    if(writer->isOpen()) {
+        // 二进制记录不格式化消息，消息内容条件不生效
+        if(logger->hasFilter() && !logger->filter(site.getLevel(), site.getFile())) {
+            return;
+        }
+        logger->addStat(LogStats::ACCEPTED);
+        writer->log(site, logger, args...);
+    } else {
+        LogEventWarp(logger, site.getLevel(), site.getFile(), site.getLine(), 0,
+            GetThreadId(), GetFiberId(), 0).getEvent()->format(site.getFormat(), binlog::PrintfArg(args)...);
+    }
+}
+
+template<class... Args>
+void BinLog(const BinLogSite& site, const std::shared_ptr<Logger>& logger, const Args&... args) {
+    BinLog(site, logger.get(), args...);
+}
+
+/**
+ * @brief 二进制日志读取器，把记录还原成日志事件
+ */
+class BinLogReader {
+public:
+    BinLogReader();
+    ~BinLogReader();
+
+    bool open(const std::string& path);
+
+    /**
+     * @brief 读取下一条日志
+     * @return 读完或文件损坏返回nullptr
+     */
+    const LogEvent* next();
+private:
+    /**
+     * @brief 按调用点的printf格式串还原消息
+     */
+    void decodeMessage(const std::string& fmt, const char* args, const char* end, std::string& out);
+private:
+    struct Site {
+        LogLevel::Level level;
+        std::string file;
+        int32_t line;
+        std::string fmt;
+    };
+
+    std::ifstream m_in;
+    std::vector<std::unique_ptr<Site>> m_sites;
+    std::vector<Logger::ptr> m_loggers;
+    // 日志器id缺失时使用
+    Logger::ptr m_unknown;
+    std::unique_ptr<LogEvent> m_event;
+    std::string m_payload;
+    std::string m_message;
+};
+
+}
+
+#endif
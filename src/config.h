@@ -416,8 +416,8 @@ public:
     static typename ConfigVar<T>::ptr Lookup(const std::string& name, const T& default_value, const std::string& description = ""){
 
         // 解决相同key，类型不同不报错的情况
-        auto it = m_datas.find(name);
-        if(it != m_datas.end()){
+        auto it = GetDatas().find(name);
+        if(it != GetDatas().end()){
             auto tmp = std::dynamic_pointer_cast<ConfigVar<T>>(it->second);
             if(tmp) {
                 ORANGE_LOG_INFO(ORANGE_LOG_ROOT()) << "Lookup name=" << name << "exists";
@@ -435,7 +435,7 @@ public:
         }
 
         typename ConfigVar<T>::ptr v(new ConfigVar<T>(name, default_value, description));
-        m_datas[name] = v;
+        GetDatas()[name] = v;
         return v;
     } 
     
@@ -444,8 +444,8 @@ public:
      */
     template<class T>
     static typename ConfigVar<T>::ptr Lookup(const std::string& name){
-        auto it = m_datas.find(name);
-        if(it == m_datas.end()){
+        auto it = GetDatas().find(name);
+        if(it == GetDatas().end()){
             return nullptr;
         }
 
@@ -467,7 +467,14 @@ public:
     static ConfigVarBase::ptr LookupBase(const std::string& name);
 
 private:
-    static ConfigVarMap m_datas;
+    /**
+     * @brief 配置项集合
+     * @details 使用局部静态变量，保证其他编译单元的全局变量初始化时调用Lookup也能用
+     */
+    static ConfigVarMap& GetDatas() {
+        static ConfigVarMap s_datas;
+        return s_datas;
+    }
 };
 
 }
@@ -1,12 +1,31 @@
 #include "log.h"
+#include "config.h"
+#include "log_escape.h"
+#include "log_crash.h"
+#include "log_filter.h"
 #include <iostream>
 #include <map>
+#include <thread>
+#include <condition_variable>
 #include <functional>
 #include <time.h>
 #include <stdarg.h>
+#include <atomic>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 namespace orange{
 
+// 格式器id生成器
+static std::atomic<uint64_t> s_formater_id(0);
+
 const char* LogLevel::toString(LogLevel::Level level){
     switch (level)
     {
@@ -27,15 +46,342 @@ const char* LogLevel::toString(LogLevel::Level level){
     return "UNKNOWN";    
 }
 
-LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time)
-    : m_file(file) 
-    , m_line(line) 
-    , m_elapse(elapse) 
-    , m_threadId(threadId)
-    , m_fiberId(fiberId) 
-    , m_time(time)
-    , m_logger(logger)
-    , m_level(level)  {
+LogLevel::Level LogLevel::FromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::toupper);
+#define XX(name) \
+    if(v == #name) { \
+        return LogLevel::name; \
+    }
+
+    XX(DEBUG);
+    XX(INFO);
+    XX(WARN);
+    XX(ERROR);
+    XX(FATAL);
+#undef XX
+    return LogLevel::UNKNOWN;
+}
+
+LogStreamBuf::LogStreamBuf() {
+    setp(m_inline, m_inline + INLINE_SIZE);
+}
+
+void LogStreamBuf::reset() {
+    if(m_heap) {
+        setp(m_heap.get(), m_heap.get() + m_heapSize);
+    } else {
+        setp(m_inline, m_inline + INLINE_SIZE);
+    }
+}
+
+void LogStreamBuf::grow(size_t n) {
+    size_t used = size();
+    size_t need = used + n;
+    if(m_heapSize < need) {
+        size_t cap = std::max(need, std::max(m_heapSize * 2, INLINE_SIZE * 2));
+        std::unique_ptr<char[]> heap(new char[cap]);
+        memcpy(heap.get(), pbase(), used);
+        m_heap.swap(heap);
+        m_heapSize = cap;
+    } else {
+        // 堆空间已经足够，从内联缓冲区搬过去
+        memcpy(m_heap.get(), pbase(), used);
+    }
+    setp(m_heap.get(), m_heap.get() + m_heapSize);
+    pbump(used);
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type c) {
+    if(traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    reserve(1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+    reserve(n);
+    memcpy(pptr(), s, n);
+    pbump(n);
+    return n;
+}
+
+// 00到99的两位数字
+static const char s_digits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * @brief 把v的十进制写到end之前，返回起始位置
+ */
+static char* FormatUInt(char* end, unsigned long long v) {
+    while(v >= 100) {
+        unsigned idx = (v % 100) * 2;
+        v /= 100;
+        *--end = s_digits[idx + 1];
+        *--end = s_digits[idx];
+    }
+    if(v >= 10) {
+        unsigned idx = v * 2;
+        *--end = s_digits[idx + 1];
+        *--end = s_digits[idx];
+    } else {
+        *--end = '0' + v;
+    }
+    return end;
+}
+
+void LogStream::reset() {
+    m_os.clear();
+    m_os.flags(std::ios_base::dec | std::ios_base::skipws);
+    m_os.precision(6);
+    m_os.width(0);
+    m_os.fill(' ');
+    m_plain = true;
+    m_raw = false;
+}
+
+void LogStream::updatePlain() {
+    m_plain = !m_raw && m_os.flags() == (std::ios_base::dec | std::ios_base::skipws)
+        && m_os.width() == 0 && m_os.precision() == 6;
+}
+
+const char* LogStream::appendFormatLiteral(const char* fmt) {
+    const char* begin = fmt;
+    for(;; ++fmt) {
+        char c = *fmt;
+        if(c == 0) {
+            write(begin, fmt - begin);
+            return nullptr;
+        }
+        if(c != '{' && c != '}') {
+            continue;
+        }
+        write(begin, fmt - begin);
+        if(c == '{' && fmt[1] == '}') {
+            return fmt + 2;
+        }
+        // {{ 和 }} 输出一个花括号，单独的花括号原样输出
+        write(fmt, 1);
+        if(fmt[1] == c) {
+            ++fmt;
+        }
+        begin = fmt + 1;
+    }
+}
+
+LogStream& LogStream::appendUInt(unsigned long long v) {
+    char tmp[24];
+    char* end = tmp + sizeof(tmp);
+    char* begin = FormatUInt(end, v);
+    return write(begin, end - begin);
+}
+
+LogStream& LogStream::appendInt(long long v) {
+    char tmp[24];
+    char* end = tmp + sizeof(tmp);
+    char* begin = FormatUInt(end, v < 0 ? -(unsigned long long)v : v);
+    if(v < 0) {
+        *--begin = '-';
+    }
+    return write(begin, end - begin);
+}
+
+/**
+ * @brief 常见的小数：找最小的k使 v*10^k 是不超过limit的整数并且能还原成v，按定点格式输出
+ * @details 只处理%g会使用定点格式的范围，其他情况返回0
+ */
+template<class T>
+static size_t FormatDecimal(char* buf, T v, double limit) {
+    if(v == 0) {
+        if(std::signbit(v)) {
+            return 0;
+        }
+        buf[0] = '0';
+        return 1;
+    }
+    double a = std::fabs((double)v);
+    if(!(a >= 1e-4 && a < limit)) {
+        return 0;
+    }
+    double scale = 1;
+    for(int k = 0; ; ++k, scale *= 10) {
+        double m = a * scale;
+        if(m >= limit) {
+            return 0;
+        }
+        if(m != std::floor(m) || (T)(m / scale) != (T)a) {
+            continue;
+        }
+        uint64_t n = (uint64_t)m;
+        uint64_t pow10 = (uint64_t)scale;
+        char tmp[48];
+        char* end = tmp + sizeof(tmp);
+        char* p = end;
+        if(k > 0) {
+            // 小数部分补足k位
+            char* frac = FormatUInt(end, n % pow10);
+            while(end - frac < k) {
+                *--frac = '0';
+            }
+            *--frac = '.';
+            p = frac;
+        }
+        p = FormatUInt(p, n / pow10);
+        if(v < 0) {
+            *--p = '-';
+        }
+        memcpy(buf, p, end - p);
+        return end - p;
+    }
+}
+
+/**
+ * @brief 从precision位有效数字开始增加，直到结果能还原成原值
+ */
+template<class T>
+static size_t FormatShortest(char* buf, size_t size, T v, int precision, int max_precision) {
+    int len = snprintf(buf, size, "%.*g", precision, (double)v);
+    if(!std::isfinite(v)) {
+        return len;
+    }
+    while(precision < max_precision && (T)strtod(buf, nullptr) != v) {
+        len = snprintf(buf, size, "%.*g", ++precision, (double)v);
+    }
+    return len;
+}
+
+LogStream& LogStream::appendDouble(double v) {
+    char* p = m_buf.prepare(48);
+    size_t len = FormatDecimal(p, v, 1e15);
+    m_buf.commit(len ? len : FormatShortest(p, 48, v, 15, 17));
+    return *this;
+}
+
+LogStream& LogStream::appendFloat(float v) {
+    char* p = m_buf.prepare(48);
+    size_t len = FormatDecimal(p, v, 1e7);
+    m_buf.commit(len ? len : FormatShortest(p, 48, v, 6, 9));
+    return *this;
+}
+
+void LogStreamBuf::vappendf(const char* fmt, va_list al) {
+    va_list al2;
+    va_copy(al2, al);
+    size_t avail = epptr() - pptr();
+    int len = vsnprintf(pptr(), avail, fmt, al);
+    if(len >= 0 && (size_t)len >= avail) {
+        reserve(len + 1);
+        len = vsnprintf(pptr(), len + 1, fmt, al2);
+    }
+    va_end(al2);
+    if(len > 0) {
+        pbump(len);
+    }
+}
+
+LogEvent::LogEvent(Logger* logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time)
+    : m_ss(&m_buf)
+    , m_stream(m_buf, m_ss) {
+    m_ss.pword(StreamIndex()) = this;
+    reset(logger, level, file, line, elapse, threadId, fiberId, time);
+}
+
+LogEvent::LogEvent(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time)
+    : LogEvent(logger.get(), level, file, line, elapse, threadId, fiberId, time) {
+}
+
+void LogEvent::reset(Logger* logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time) {
+    m_file = file;
+    m_line = line;
+    m_threadId = threadId;
+    m_fiberId = fiberId;
+    m_time = time;
+    m_logger = logger;
+    m_level = level;
+    // 只读一次时钟，墙上时间和启动以来的毫秒数都由它换算
+    m_monoNs = Clock::NowNS();
+    if(m_time == 0) {
+        m_timeNs = Clock::ToWallNS(m_monoNs);
+        m_time = m_timeNs / 1000000000;
+    } else {
+        m_timeNs = m_time * 1000000000;
+    }
+    m_elapse = elapse ? elapse : Clock::ElapsedNS(m_monoNs) / 1000000;
+    if(threadId == (uint32_t)GetThreadId()) {
+        ThreadContext& context = ThreadContext::GetThis();
+        m_context = &context;
+        m_mdcDepth = context.size();
+        // 崩溃处理安装之后，每个打日志的线程都要有自己的备用栈，栈溢出时处理函数才能运行
+        if(__builtin_expect(!context.hasAltStack(), 0) && LogCrashHandler::IsInstalled()) {
+            context.installAltStack(LogCrashHandler::ALTSTACK_SIZE);
+        }
+    } else {
+        m_context = nullptr;
+        m_mdcDepth = 0;
+    }
+
+    m_buf.reset();
+    // 复用的事件需要恢复流的默认状态
+    m_stream.reset();
+    m_fields.clear();
+    m_fieldData.clear();
+}
+
+int LogEvent::StreamIndex() {
+    static const int s_index = std::ios_base::xalloc();
+    return s_index;
+}
+
+LogEvent* LogEvent::FromStream(std::ostream& os) {
+    return static_cast<LogEvent*>(os.pword(StreamIndex()));
+}
+
+LogField& LogEvent::newField(const char* key, LogField::Type type) {
+    size_t len = strlen(key);
+    m_fields.push_back(LogField());
+    LogField& field = m_fields.back();
+    field.type = type;
+    field.key_offset = m_fieldData.size();
+    field.key_len = len;
+    field.offset = 0;
+    field.len = 0;
+    m_fieldData.append(key, len);
+    return field;
+}
+
+void LogEvent::addInt(const char* key, int64_t v) {
+    newField(key, LogField::INT).i = v;
+}
+
+void LogEvent::addUInt(const char* key, uint64_t v) {
+    newField(key, LogField::UINT).u = v;
+}
+
+void LogEvent::addDouble(const char* key, double v) {
+    newField(key, LogField::DOUBLE).d = v;
+}
+
+void LogEvent::addBool(const char* key, bool v) {
+    newField(key, LogField::BOOL).b = v;
+}
+
+void LogEvent::addString(const char* key, const char* v, size_t len) {
+    LogField& field = newField(key, LogField::STRING);
+    field.offset = m_fieldData.size();
+    field.len = len;
+    m_fieldData.append(v, len);
 }
 
 void LogEvent::format(const char* fmt, ...){
@@ -46,147 +392,429 @@ void LogEvent::format(const char* fmt, ...){
 }
 
 void LogEvent::format(const char* fmt, va_list al){
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);     // 自动生成buf内存空间，需要手动释放
-    if(len != -1){
-        m_ss << buf;
-        free(buf);
+    m_buf.vappendf(fmt, al);
+}
+
+/**
+ * @brief 线程级日志事件池
+ */
+struct LogEventPool {
+    ~LogEventPool() {
+        for(auto i : free) {
+            delete i;
+        }
+    }
+
+    LogEvent* acquire(Logger* logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time) {
+        if(free.empty()) {
+            return new LogEvent(logger, level, file, line, elapse, threadId, fiberId, time);
+        }
+        LogEvent* event = free.back();
+        free.pop_back();
+        event->reset(logger, level, file, line, elapse, threadId, fiberId, time);
+        return event;
+    }
+
+    void release(LogEvent* event) {
+        free.push_back(event);
     }
+
+    // 空闲的事件，日志内容中再打日志时会同时占用多个
+    std::vector<LogEvent*> free;
+};
+
+static thread_local LogEventPool s_event_pool;
+
+LogEventWarp::LogEventWarp(Logger* logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time)
+    : m_event(s_event_pool.acquire(logger, level, file, line, elapse, threadId, fiberId, time)) {
 }
 
-LogEventWarp::LogEventWarp(LogEvent::ptr event) 
-    : m_event(event) {
+LogEventWarp::LogEventWarp(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time)
+    : LogEventWarp(logger.get(), level, file, line, elapse, threadId, fiberId, time) {
+}
 
+LogEventWarp::LogEventWarp(LogEvent::ptr event)
+    : m_event(event.get())
+    , m_holder(event) {
 }
 
 LogEventWarp::~LogEventWarp(){
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+    Logger* logger = m_event->getLogger();
+    logger->log(m_event->getLevel(), *m_event);
+    // FATAL之后进程通常马上退出，补一条调用栈，再把所有缓冲的日志写出去，不要求安装了崩溃处理
+    if(m_event->getLevel() == LogLevel::FATAL) {
+        LogEvent* trace = s_event_pool.acquire(logger, LogLevel::FATAL, m_event->getFile(), m_event->getLine(),
+                                               m_event->getElapse(), m_event->getThreadId(), m_event->getFiberId(),
+                                               m_event->getTime());
+        trace->getStream() << "backtrace:\n" << LogCrashHandler::Backtrace(1);
+        logger->log(LogLevel::FATAL, *trace);
+        s_event_pool.release(trace);
+        LogCrashHandler::FlushAll();
+    }
+    if(!m_holder) {
+        s_event_pool.release(m_event);
+    }
 }
 
-std::stringstream& LogEventWarp::getSS() {
+std::ostream& LogEventWarp::getSS() {
     return m_event->getSS();
 }
 
-class MessageFormatItem : public LogFormater::FormatItem{
-public:
-    MessageFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getContext();
+LogStream& LogEventWarp::getStream() {
+    return m_event->getStream();
+}
+
+void AtomicLogLimit::store(const LogLimit& limit) {
+    m_rate.store(limit.rate, std::memory_order_relaxed);
+    m_burst.store(limit.burst, std::memory_order_relaxed);
+    m_sample.store(limit.sample, std::memory_order_relaxed);
+    m_summaryInterval.store(limit.summary_interval, std::memory_order_relaxed);
+    m_enabled.store(limit.isEnabled(), std::memory_order_relaxed);
+}
+
+LogLimit AtomicLogLimit::load() const {
+    LogLimit limit;
+    limit.rate = m_rate.load(std::memory_order_relaxed);
+    limit.burst = m_burst.load(std::memory_order_relaxed);
+    limit.sample = m_sample.load(std::memory_order_relaxed);
+    limit.summary_interval = m_summaryInterval.load(std::memory_order_relaxed);
+    return limit;
+}
+
+AtomicLogLimit Logger::s_globalLimit;
+// 从1开始，新建日志器缓存的代数0一定失效
+std::atomic<uint64_t> Logger::s_generation{1};
+std::atomic<uint64_t> Logger::s_config{0};
+const uint64_t Logger::FILTER_FLAG;
+
+const char* LogRenderCache::get(const LogFormater* formater, const LogEvent& event, size_t& len, bool& rendered) {
+    for(auto& i : m_items) {
+        if(i.formater == formater) {
+            len = i.len;
+            rendered = false;
+            return m_buf.c_str() + i.offset;
+        }
     }
-};
+    Item item;
+    item.formater = formater;
+    item.offset = m_buf.size();
+    formater->render(m_buf, event);
+    item.len = m_buf.size() - item.offset;
+    m_items.push_back(item);
+    len = item.len;
+    rendered = true;
+    return m_buf.c_str() + item.offset;
+}
+
+namespace {
 
-class LevelFormatItem : public LogFormater::FormatItem{
+/**
+ * @brief 当前线程复用的格式化缓存
+ * @details 写日志的过程中又写日志时(例如Appender内部出错打印日志)，改用临时对象，不破坏外层的结果
+ */
+class LocalRenderCache {
 public:
-    LevelFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << LogLevel::toString(event->getLevel());
+    LocalRenderCache()
+        : m_owner(!s_busy) {
+        if(m_owner) {
+            s_busy = true;
+            s_cache.clear();
+        }
     }
-};
 
-class ElapseFormatItem : public LogFormater::FormatItem{
-public:
-    ElapseFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getElapse();
+    ~LocalRenderCache() {
+        if(m_owner) {
+            s_busy = false;
+        }
     }
+
+    LogRenderCache& get() { return m_owner ? s_cache : m_temp; }
+private:
+    static thread_local bool s_busy;
+    static thread_local LogRenderCache s_cache;
+    bool m_owner;
+    LogRenderCache m_temp;
 };
 
-class NameFormatItem : public LogFormater::FormatItem{
-public:
-    NameFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getLogger()->getName();
+thread_local bool LocalRenderCache::s_busy = false;
+thread_local LogRenderCache LocalRenderCache::s_cache;
+
+}
+
+Logger::Logger(const std::string& name)
+    :m_name(name)
+    ,m_level(LogLevel::DEBUG)
+    ,m_effective(0)
+    ,m_parent(nullptr)
+    ,m_staged(nullptr)
+    ,m_hasLimit(false) {
+    m_formatter.reset(new LogFormater("[%c][%p][%d{%Y-%m-%d %H:%M:%S}.%ms][%f][%l][%t][%F]%T%m%n"));
+    AppendJsonEscaped(m_escapedName[LogFormater::JSON - 1], m_name.c_str(), m_name.size());
+    AppendLogfmtValue(m_escapedName[LogFormater::LOGFMT - 1], m_name.c_str(), m_name.size());
+}
+
+Logger::~Logger() {
+    // 暂存了但没有发布的配置
+    delete m_staged.load(std::memory_order_relaxed);
+}
+
+void Logger::setLimit(const LogLimit& limit) {
+    m_limit.store(limit);
+    m_hasLimit.store(true, std::memory_order_relaxed);
+}
+
+void Logger::clearLimit() {
+    m_hasLimit.store(false, std::memory_order_relaxed);
+}
+
+void Logger::setLevel(LogLevel::Level level) {
+    m_level.store(level, std::memory_order_relaxed);
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+uint64_t Logger::resolve() const {
+    // 先取代数，计算期间发生的修改会使缓存在下次调用时失效
+    uint64_t generation = s_generation.load(std::memory_order_acquire);
+    LogLevel::Level level = LogLevel::DEBUG;
+    LogLevel::Level gate;
+    bool has_filter = false;
+    {
+        RcuReadGuard guard;
+        for(const Logger* l = this; l; l = l->m_parent.load(std::memory_order_acquire)) {
+            LogLevel::Level v = l->m_level.load(std::memory_order_relaxed);
+            if(v != LogLevel::UNKNOWN) {
+                level = v;
+                break;
+            }
+        }
+        gate = level;
+        // 日志器名称和级别条件在这里算好，只剩这些条件时宏只需要比较级别
+        const LogFilter* filter = findFilter(s_config.load(std::memory_order_seq_cst));
+        if(filter) {
+            bool exact = true;
+            gate = (LogLevel::Level)filter->resolve(m_name, level, exact);
+            has_filter = !exact;
+        }
     }
-};
+    uint64_t v = generation << 16 | (has_filter ? FILTER_FLAG : 0) | gate << 4 | level;
+    m_effective.store(v, std::memory_order_release);
+    return v;
+}
 
-class ThreadIdFormatItem : public LogFormater::FormatItem{
-public:
-    ThreadIdFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getThreadId();
+const LogFilter* Logger::findFilter(uint64_t config) const {
+    for(const Logger* l = this; l; l = l->m_parent.load(std::memory_order_acquire)) {
+        const LogFilter* filter = l->getOwnFilter(config);
+        if(filter) {
+            return filter;
+        }
     }
-};
+    return nullptr;
+}
 
-class FiberIdFormatItem : public LogFormater::FormatItem{
-public:
-    FiberIdFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getFiberId();
+void Logger::setFilter(LogFilter::ptr filter) {
+    m_filter.update([&filter](LogFilter::ptr& value) {
+        value = filter;
+        return true;
+    });
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+LogFilter::ptr Logger::getFilter() const {
+    RcuReadGuard guard;
+    const StagedConfig* staged = getStaged(s_config.load(std::memory_order_seq_cst));
+    return staged ? staged->filter : *m_filter.get();
+}
+
+bool Logger::decide(int result, LogLevel::Level level) const {
+    if(result == LogFilter::DENY || (result == LogFilter::NEUTRAL && level < getLevel())) {
+        m_stats.add(LogStats::FILTERED);
+        return false;
     }
-};
+    return true;
+}
 
-class DateTimeFormatItem : public LogFormater::FormatItem{
-public:
-    DateTimeFormatItem(const std::string& format = "%Y-%m-%d %H:%M:%S")
-        : m_format(format) {
-            if(format.empty()) m_format = "%Y-%m-%d %H:%M:%S";
-        }
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        time_t rawtime = static_cast<time_t>(event->getTime());
-        struct tm timeinfo;
-        localtime_r(&rawtime, &timeinfo); // 该函数是线程安全的
-        char buffer[60];
-        strftime(buffer, sizeof(buffer), m_format.c_str(), &timeinfo);
-        os << buffer;
+bool Logger::filter(LogLevel::Level level, const char* file) const {
+    int result = LogFilter::NEUTRAL;
+    {
+        RcuReadGuard guard;
+        const LogFilter* filter = findFilter(s_config.load(std::memory_order_seq_cst));
+        if(filter) {
+            result = filter->decide(level, m_name, file);
+        }
     }
-private:
-    std::string m_format;
-};
+    return decide(result, level);
+}
 
-class FilenameFormatItem : public LogFormater::FormatItem{
-public:
-    FilenameFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getFile();
+void Logger::assign(const Logger& oth) {
+    AppenderList appenders;
+    {
+        RcuReadGuard guard;
+        appenders = *oth.getAppenderList(s_config.load(std::memory_order_seq_cst));
     }
-};
+    m_formatter = oth.m_formatter;
+    setAppenders(appenders);
+    setFilter(oth.getFilter());
+    if(oth.m_hasLimit.load(std::memory_order_relaxed)) {
+        setLimit(oth.m_limit.load());
+    } else {
+        clearLimit();
+    }
+    setLevel(oth.getOwnLevel());
+}
 
-class LineFormatItem : public LogFormater::FormatItem{
-public:
-    LineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << event->getLine();
+void Logger::setParent(const Logger::ptr& parent) {
+    // 旧的父日志器还在注册表的旧版本中，宽限期结束前不会释放
+    m_parentHolder = parent;
+    m_parent.store(parent.get(), std::memory_order_release);
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+LogLimit Logger::getLimit() const {
+    return m_hasLimit.load(std::memory_order_relaxed) ? m_limit.load() : s_globalLimit.load();
+}
+
+void Logger::SetGlobalLimit(const LogLimit& limit) {
+    s_globalLimit.store(limit);
+}
+
+LogLimit Logger::GetGlobalLimit() {
+    return s_globalLimit.load();
+}
+
+bool LogSite::check(Logger* logger, LogLevel::Level level) {
+    if(logger->hasFilter() && !logger->filter(level, m_file)) {
+        return false;
     }
-};
+    return !logger->isLimited() || checkLimit(logger, level);
+}
 
-class NewLineFormatItem : public LogFormater::FormatItem{
-public:
-    NewLineFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << std::endl;
+bool LogSite::checkLimit(Logger* logger, LogLevel::Level level) {
+    LogLimit limit = logger->getLimit();
+    uint64_t now = GetMonotonicNS();
+    bool pass = true;
+    if(limit.sample > 1 && m_count.fetch_add(1, std::memory_order_relaxed) % limit.sample != 0) {
+        pass = false;
+    }
+    if(pass && limit.rate) {
+        // GCRA: 每条日志把理论到达时间推后interval，超前当前时间超过桶容量时拒绝
+        uint64_t interval = 1000000000ull / limit.rate;
+        uint64_t burst = (uint64_t)(limit.burst ? limit.burst : limit.rate) * interval;
+        uint64_t tat = m_tat.load(std::memory_order_relaxed);
+        while(true) {
+            uint64_t next = std::max(tat, now) + interval;
+            if(next > now + burst) {
+                pass = false;
+                break;
+            }
+            if(m_tat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+    }
+    if(!pass) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        logger->addStat(LogStats::DROPPED);
     }
-};
 
-class StringFormatItem : public LogFormater::FormatItem{
-public:
-    StringFormatItem(const std::string& str = "")
-        :m_content(str) {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << m_content;
+    if(m_suppressed.load(std::memory_order_relaxed)) {
+        uint64_t last = m_lastSummary.load(std::memory_order_relaxed);
+        // 第一次被限流时只开始计时
+        if(last == 0) {
+            m_lastSummary.compare_exchange_strong(last, now);
+        } else if(now >= last + limit.summary_interval * 1000000ull
+                && m_lastSummary.compare_exchange_strong(last, now)) {
+            uint64_t n = m_suppressed.exchange(0, std::memory_order_relaxed);
+            if(n) {
+                LogEventWarp(logger, level, m_file, m_line, 0, GetThreadId(), GetFiberId(), 0).getStream()
+                    << "suppressed " << n << " messages in " << (now - last) / 1000000 << "ms";
+            }
+        }
     }
-private:
-    std::string m_content;
-};
+    return pass;
+}
 
-class TabFormatItem : public LogFormater::FormatItem{
-public:
-    TabFormatItem(const std::string& str = "") {}
-    void format(std::ostream& os, LogEvent::ptr event) override {
-        os << "\t";
+void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
+    log(level, *event);
+}
+
+void Logger::log(LogLevel::Level level, const LogEvent& event) {
+    if(!isEnabled(level)) {
+        return;
     }
-};
+    RcuReadGuard guard;
+    dispatch(level, event);
+}
 
-Logger::Logger(const std::string& name)
-    :m_name(name)
-    ,m_level(LogLevel::DEBUG) {
-    m_formatter.reset(new LogFormater("[%c][%p][%d{%Y-%m-%d %H:%M:%S}][%f][%l][%t][%F]%T%m%n"));
+void Logger::dispatch(LogLevel::Level level, const LogEvent& event) {
+    // 整条日志只取一次配置代数，批量发布的配置要么全部可见，要么全部不可见
+    uint64_t config = s_config.load(std::memory_order_seq_cst);
+    // 过滤器在格式化之前判断，宏的检查只排除了不需要消息内容的规则
+    if(hasFilter()) {
+        const LogFilter* filter = findFilter(config);
+        if(!decide(filter ? filter->decide(level, event) : LogFilter::NEUTRAL, level)) {
+            return;
+        }
+    }
+    m_stats.add(LogStats::ACCEPTED);
+    // 没有Appender时使用最近的有Appender的祖先
+    const Logger* logger = this;
+    const AppenderList* appenders = getAppenderList(config);
+    while(appenders->empty() && (logger = logger->m_parent.load(std::memory_order_acquire))) {
+        appenders = logger->getAppenderList(config);
+    }
+    // 使用同一个格式器的Appender共用一次格式化结果
+    LocalRenderCache cache;
+    for(auto& item : *appenders){
+        item->logRendered(level, event, cache.get());
+    }
 }
 
-void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
-    if(m_level <= level){
-        for(auto& item : m_appenders){
-            item->log(level, event);
+void Logger::stageConfig(const std::vector<LogAppender::ptr>& appenders, LogFilter::ptr filter) {
+    for(auto& i : appenders) {
+        if(!i->getFormater()) {
+            i->setFormater(m_formatter);
+        }
+    }
+    StagedConfig* staged = new StagedConfig;
+    staged->appenders = appenders;
+    staged->filter = filter;
+    staged->config = s_config.load(std::memory_order_relaxed) + 1;
+    StagedConfig* old = m_staged.exchange(staged, std::memory_order_seq_cst);
+    if(old) {
+        Rcu::Retire([](void* p) { delete (StagedConfig*)p; }, old);
+    }
+}
+
+void Logger::PublishConfig(const std::vector<Logger::ptr>& loggers) {
+    // 唯一的发布点：之后开始的日志在所有日志器上都看到暂存的配置
+    s_config.fetch_add(1, std::memory_order_seq_cst);
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+    // 只有写者等待：取到旧代数的日志结束之后，才能把暂存的配置写回日志器
+    Rcu::Synchronize();
+    std::vector<StagedConfig*> done;
+    for(auto& i : loggers) {
+        StagedConfig* staged = i->m_staged.load(std::memory_order_relaxed);
+        if(!staged) {
+            continue;
         }
+        AppenderList& appenders = staged->appenders;
+        i->m_appenders.update([&appenders](AppenderList& list) {
+            list = appenders;
+            return true;
+        });
+        LogFilter::ptr& filter = staged->filter;
+        i->m_filter.update([&filter](LogFilter::ptr& value) {
+            value = filter;
+            return true;
+        });
+        // 写回之后再清除，读到空指针的日志使用的已经是新配置
+        i->m_staged.store(nullptr, std::memory_order_seq_cst);
+        done.push_back(staged);
+    }
+    s_generation.fetch_add(1, std::memory_order_acq_rel);
+    Rcu::Synchronize();
+    for(auto i : done) {
+        delete i;
     }
 }
 
@@ -214,16 +842,42 @@ void Logger::addAppender(LogAppender::ptr appender) {
     if(!appender->getFormater()){
         appender->setFormater(m_formatter);
     }
-    m_appenders.push_back(appender);
+    m_appenders.update([&appender](AppenderList& appenders) {
+        appenders.push_back(appender);
+        return true;
+    });
 }
 
-void Logger::delAppender(LogAppender::ptr appender) {
-    for (auto it = m_appenders.begin(); it != m_appenders.end(); ++it){
-        if(*it == appender){
-            m_appenders.erase(it);
-            break;
+void Logger::setAppenders(const std::vector<LogAppender::ptr>& appenders) {
+    for(auto& i : appenders) {
+        if(!i->getFormater()) {
+            i->setFormater(m_formatter);
         }
     }
+    m_appenders.update([&appenders](AppenderList& list) {
+        list = appenders;
+        return true;
+    });
+}
+
+bool Logger::setFormatter(const std::string& pattern) {
+    LogFormater::ptr formatter(new LogFormater(pattern));
+    if(formatter->isError()) {
+        return false;
+    }
+    m_formatter = formatter;
+    return true;
+}
+
+void Logger::delAppender(LogAppender::ptr appender) {
+    m_appenders.update([&appender](AppenderList& appenders) {
+        auto it = std::find(appenders.begin(), appenders.end(), appender);
+        if(it == appenders.end()) {
+            return false;
+        }
+        appenders.erase(it);
+        return true;
+    });
 }
 
 LogFormater::ptr LogAppender::getFormater() const {
@@ -234,54 +888,1127 @@ void LogAppender::setFormater(LogFormater::ptr formater) {
     m_formater = formater;
 }
 
-void StdoutLogAppneder::log(LogLevel::Level level, LogEvent::ptr event) {
-    if(level >= m_level) {
-        std::cout << m_formater->format(event);
-    }
+void LogAppender::setFilter(LogFilter::ptr filter) {
+    m_filter.update([&filter](LogFilter::ptr& value) {
+        value = filter;
+        return true;
+    });
 }
 
-FileLogAppneder::FileLogAppneder(const std::string& filename)
-    : m_filename(filename) {
-        reopen();
+LogFilter::ptr LogAppender::getFilter() const {
+    RcuReadGuard guard;
+    return *m_filter.get();
 }
 
-bool FileLogAppneder::reopen() {
-    if(m_filestream) {
-        m_filestream.close();
+bool LogAppender::accept(LogLevel::Level level, const LogEvent& event) {
+    LogFilter::Result result = LogFilter::NEUTRAL;
+    {
+        RcuReadGuard guard;
+        const LogFilter* filter = m_filter.get()->get();
+        if(filter) {
+            result = filter->decide(level, event);
+        }
     }
-    m_filestream.open(m_filename);
-
-    return !!m_filestream;
+    if(result == LogFilter::DENY || (result == LogFilter::NEUTRAL && level < m_level)) {
+        m_stats.add(LogStats::FILTERED);
+        return false;
+    }
+    return true;
 }
 
-void FileLogAppneder::log(LogLevel::Level level, LogEvent::ptr event) {
-    if(level >= m_level) {
-        m_filestream << m_formater->format(event);
+void LogAppender::renderAppend(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+    if(!accept(level, event)) {
+        return;
     }
+    LogStats::Timing timing(m_stats);
+    size_t len = 0;
+    bool rendered = false;
+    const char* data = cache.get(m_formater.get(), event, len, rendered);
+    if(rendered) {
+        timing.lap(LogStats::FORMAT_TIME);
+    }
+    m_stats.addRecord(len);
+    append(level, event, data, len);
+    timing.lap(LogStats::WRITE_TIME);
 }
 
-LogFormater::LogFormater(const std::string& pattern)
-    :m_pattern(pattern) {
-    init();
+void LogAppender::renderAppend(LogLevel::Level level, const LogEvent& event) {
+    LocalRenderCache cache;
+    renderAppend(level, event, cache.get());
 }
 
-std::string LogFormater::format(LogEvent::ptr event) {
-    std::stringstream ss;
-    for (auto& item : m_items)
-    {
-        item->format(ss, event);
+/**
+ * @brief 公共的定时刷新线程
+ * @details 只持有Appender的弱引用，Appender释放后自动移除
+ */
+class LogFlusher {
+public:
+    static LogFlusher* GetInstance() {
+        static LogFlusher s_flusher;
+        return &s_flusher;
     }
-    return ss.str();
-}
-
-// %XXX %XXX{XXX} %% --> datetime%%:%d{YY MM DD HH SS SS}
-void LogFormater::init() {
-    std::vector<std::tuple<std::string, std::string, int>> vec;
-    std::string nstr;
 
-    for(size_t i = 0; i < m_pattern.size(); ++i){
+    ~LogFlusher() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_cond.notify_one();
+        }
+        if(m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
 
-        // 正常的字符
+    /**
+     * @brief 设置Appender的刷新间隔，0表示移除
+     */
+    void set(const LogAppender::ptr& appender, uint32_t interval) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for(auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if(it->appender.lock() == appender) {
+                m_entries.erase(it);
+                break;
+            }
+        }
+        if(interval) {
+            Entry entry;
+            entry.appender = appender;
+            entry.interval = interval * 1000000ull;
+            entry.next = GetMonotonicNS() + entry.interval;
+            m_entries.push_back(entry);
+            if(!m_thread.joinable()) {
+                m_thread = std::thread(std::bind(&LogFlusher::run, this));
+            }
+        }
+        m_cond.notify_one();
+    }
+private:
+    void run() {
+        std::vector<LogAppender::ptr> due;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(!m_stopping) {
+            uint64_t now = GetMonotonicNS();
+            uint64_t next = now + 1000000000ull;
+            for(auto it = m_entries.begin(); it != m_entries.end();) {
+                LogAppender::ptr appender = it->appender.lock();
+                if(!appender) {
+                    it = m_entries.erase(it);
+                    continue;
+                }
+                if(it->next <= now) {
+                    due.push_back(appender);
+                    it->next = now + it->interval;
+                }
+                next = std::min(next, it->next);
+                ++it;
+            }
+            if(!due.empty()) {
+                // 刷新可能要写文件，不持有锁
+                lock.unlock();
+                for(auto& i : due) {
+                    i->flush();
+                }
+                due.clear();
+                lock.lock();
+                continue;
+            }
+            m_cond.wait_for(lock, std::chrono::nanoseconds(next - now));
+        }
+    }
+private:
+    struct Entry {
+        std::weak_ptr<LogAppender> appender;
+        // 间隔和下次刷新的时间(纳秒)
+        uint64_t interval;
+        uint64_t next;
+    };
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Entry> m_entries;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
+
+void LogAppender::setFlushPolicy(const LogFlushPolicy& policy) {
+    bool timed = getFlushInterval() != 0;
+    m_flushPolicy = policy;
+    m_flushEnabled = policy.isEnabled();
+    if(timed || getFlushInterval()) {
+        startFlushTimer();
+    }
+}
+
+void LogAppender::startFlushTimer() {
+    LogFlusher::GetInstance()->set(shared_from_this(), getFlushInterval());
+}
+
+bool LogAppender::checkFlush(LogLevel::Level level, size_t len) {
+    bool flush = m_flushPolicy.level != LogLevel::UNKNOWN && level >= m_flushPolicy.level;
+    if(m_flushPolicy.records
+            && m_flushRecords.fetch_add(1, std::memory_order_relaxed) + 1 >= m_flushPolicy.records) {
+        flush = true;
+    }
+    if(m_flushPolicy.bytes
+            && m_flushBytes.fetch_add(len, std::memory_order_relaxed) + len >= m_flushPolicy.bytes) {
+        flush = true;
+    }
+    if(flush) {
+        m_flushRecords.store(0, std::memory_order_relaxed);
+        m_flushBytes.store(0, std::memory_order_relaxed);
+    }
+    return flush;
+}
+
+void StdoutLogAppneder::log(LogLevel::Level level, const LogEvent& event) {
+    renderAppend(level, event);
+}
+
+void StdoutLogAppneder::logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+    renderAppend(level, event, cache);
+}
+
+void StdoutLogAppneder::append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) {
+    std::cout.write(data, len);
+    if(shouldFlush(level, len)) {
+        std::cout.flush();
+    }
+}
+
+void StdoutLogAppneder::flush() {
+    std::cout.flush();
+}
+
+std::string StdoutLogAppneder::getName() const {
+    return "StdoutLogAppender";
+}
+
+FileLogAppneder::FileLogAppneder(const std::string& filename)
+    : m_filename(filename)
+    , m_buffer(new char[BUFFER_SIZE]) {
+        reopen();
+        LogCrashHandler::Register(this);
+}
+
+FileLogAppneder::~FileLogAppneder() {
+    LogCrashHandler::Unregister(this);
+    // 先停掉写入器，积压的日志还要通过文件写出
+    m_async.reset();
+    m_sharded.reset();
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushBuffer();
+    if(m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+bool FileLogAppneder::reopen() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushBuffer();
+    if(m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    return m_fd >= 0;
+}
+
+void FileLogAppneder::setAsync(const AsyncLogWriter::Config& config) {
+    // 先停掉旧的写入器，保证积压的日志写完
+    m_sharded.reset();
+    m_async.reset();
+    m_async.reset(new AsyncLogWriter(
+        std::bind(&FileLogAppneder::write, this, std::placeholders::_1, std::placeholders::_2),
+        [this]() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            flushBuffer();
+        }, config));
+}
+
+void FileLogAppneder::setSharded(const ShardedLogWriter::Config& config) {
+    m_async.reset();
+    m_sharded.reset();
+    m_sharded.reset(new ShardedLogWriter(
+        std::bind(&FileLogAppneder::writev, this, std::placeholders::_1, std::placeholders::_2),
+        []() {}, config));
+}
+
+void FileLogAppneder::log(LogLevel::Level level, const LogEvent& event) {
+    renderAppend(level, event);
+}
+
+void FileLogAppneder::logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+    renderAppend(level, event, cache);
+}
+
+void FileLogAppneder::append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) {
+    if(m_sharded) {
+        m_sharded->append(event.getTimeNS(), data, len);
+    } else if(m_async) {
+        m_async->append(data, len);
+    } else {
+        write(data, len);
+    }
+    if(shouldFlush(level, len)) {
+        // 异步模式下只通知后台线程，FATAL之后进程可能退出，等待写完
+        if(!isAsync() || level >= LogLevel::FATAL) {
+            flush();
+        } else if(m_sharded) {
+            m_sharded->requestFlush();
+        } else {
+            m_async->requestFlush();
+        }
+    }
+}
+
+std::string FileLogAppneder::getName() const {
+    return "FileLogAppender:" + m_filename;
+}
+
+LogStats::Snapshot FileLogAppneder::getStats() const {
+    LogStats::Snapshot snap = m_stats.snapshot();
+    snap.counters[LogStats::DROPPED] += getDropped();
+    if(m_async) {
+        snap.queue_high_water = m_async->getHighWater();
+    } else if(m_sharded) {
+        snap.queue_high_water = m_sharded->getHighWater();
+    }
+    return snap;
+}
+
+void FileLogAppneder::flush() {
+    if(m_sharded) {
+        m_sharded->flush();
+    } else if(m_async) {
+        m_async->flush();
+    } else {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        flushBuffer();
+    }
+}
+
+int FileLogAppneder::crashDrain() {
+    // 按写入顺序：先是同步缓冲区，再是写入器中积压的数据
+    WriteAll(m_fd, m_buffer.get(), m_bufferLen);
+    m_bufferLen = 0;
+    if(m_async) {
+        m_async->drainTo(m_fd);
+    }
+    if(m_sharded) {
+        m_sharded->drainTo(m_fd);
+    }
+    return m_fd;
+}
+
+void FileLogAppneder::write(const char* data, size_t len) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_bufferLen + len > BUFFER_SIZE) {
+        flushBuffer();
+    }
+    if(len > BUFFER_SIZE) {
+        WriteAll(m_fd, data, len);
+    } else {
+        memcpy(m_buffer.get() + m_bufferLen, data, len);
+        m_bufferLen += len;
+    }
+}
+
+void FileLogAppneder::flushBuffer() {
+    WriteAll(m_fd, m_buffer.get(), m_bufferLen);
+    m_bufferLen = 0;
+}
+
+void FileLogAppneder::writev(struct iovec* iov, int cnt) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(cnt > 0 && m_fd >= 0) {
+        ssize_t n = ::writev(m_fd, iov, cnt);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        // 部分写入时跳过已写出的部分
+        while(cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if(cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+RollingFileLogAppender::RollingFileLogAppender(const std::string& filename, const Config& config)
+    : m_filename(filename)
+    , m_config(config) {
+    if(m_config.buffer_size == 0) {
+        m_config.buffer_size = Config().buffer_size;
+    }
+    m_buffer.reset(new char[m_config.buffer_size]);
+    m_fd = openFile();
+    struct stat st;
+    if(m_fd >= 0 && fstat(m_fd, &st) == 0) {
+        m_size = st.st_size;
+    }
+    m_nextRotate = nextRotateTime(time(0));
+    m_lastFlush = GetCurrentNS();
+    if(m_config.compress || m_config.max_files) {
+        m_compressor.reset(new LogCompressor(m_config.compress_config));
+        // 压缩完成后再清理，不会删掉排队中的原文件
+        if(m_config.max_files) {
+            m_compressor->setCallback(std::bind(&RollingFileLogAppender::removeOldFiles, this));
+        }
+    }
+    LogCrashHandler::Register(this);
+}
+
+RollingFileLogAppender::RollingFileLogAppender(const std::string& filename)
+    : RollingFileLogAppender(filename, Config()) {
+}
+
+/**
+ * @brief 去掉预分配但没有用到的空间
+ * @details 文件可能还有其他进程在追加写，m_size只是本进程写入的部分，按文件当前的实际大小截断，
+ *          只释放文件末尾之后预分配的块
+ */
+static void TrimPreallocated(int fd) {
+    struct stat st;
+    if(fstat(fd, &st) == 0) {
+        ftruncate(fd, st.st_size);
+    }
+}
+
+RollingFileLogAppender::~RollingFileLogAppender() {
+    LogCrashHandler::Unregister(this);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushBuffer();
+    if(m_fd >= 0) {
+        if(m_config.preallocate) {
+            TrimPreallocated(m_fd);
+        }
+        ::close(m_fd);
+    }
+}
+
+int RollingFileLogAppender::openFile() {
+    int fd = ::open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd >= 0 && m_config.preallocate) {
+        // 只分配磁盘块，不改变文件大小，追加写不会写到预分配的空洞之后
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, m_config.preallocate);
+    }
+    return fd;
+}
+
+void RollingFileLogAppender::log(LogLevel::Level level, const LogEvent& event) {
+    renderAppend(level, event);
+}
+
+void RollingFileLogAppender::logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+    renderAppend(level, event, cache);
+}
+
+void RollingFileLogAppender::append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_flushTimer) {
+        // 构造函数里还不能取shared_from_this()，第一次写入时注册
+        m_flushTimer = true;
+        startFlushTimer();
+    }
+    if(m_bufferLen + len > m_config.buffer_size) {
+        flushBuffer();
+    }
+    if(len > m_config.buffer_size) {
+        WriteAll(m_fd, data, len);
+    } else {
+        memcpy(m_buffer.get() + m_bufferLen, data, len);
+        m_bufferLen += len;
+    }
+    m_size += len;
+
+    if(event.getTimeNS() >= m_lastFlush + m_config.flush_interval * 1000000ull
+            || shouldFlush(level, len)) {
+        flushBuffer();
+    }
+    if(m_rotating) {
+        return;
+    }
+    if((m_config.max_size && m_size >= m_config.max_size)
+            || (m_config.interval && event.getTime() >= m_nextRotate)) {
+        lock.unlock();
+        rotate();
+    }
+}
+
+uint32_t RollingFileLogAppender::getFlushInterval() const {
+    uint32_t interval = LogAppender::getFlushInterval();
+    if(m_config.flush_interval && (interval == 0 || m_config.flush_interval < interval)) {
+        interval = m_config.flush_interval;
+    }
+    return interval;
+}
+
+std::string RollingFileLogAppender::getName() const {
+    return "RollingFileLogAppender:" + m_filename;
+}
+
+void RollingFileLogAppender::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    flushBuffer();
+}
+
+int RollingFileLogAppender::crashDrain() {
+    WriteAll(m_fd, m_buffer.get(), m_bufferLen);
+    m_bufferLen = 0;
+    return m_fd;
+}
+
+void RollingFileLogAppender::flushBuffer() {
+    m_lastFlush = GetCurrentNS();
+    WriteAll(m_fd, m_buffer.get(), m_bufferLen);
+    m_bufferLen = 0;
+}
+
+void RollingFileLogAppender::rotate() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_rotating) {
+        return;
+    }
+    m_rotating = true;
+    lock.unlock();
+
+    // 改名不影响已经打开的文件描述符，其他线程继续写入的内容归入旧文件
+    time_t now = time(0);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char suffix[64];
+    strftime(suffix, sizeof(suffix), ".%Y%m%d-%H%M%S", &tm);
+    std::string archive = m_filename + suffix;
+    // 同一秒内多次滚动时追加序号
+    for(int i = 1; access(archive.c_str(), F_OK) == 0; ++i) {
+        char seq[16];
+        snprintf(seq, sizeof(seq), ".%03d", i);
+        archive = m_filename + suffix + seq;
+    }
+    rename(m_filename.c_str(), archive.c_str());
+    int fd = openFile();
+
+    lock.lock();
+    flushBuffer();
+    int old = m_fd;
+    if(fd >= 0) {
+        m_fd = fd;
+    }
+    m_size = 0;
+    m_nextRotate = nextRotateTime(now);
+    m_rotating = false;
+    lock.unlock();
+
+    if(old >= 0 && old != m_fd) {
+        if(m_config.preallocate) {
+            TrimPreallocated(old);
+        }
+        ::close(old);
+    }
+    // 压缩和清理在后台线程进行，写日志的线程只提交文件名，不遍历目录
+    if(m_config.compress) {
+        m_compressor->submit(archive);
+    } else if(m_compressor) {
+        m_compressor->schedule();
+    }
+}
+
+void RollingFileLogAppender::waitCompress() {
+    if(m_compressor) {
+        m_compressor->wait();
+    }
+}
+
+uint64_t RollingFileLogAppender::nextRotateTime(uint64_t time) const {
+    if(!m_config.interval) {
+        return 0;
+    }
+    // 按本地时间对齐，按天滚动时在本地零点切换
+    time_t t = time;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    int64_t local = (int64_t)time + tm.tm_gmtoff;
+    return (local / m_config.interval + 1) * m_config.interval - tm.tm_gmtoff;
+}
+
+static bool EndsWith(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size()
+        && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void RollingFileLogAppender::removeOldFiles() {
+    if(!m_config.max_files) {
+        return;
+    }
+    std::string dir = ".";
+    std::string base = m_filename;
+    size_t pos = m_filename.rfind('/');
+    if(pos != std::string::npos) {
+        dir = pos ? m_filename.substr(0, pos) : "/";
+        base = m_filename.substr(pos + 1);
+    }
+    // 与滚动时生成的文件名前缀相同，用于和压缩器中排队的文件名比较
+    std::string prefix = m_filename.substr(0, m_filename.size() - base.size());
+    base += ".";
+
+    static const std::string s_tmp = ".tmp";
+    const std::string suffix = LogCompressor::SUFFIX;
+    // 历史文件名去掉压缩后缀 -> 实际存在的文件
+    std::map<std::string, std::vector<std::string> > generations;
+    DIR* d = opendir(dir.c_str());
+    if(!d) {
+        return;
+    }
+    struct dirent* dp = nullptr;
+    while((dp = readdir(d))) {
+        std::string name = dp->d_name;
+        if(name.compare(0, base.size(), base) != 0) {
+            continue;
+        }
+        // 压缩中的临时文件由压缩器自己处理
+        if(EndsWith(name, s_tmp)) {
+            continue;
+        }
+        std::string key = name;
+        if(EndsWith(key, suffix)) {
+            key.resize(key.size() - suffix.size());
+        }
+        generations[key].push_back(name);
+    }
+    closedir(d);
+    if(generations.size() <= m_config.max_files) {
+        return;
+    }
+    // 后缀是时间，按名称排序即按时间排序
+    size_t remove = generations.size() - m_config.max_files;
+    for(auto it = generations.begin(); remove; ++it, --remove) {
+        for(auto& name : it->second) {
+            // 还没压缩完的文件留到下一次清理
+            if(m_compressor && m_compressor->isPending(prefix + name)) {
+                continue;
+            }
+            unlink((dir + "/" + name).c_str());
+        }
+    }
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, const Config& config)
+    : m_filename(filename)
+    , m_config(config) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    if(m_config.segment_size == 0) {
+        m_config.segment_size = Config().segment_size;
+    }
+    m_config.segment_size = (m_config.segment_size + page - 1) / page * page;
+
+    m_fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(m_fd < 0) {
+        return;
+    }
+    struct stat st;
+    if(fstat(m_fd, &st) == 0) {
+        m_offset = st.st_size;
+    }
+    if(m_offset && mapSegment(m_offset - 1)) {
+        // 上次异常退出时文件末尾是未写入的零，从最后一个非零字节之后继续写
+        while(m_offset > m_segmentOffset && m_segment[m_offset - m_segmentOffset - 1] == '\0') {
+            --m_offset;
+        }
+    }
+    m_synced = m_offset;
+    m_lastSync = GetCurrentNS();
+}
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename)
+    : MmapFileLogAppender(filename, Config()) {
+}
+
+MmapFileLogAppender::~MmapFileLogAppender() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_fd < 0) {
+        return;
+    }
+    sync();
+    unmapSegment();
+    // 去掉映射段中没有写到的部分
+    ftruncate(m_fd, m_offset);
+    ::close(m_fd);
+}
+
+bool MmapFileLogAppender::mapSegment(uint64_t offset) {
+    unmapSegment();
+    uint64_t begin = offset / m_config.segment_size * m_config.segment_size;
+    struct stat st;
+    if(fstat(m_fd, &st) != 0) {
+        return false;
+    }
+    if((uint64_t)st.st_size < begin + m_config.segment_size
+            && ftruncate(m_fd, begin + m_config.segment_size) != 0) {
+        return false;
+    }
+    void* addr = mmap(nullptr, m_config.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, begin);
+    if(addr == MAP_FAILED) {
+        return false;
+    }
+    m_segment = (char*)addr;
+    m_segmentOffset = begin;
+    return true;
+}
+
+void MmapFileLogAppender::unmapSegment() {
+    if(m_segment) {
+        munmap(m_segment, m_config.segment_size);
+        m_segment = nullptr;
+    }
+}
+
+void MmapFileLogAppender::sync() {
+    if(!m_segment || m_synced >= m_offset) {
+        m_synced = m_offset;
+        return;
+    }
+    uint64_t begin = std::max(m_synced, m_segmentOffset);
+    size_t page = sysconf(_SC_PAGESIZE);
+    uint64_t aligned = begin / page * page;
+    msync(m_segment + (aligned - m_segmentOffset), m_offset - aligned, MS_SYNC);
+    m_synced = m_offset;
+    m_lastSync = GetCurrentNS();
+}
+
+void MmapFileLogAppender::log(LogLevel::Level level, const LogEvent& event) {
+    renderAppend(level, event);
+}
+
+void MmapFileLogAppender::logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+    renderAppend(level, event, cache);
+}
+
+void MmapFileLogAppender::append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(m_fd < 0) {
+        return;
+    }
+    size_t total = len;
+    while(len > 0) {
+        if(!m_segment || m_offset >= m_segmentOffset + m_config.segment_size) {
+            // 换段前把当前段写完的内容落盘，sync只处理当前映射的段
+            sync();
+            if(!mapSegment(m_offset)) {
+                return;
+            }
+        }
+        // 一条日志可能跨越两段
+        size_t n = std::min<uint64_t>(len, m_segmentOffset + m_config.segment_size - m_offset);
+        memcpy(m_segment + (m_offset - m_segmentOffset), data, n);
+        m_offset += n;
+        data += n;
+        len -= n;
+    }
+
+    if((m_config.sync_level != LogLevel::UNKNOWN && level >= m_config.sync_level)
+            || (m_config.sync_interval
+                && event.getTimeNS() >= m_lastSync + m_config.sync_interval * 1000000ull)
+            || shouldFlush(level, total)) {
+        sync();
+    }
+}
+
+std::string MmapFileLogAppender::getName() const {
+    return "MmapFileLogAppender:" + m_filename;
+}
+
+void MmapFileLogAppender::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    sync();
+}
+
+LogFormater::LogFormater(const std::string& pattern)
+    :m_pattern(pattern)
+    ,m_id(++s_formater_id) {
+    init();
+}
+
+std::string LogFormater::format(LogEvent::ptr event) {
+    std::string buf;
+    render(buf, *event);
+    return buf;
+}
+
+/**
+ * @brief 将无符号整数转换成十进制追加到buf
+ */
+static void AppendUInt(std::string& buf, uint64_t v) {
+    char tmp[24];
+    char* p = FormatUInt(tmp + sizeof(tmp), v);
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+static void AppendInt(std::string& buf, int64_t v) {
+    if(v < 0) {
+        buf.push_back('-');
+        AppendUInt(buf, -(uint64_t)v);
+    } else {
+        AppendUInt(buf, v);
+    }
+}
+
+/**
+ * @brief 定宽补零追加到buf
+ */
+static void AppendPadded(std::string& buf, uint64_t v, int width) {
+    char tmp[24];
+    for(int i = width - 1; i >= 0; --i) {
+        tmp[i] = '0' + v % 10;
+        v /= 10;
+    }
+    buf.append(tmp, width);
+}
+
+/**
+ * @brief 线程级时间缓存，同一秒内复用格式化好的时间串，避免反复调用localtime_r
+ */
+struct DateTimeCache {
+    static const int SLOTS = 4;
+    struct Slot {
+        uint64_t formater = 0;  // 格式器id
+        uint32_t offset = 0;    // 时间格式在格式器中的偏移
+        time_t second = -1;     // 缓存对应的秒
+        size_t len = 0;
+        char buf[64];
+    };
+
+    Slot* get(uint64_t formater, uint32_t offset, time_t second) {
+        for(int i = 0; i < SLOTS; ++i) {
+            Slot& s = slots[i];
+            if(s.formater == formater && s.offset == offset) {
+                if(s.second != second) {
+                    s.second = second;
+                    s.len = 0;
+                }
+                return &s;
+            }
+        }
+        Slot& s = slots[next];
+        next = (next + 1) % SLOTS;
+        s.formater = formater;
+        s.offset = offset;
+        s.second = second;
+        s.len = 0;
+        return &s;
+    }
+
+    Slot slots[SLOTS];
+    int next = 0;
+};
+
+/**
+ * @brief 按转义方式追加字符串
+ */
+static void AppendEscaped(std::string& buf, const char* data, size_t len, uint8_t escape) {
+    if(escape == LogFormater::JSON) {
+        AppendJsonEscaped(buf, data, len);
+    } else if(escape == LogFormater::LOGFMT) {
+        AppendLogfmtValue(buf, data, len);
+    } else {
+        buf.append(data, len);
+    }
+}
+
+/**
+ * @brief 追加转义后的源文件名
+ * @details __FILE__是字符串常量，地址不变，转义结果按(地址, 转义方式)缓存在线程局部的表中，
+ *          每个源文件只在第一次输出时转义，冲突时覆盖
+ */
+static void AppendEscapedFile(std::string& buf, const char* file, uint8_t escape) {
+    if(escape == LogFormater::TEXT) {
+        buf.append(file);
+        return;
+    }
+    struct Entry {
+        const char* file = nullptr;
+        uint8_t escape = 0;
+        std::string value;
+    };
+    static const size_t CACHE_SIZE = 64;
+    static thread_local Entry s_cache[CACHE_SIZE];
+
+    Entry& entry = s_cache[(((uintptr_t)file >> 3) ^ escape) % CACHE_SIZE];
+    if(entry.file != file || entry.escape != escape) {
+        entry.value.clear();
+        AppendEscaped(entry.value, file, strlen(file), escape);
+        entry.file = file;
+        entry.escape = escape;
+    }
+    buf.append(entry.value);
+}
+
+/**
+ * @brief 追加全部键值字段
+ * @details json格式为 ,"key":value，其他为 key=value，字段之间以空格分隔
+ */
+static void AppendFields(std::string& buf, const LogEvent& event, uint8_t escape) {
+    const char* data = event.getFieldData();
+    for(auto& f : event.getFields()) {
+        if(escape == LogFormater::JSON) {
+            buf.append(",\"", 2);
+            AppendJsonEscaped(buf, data + f.key_offset, f.key_len);
+            buf.append("\":", 2);
+        } else {
+            buf.push_back(' ');
+            AppendLogfmtKey(buf, data + f.key_offset, f.key_len);
+            buf.push_back('=');
+        }
+        switch(f.type) {
+            case LogField::INT:
+                AppendInt(buf, f.i);
+                break;
+            case LogField::UINT:
+                AppendUInt(buf, f.u);
+                break;
+            case LogField::DOUBLE: {
+                if(escape == LogFormater::JSON && !std::isfinite(f.d)) {
+                    buf.append("null", 4);
+                    break;
+                }
+                char tmp[32];
+                int n = snprintf(tmp, sizeof(tmp), "%.15g", f.d);
+                buf.append(tmp, n);
+                break;
+            }
+            case LogField::BOOL:
+                f.b ? buf.append("true", 4) : buf.append("false", 5);
+                break;
+            case LogField::STRING:
+                if(escape == LogFormater::JSON) {
+                    buf.push_back('"');
+                    AppendJsonEscaped(buf, data + f.offset, f.len);
+                    buf.push_back('"');
+                } else {
+                    AppendLogfmtValue(buf, data + f.offset, f.len);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief 追加产生事件时的全部MDC键值，格式与 AppendFields 相同
+ */
+static void AppendMDC(std::string& buf, const LogEvent& event, uint8_t escape) {
+    const ThreadContext* context = event.getThreadContext();
+    if(!context) {
+        return;
+    }
+    size_t depth = std::min<size_t>(event.getMDCDepth(), context->size());
+    for(size_t i = 0; i < depth; ++i) {
+        const ThreadContext::Entry& entry = context->at(i);
+        if(escape == LogFormater::JSON) {
+            buf.append(",\"", 2);
+            AppendJsonEscaped(buf, entry.key.c_str(), entry.key.size());
+            buf.append("\":\"", 3);
+            AppendJsonEscaped(buf, entry.value.c_str(), entry.value.size());
+            buf.push_back('"');
+        } else {
+            buf.push_back(' ');
+            AppendLogfmtKey(buf, entry.key.c_str(), entry.key.size());
+            buf.push_back('=');
+            AppendLogfmtValue(buf, entry.value.c_str(), entry.value.size());
+        }
+    }
+}
+
+void LogFormater::render(std::string& buf, const LogEvent& event) const {
+    for(auto& op : m_ops) {
+        switch(op.field) {
+            case LITERAL:
+                buf.append(m_literals, op.offset, op.len);
+                break;
+            case MESSAGE:
+                AppendEscaped(buf, event.getContextData(), event.getContextSize(), op.escape);
+                break;
+            case LEVEL:
+                buf.append(LogLevel::toString(event.getLevel()));
+                break;
+            case ELAPSE:
+                AppendUInt(buf, event.getElapse());
+                break;
+            case NAME:
+                buf.append(event.getLogger()->getEscapedName(op.escape));
+                break;
+            case THREAD_ID:
+                AppendUInt(buf, event.getThreadId());
+                break;
+            case DATETIME: {
+                static thread_local DateTimeCache s_cache;
+                time_t rawtime = static_cast<time_t>(event.getTime());
+                DateTimeCache::Slot* slot = s_cache.get(m_id, op.offset, rawtime);
+                if(slot->len == 0) {
+                    struct tm timeinfo;
+                    localtime_r(&rawtime, &timeinfo); // 该函数是线程安全的
+                    slot->len = strftime(slot->buf, sizeof(slot->buf), m_literals.c_str() + op.offset, &timeinfo);
+                }
+                buf.append(slot->buf, slot->len);
+                break;
+            }
+            case MSEC:
+                AppendPadded(buf, event.getTimeNS() % 1000000000 / 1000000, 3);
+                break;
+            case USEC:
+                AppendPadded(buf, event.getTimeNS() % 1000000000 / 1000, 6);
+                break;
+            case NSEC:
+                AppendPadded(buf, event.getTimeNS() % 1000000000, 9);
+                break;
+            case FILENAME:
+                AppendEscapedFile(buf, event.getFile(), op.escape);
+                break;
+            case LINE:
+                AppendInt(buf, event.getLine());
+                break;
+            case FIBER_ID:
+                AppendUInt(buf, event.getFiberId());
+                break;
+            case FIELDS:
+                AppendFields(buf, event, op.escape);
+                break;
+            case THREAD_NAME:
+                if(event.getThreadContext()) {
+                    const std::string& name = event.getThreadContext()->getName();
+                    AppendEscaped(buf, name.c_str(), name.size(), op.escape);
+                }
+                break;
+            case MDC: {
+                if(!op.len) {
+                    AppendMDC(buf, event, op.escape);
+                    break;
+                }
+                const ThreadContext* context = event.getThreadContext();
+                const std::string* value = context
+                    ? context->find(m_literals.c_str() + op.offset, op.len, event.getMDCDepth()) : nullptr;
+                if(value) {
+                    AppendEscaped(buf, value->c_str(), value->size(), op.escape);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+void LogFormater::appendLiteral(const std::string& str) {
+    if(str.empty()) {
+        return;
+    }
+    if(!m_ops.empty() && m_ops.back().field == LITERAL
+            && m_ops.back().offset + m_ops.back().len == m_literals.size()) {
+        m_ops.back().len += str.size();
+    } else {
+        Op op;
+        op.field = LITERAL;
+        op.offset = m_literals.size();
+        op.len = str.size();
+        m_ops.push_back(op);
+    }
+    m_literals.append(str);
+}
+
+void LogFormater::appendField(uint8_t field, uint8_t escape) {
+    Op op;
+    op.field = field;
+    op.offset = 0;
+    op.len = 0;
+    op.escape = escape;
+    m_ops.push_back(op);
+}
+
+void LogFormater::appendDateTime(const std::string& fmt) {
+    // 时间格式以'\0'结尾存入字面量区，供strftime直接使用
+    Op op;
+    op.field = DATETIME;
+    op.offset = m_literals.size();
+    op.len = fmt.size();
+    m_ops.push_back(op);
+    m_literals.append(fmt);
+    m_literals.push_back('\0');
+}
+
+void LogFormater::initStructured() {
+    // 时间格式与文本格式一致，压缩日志的时间索引可以直接解析
+    if(m_mode == JSON) {
+        appendLiteral("{\"time\":\"");
+        appendDateTime("%Y-%m-%d %H:%M:%S");
+        appendLiteral(".");
+        appendField(MSEC);
+        appendLiteral("\",\"level\":\"");
+        appendField(LEVEL);
+        appendLiteral("\",\"logger\":\"");
+        appendField(NAME, JSON);
+        appendLiteral("\",\"thread\":");
+        appendField(THREAD_ID);
+        appendLiteral(",\"thread_name\":\"");
+        appendField(THREAD_NAME, JSON);
+        appendLiteral("\",\"fiber\":");
+        appendField(FIBER_ID);
+        appendLiteral(",\"file\":\"");
+        appendField(FILENAME, JSON);
+        appendLiteral("\",\"line\":");
+        appendField(LINE);
+        appendLiteral(",\"msg\":\"");
+        appendField(MESSAGE, JSON);
+        appendLiteral("\"");
+        appendField(FIELDS, JSON);
+        appendField(MDC, JSON);
+        appendLiteral("}\n");
+    } else {
+        appendLiteral("time=\"");
+        appendDateTime("%Y-%m-%d %H:%M:%S");
+        appendLiteral(".");
+        appendField(MSEC);
+        appendLiteral("\" level=");
+        appendField(LEVEL);
+        appendLiteral(" logger=");
+        appendField(NAME, LOGFMT);
+        appendLiteral(" thread=");
+        appendField(THREAD_ID);
+        appendLiteral(" thread_name=");
+        appendField(THREAD_NAME, LOGFMT);
+        appendLiteral(" fiber=");
+        appendField(FIBER_ID);
+        appendLiteral(" file=");
+        appendField(FILENAME, LOGFMT);
+        appendLiteral(" line=");
+        appendField(LINE);
+        appendLiteral(" msg=");
+        appendField(MESSAGE, LOGFMT);
+        appendField(FIELDS, LOGFMT);
+        appendField(MDC, LOGFMT);
+        appendLiteral("\n");
+    }
+}
+
+// %XXX %XXX{XXX} %% --> datetime%%:%d{YY MM DD HH SS SS}
+void LogFormater::init() {
+    if(m_pattern == "json" || m_pattern == "logfmt") {
+        m_mode = m_pattern == "json" ? JSON : LOGFMT;
+        initStructured();
+        return;
+    }
+
+    std::vector<std::tuple<std::string, std::string, int>> vec;
+    std::string nstr;
+
+    for(size_t i = 0; i < m_pattern.size(); ++i){
+
+        // 正常的字符
         if(m_pattern[i] != '%'){
             nstr.append(1, m_pattern[i]);
             continue;
@@ -356,33 +2083,67 @@ void LogFormater::init() {
         vec.push_back(std::make_tuple(nstr, "", 0));
     }
 
-#define XX(str, C) { #str, [](const std::string& fmt) {return FormatItem::ptr(new C(fmt)); }}
-    static std::map<std::string, std::function<FormatItem::ptr(const std::string& str)>> s_format_items = {
-        XX(m, MessageFormatItem),
-        XX(p, LevelFormatItem),
-        XX(r, ElapseFormatItem),
-        XX(c, NameFormatItem),
-        XX(t, ThreadIdFormatItem),
-        XX(n, NewLineFormatItem),
-        XX(d, DateTimeFormatItem),
-        XX(f, FilenameFormatItem),
-        XX(l, LineFormatItem),
-        XX(F, FiberIdFormatItem),
-        XX(T, TabFormatItem)
+#define XX(str, F) { #str, F }
+    static std::map<std::string, Field> s_fields = {
+        XX(m, MESSAGE),
+        XX(p, LEVEL),
+        XX(r, ELAPSE),
+        XX(c, NAME),
+        XX(t, THREAD_ID),
+        XX(n, NEWLINE),
+        XX(d, DATETIME),
+        XX(f, FILENAME),
+        XX(l, LINE),
+        XX(F, FIBER_ID),
+        XX(T, TAB),
+        XX(ms, MSEC),
+        XX(us, USEC),
+        XX(ns, NSEC),
+        XX(K, FIELDS),
+        XX(N, THREAD_NAME),
+        XX(X, MDC)
     };
 #undef XX
 
     for(auto& item : vec){
         if(std::get<2>(item) == 0){
-            m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(item))));
-        }else{
-            auto it = s_format_items.find(std::get<0>(item));
-            if(it == s_format_items.end()){
-                m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + std::get<0>(item) + ">>")));
-                m_error = true;
-            }else{
-                m_items.push_back(it->second(std::get<1>(item)));
+            appendLiteral(std::get<0>(item));
+            continue;
+        }
+
+        auto it = s_fields.find(std::get<0>(item));
+        if(it == s_fields.end()){
+            appendLiteral("<<error_format %" + std::get<0>(item) + ">>");
+            m_error = true;
+            continue;
+        }
+
+        switch(it->second) {
+            case NEWLINE:
+                appendLiteral("\n");
+                break;
+            case TAB:
+                appendLiteral("\t");
+                break;
+            case DATETIME: {
+                std::string fmt = std::get<1>(item);
+                appendDateTime(fmt.empty() ? "%Y-%m-%d %H:%M:%S" : fmt);
+                break;
+            }
+            case MDC: {
+                // 键名存入字面量区，没有键名时输出全部
+                const std::string& key = std::get<1>(item);
+                Op op;
+                op.field = MDC;
+                op.offset = m_literals.size();
+                op.len = key.size();
+                m_ops.push_back(op);
+                m_literals.append(key);
+                break;
             }
+            default:
+                appendField(it->second);
+                break;
         }
     }
 }
@@ -392,13 +2153,794 @@ LoggerManager::LoggerManager() {
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppneder));
 }
 
+LoggerManager::~LoggerManager() {
+    setStatsDump(nullptr, 0);
+}
+
 Logger::ptr LoggerManager::getLogger(const std::string& name){
-    auto it = m_loggers.find(name);
-    return it == m_loggers.end() ? m_root : it->second;
+    {
+        RcuReadGuard guard;
+        const LoggerMap* loggers = m_loggers.get();
+        auto it = loggers->find(name);
+        if(it != loggers->end()) {
+            return it->second;
+        }
+    }
+    if(name.empty() || name == m_root->getName()) {
+        return m_root;
+    }
+    Logger::ptr logger;
+    m_loggers.update([this, &name, &logger](LoggerMap& loggers) {
+        // 其他线程可能已经创建
+        auto it = loggers.find(name);
+        if(it != loggers.end()) {
+            logger = it->second;
+            return false;
+        }
+        logger = create(loggers, name);
+        return true;
+    });
+    return logger;
+}
+
+Logger::ptr LoggerManager::create(LoggerMap& loggers, const std::string& name) {
+    auto it = loggers.find(name);
+    if(it != loggers.end()) {
+        return it->second;
+    }
+    Logger::ptr logger(new Logger(name));
+    logger->m_level.store(LogLevel::UNKNOWN, std::memory_order_relaxed);
+    logger->setParent(createParent(loggers, name));
+    loggers[name] = logger;
+    return logger;
+}
+
+Logger::ptr LoggerManager::createParent(LoggerMap& loggers, const std::string& name) {
+    size_t pos = name.rfind('.');
+    if(pos == std::string::npos || pos == 0) {
+        return m_root;
+    }
+    return create(loggers, name.substr(0, pos));
+}
+
+Logger::ptr LoggerManager::addLogger(Logger::ptr logger) {
+    if(logger == m_root || logger->getName() == m_root->getName()) {
+        return m_root;
+    }
+    Logger::ptr registered;
+    m_loggers.update([this, &logger, &registered](LoggerMap& loggers) {
+        auto it = loggers.find(logger->getName());
+        if(it != loggers.end()) {
+            registered = it->second;
+            return false;
+        }
+        logger->setParent(createParent(loggers, logger->getName()));
+        loggers[logger->getName()] = logger;
+        registered = logger;
+        return true;
+    });
+    // 不替换节点，别处持有的句柄不会失效
+    if(registered != logger) {
+        registered->assign(*logger);
+    }
+    return registered;
+}
+
+void LoggerManager::delLogger(const std::string& name) {
+    Logger::ptr logger;
+    {
+        RcuReadGuard guard;
+        const LoggerMap* loggers = m_loggers.get();
+        auto it = loggers->find(name);
+        if(it == loggers->end()) {
+            return;
+        }
+        logger = it->second;
+    }
+    logger->setLevel(LogLevel::UNKNOWN);
+    logger->setAppenders(std::vector<LogAppender::ptr>());
+    logger->clearLimit();
+    logger->setFilter(nullptr);
+}
+
+/**
+ * @brief 配置文件中的Appender定义
+ */
+struct LogAppenderDefine {
+    // 1 File, 2 Stdout, 3 RollingFile, 4 MmapFile
+    int type = 0;
+    LogLevel::Level level = LogLevel::UNKNOWN;
+    std::string formatter;
+    std::string file;
+    // FileLogAppender的异步模式
+    bool async = false;
+    AsyncLogWriter::Config async_config;
+    // FileLogAppender的分片异步模式
+    bool sharded = false;
+    ShardedLogWriter::Config sharded_config;
+    // RollingFileLogAppender的滚动配置
+    RollingFileLogAppender::Config rolling;
+    // MmapFileLogAppender的映射配置
+    MmapFileLogAppender::Config mmap;
+    // 刷新策略
+    LogFlushPolicy flush;
+    // 过滤规则
+    std::vector<LogFilterRule> filters;
+
+    bool operator==(const LogAppenderDefine& oth) const {
+        return type == oth.type
+            && level == oth.level
+            && formatter == oth.formatter
+            && file == oth.file
+            && async == oth.async
+            && async_config == oth.async_config
+            && sharded == oth.sharded
+            && sharded_config == oth.sharded_config
+            && rolling == oth.rolling
+            && mmap == oth.mmap
+            && flush == oth.flush
+            && filters == oth.filters;
+    }
+};
+
+/**
+ * @brief 配置文件中的日志器定义
+ */
+struct LogDefine {
+    std::string name;
+    LogLevel::Level level = LogLevel::UNKNOWN;
+    std::string formatter;
+    std::vector<LogAppenderDefine> appenders;
+    // 是否单独配置了限流
+    bool has_limit = false;
+    LogLimit limit;
+    // 过滤规则
+    std::vector<LogFilterRule> filters;
+
+    bool operator==(const LogDefine& oth) const {
+        return name == oth.name
+            && level == oth.level
+            && formatter == oth.formatter
+            && appenders == oth.appenders
+            && has_limit == oth.has_limit
+            && limit == oth.limit
+            && filters == oth.filters;
+    }
+
+    bool operator<(const LogDefine& oth) const {
+        return name < oth.name;
+    }
+};
+
+template<>
+class LexicalCast<std::string, LogLimit> {
+public:
+    LogLimit operator()(const std::string& v) {
+        YAML::Node n = YAML::Load(v);
+        LogLimit limit;
+#define XX(name) \
+        if(n[#name].IsDefined()) { \
+            limit.name = n[#name].as<uint32_t>(); \
+        }
+
+        XX(rate);
+        XX(burst);
+        XX(sample);
+        XX(summary_interval);
+#undef XX
+        return limit;
+    }
+};
+
+template<>
+class LexicalCast<LogLimit, std::string> {
+public:
+    std::string operator()(const LogLimit& limit) {
+        YAML::Node n;
+        n["rate"] = limit.rate;
+        n["burst"] = limit.burst;
+        n["sample"] = limit.sample;
+        n["summary_interval"] = limit.summary_interval;
+        std::stringstream ss;
+        ss << n;
+        return ss.str();
+    }
+};
+
+/**
+ * @brief 解析时间间隔，支持秒数以及 minutely hourly daily
+ */
+static uint32_t ParseInterval(const YAML::Node& n) {
+    std::string v = n.as<std::string>();
+    if(v == "minutely") {
+        return 60;
+    } else if(v == "hourly") {
+        return 3600;
+    } else if(v == "daily") {
+        return 86400;
+    }
+    return n.as<uint32_t>();
+}
+
+/**
+ * @brief 解析过滤规则列表
+ * @details 每条规则形如 {action: accept, level: debug, logger: net.http, file: "src/net*",
+ *          mdc: {user: "42"}, message: timeout}，除action外都是可选的匹配条件
+ */
+static std::vector<LogFilterRule> ParseFilters(const YAML::Node& n, const std::string& name) {
+    std::vector<LogFilterRule> rules;
+    if(!n.IsSequence() || n.size() > LogFilter::MAX_RULES) {
+        throw std::logic_error("log config error: filters must be a list of at most "
+                + std::to_string(LogFilter::MAX_RULES) + " rules, " + name);
+    }
+    for(size_t i = 0; i < n.size(); ++i) {
+        YAML::Node f = n[i];
+        LogFilterRule rule;
+        if(f["action"].IsDefined()) {
+            std::string action = f["action"].as<std::string>();
+            rule.action = LogFilterRule::FromString(action);
+            // 拼错的动作当成accept会把本该丢弃的日志放出去
+            if(strcasecmp(LogFilterRule::ToString(rule.action), action.c_str()) != 0) {
+                throw std::logic_error("log config error: filter action is invalid, " + action + ", " + name);
+            }
+        }
+        if(f["level"].IsDefined()) {
+            rule.level = LogLevel::FromString(f["level"].as<std::string>());
+        }
+        if(f["max_level"].IsDefined()) {
+            rule.max_level = LogLevel::FromString(f["max_level"].as<std::string>());
+        }
+#define XX(name) \
+        if(f[#name].IsDefined()) { \
+            rule.name = f[#name].as<std::string>(); \
+        }
+
+        XX(logger);
+        XX(file);
+        XX(message);
+#undef XX
+        if(f["mdc"].IsDefined()) {
+            for(auto it = f["mdc"].begin(); it != f["mdc"].end(); ++it) {
+                rule.mdc.push_back(std::make_pair(it->first.as<std::string>(), it->second.as<std::string>()));
+            }
+        }
+        rules.push_back(rule);
+    }
+    return rules;
+}
+
+static YAML::Node DumpFilters(const std::vector<LogFilterRule>& rules) {
+    YAML::Node n;
+    for(auto& rule : rules) {
+        YAML::Node f;
+        f["action"] = LogFilterRule::ToString(rule.action);
+        if(rule.level != LogLevel::UNKNOWN) {
+            f["level"] = LogLevel::toString(rule.level);
+        }
+        if(rule.max_level != LogLevel::UNKNOWN) {
+            f["max_level"] = LogLevel::toString(rule.max_level);
+        }
+#define XX(name) \
+        if(!rule.name.empty()) { \
+            f[#name] = rule.name; \
+        }
+
+        XX(logger);
+        XX(file);
+        XX(message);
+#undef XX
+        for(auto& i : rule.mdc) {
+            f["mdc"][i.first] = i.second;
+        }
+        n.push_back(f);
+    }
+    return n;
+}
+
+template<>
+class LexicalCast<std::string, LogDefine> {
+public:
+    LogDefine operator()(const std::string& v) {
+        YAML::Node n = YAML::Load(v);
+        LogDefine ld;
+        if(!n["name"].IsDefined()) {
+            throw std::logic_error("log config error: name is null");
+        }
+        ld.name = n["name"].as<std::string>();
+        ld.level = LogLevel::FromString(n["level"].IsDefined() ? n["level"].as<std::string>() : "");
+        if(n["formatter"].IsDefined()) {
+            ld.formatter = n["formatter"].as<std::string>();
+        }
+        if(n["limit"].IsDefined()) {
+            std::stringstream ss;
+            ss << n["limit"];
+            ld.has_limit = true;
+            ld.limit = LexicalCast<std::string, LogLimit>()(ss.str());
+        }
+        if(n["filters"].IsDefined()) {
+            ld.filters = ParseFilters(n["filters"], ld.name);
+        }
+
+        YAML::Node appenders = n["appenders"].IsDefined() ? n["appenders"] : n["appender"];
+        if(!appenders.IsDefined()) {
+            return ld;
+        }
+        for(size_t x = 0; x < appenders.size(); ++x) {
+            YAML::Node a = appenders[x];
+            if(!a["type"].IsDefined()) {
+                throw std::logic_error("log config error: appender type is null, " + ld.name);
+            }
+            std::string type = a["type"].as<std::string>();
+            LogAppenderDefine lad;
+            if(type == "FileLogAppender" || type == "RollingFileLogAppender"
+                    || type == "MmapFileLogAppender") {
+                lad.type = type == "FileLogAppender" ? 1 : (type == "RollingFileLogAppender" ? 3 : 4);
+                if(!a["file"].IsDefined()) {
+                    throw std::logic_error("log config error: " + type + " file is null, " + ld.name);
+                }
+                lad.file = a["file"].as<std::string>();
+            } else if(type == "StdoutLogAppender") {
+                lad.type = 2;
+            } else {
+                throw std::logic_error("log config error: appender type is invalid, " + type);
+            }
+            if(a["level"].IsDefined()) {
+                lad.level = LogLevel::FromString(a["level"].as<std::string>());
+            }
+            if(a["formatter"].IsDefined()) {
+                lad.formatter = a["formatter"].as<std::string>();
+            }
+
+            if(a["async"].IsDefined()) {
+                YAML::Node c = a["async"];
+                lad.async = true;
+#define XX(name, type) \
+                if(c[#name].IsDefined()) { \
+                    lad.async_config.name = c[#name].as<type>(); \
+                }
+
+                XX(buffer_size, size_t);
+                XX(buffer_count, size_t);
+                XX(flush_interval, uint32_t);
+#undef XX
+                if(c["policy"].IsDefined()) {
+                    lad.async_config.policy = AsyncLogWriter::FromString(c["policy"].as<std::string>());
+                }
+            }
+            if(a["sharded"].IsDefined()) {
+                YAML::Node c = a["sharded"];
+                lad.sharded = true;
+                if(c["ring_size"].IsDefined()) {
+                    lad.sharded_config.ring_size = c["ring_size"].as<size_t>();
+                }
+                if(c["flush_interval"].IsDefined()) {
+                    lad.sharded_config.flush_interval = c["flush_interval"].as<uint32_t>();
+                }
+                if(c["policy"].IsDefined()) {
+                    lad.sharded_config.policy = AsyncLogWriter::FromString(c["policy"].as<std::string>());
+                }
+            }
+
+#define XX(name, type) \
+            if(a[#name].IsDefined()) { \
+                lad.rolling.name = a[#name].as<type>(); \
+            }
+
+            XX(max_size, uint64_t);
+            XX(max_files, uint32_t);
+            XX(buffer_size, size_t);
+            XX(flush_interval, uint32_t);
+            XX(preallocate, uint64_t);
+#undef XX
+            if(a["interval"].IsDefined()) {
+                lad.rolling.interval = ParseInterval(a["interval"]);
+            }
+            if(a["compress"].IsDefined()) {
+                YAML::Node c = a["compress"];
+                lad.rolling.compress = true;
+#define XX(name, type) \
+                if(c[#name].IsDefined()) { \
+                    lad.rolling.compress_config.name = c[#name].as<type>(); \
+                }
+
+                XX(level, int);
+                XX(frame_size, size_t);
+                XX(cpu_percent, uint32_t);
+#undef XX
+            }
+            if(a["segment_size"].IsDefined()) {
+                lad.mmap.segment_size = a["segment_size"].as<size_t>();
+            }
+            if(a["sync_interval"].IsDefined()) {
+                lad.mmap.sync_interval = a["sync_interval"].as<uint32_t>();
+            }
+            if(a["sync_level"].IsDefined()) {
+                lad.mmap.sync_level = LogLevel::FromString(a["sync_level"].as<std::string>());
+            }
+            if(a["flush"].IsDefined()) {
+                YAML::Node c = a["flush"];
+#define XX(name) \
+                if(c[#name].IsDefined()) { \
+                    lad.flush.name = c[#name].as<uint32_t>(); \
+                }
+
+                XX(records);
+                XX(bytes);
+                XX(interval);
+#undef XX
+                if(c["level"].IsDefined()) {
+                    lad.flush.level = LogLevel::FromString(c["level"].as<std::string>());
+                }
+            }
+            if(a["filters"].IsDefined()) {
+                lad.filters = ParseFilters(a["filters"], ld.name);
+            }
+            ld.appenders.push_back(lad);
+        }
+        return ld;
+    }
+};
+
+template<>
+class LexicalCast<LogDefine, std::string> {
+public:
+    std::string operator()(const LogDefine& i) {
+        YAML::Node n;
+        n["name"] = i.name;
+        if(i.level != LogLevel::UNKNOWN) {
+            n["level"] = LogLevel::toString(i.level);
+        }
+        if(!i.formatter.empty()) {
+            n["formatter"] = i.formatter;
+        }
+        if(i.has_limit) {
+            n["limit"] = YAML::Load(LexicalCast<LogLimit, std::string>()(i.limit));
+        }
+        if(!i.filters.empty()) {
+            n["filters"] = DumpFilters(i.filters);
+        }
+        for(auto& a : i.appenders) {
+            YAML::Node na;
+            if(a.type == 1) {
+                na["type"] = "FileLogAppender";
+                na["file"] = a.file;
+            } else if(a.type == 2) {
+                na["type"] = "StdoutLogAppender";
+            } else if(a.type == 3) {
+                na["type"] = "RollingFileLogAppender";
+                na["file"] = a.file;
+                na["max_size"] = a.rolling.max_size;
+                na["interval"] = a.rolling.interval;
+                na["max_files"] = a.rolling.max_files;
+                na["buffer_size"] = a.rolling.buffer_size;
+                na["flush_interval"] = a.rolling.flush_interval;
+                na["preallocate"] = a.rolling.preallocate;
+                if(a.rolling.compress) {
+                    na["compress"]["level"] = a.rolling.compress_config.level;
+                    na["compress"]["frame_size"] = a.rolling.compress_config.frame_size;
+                    na["compress"]["cpu_percent"] = a.rolling.compress_config.cpu_percent;
+                }
+            } else if(a.type == 4) {
+                na["type"] = "MmapFileLogAppender";
+                na["file"] = a.file;
+                na["segment_size"] = a.mmap.segment_size;
+                na["sync_interval"] = a.mmap.sync_interval;
+                na["sync_level"] = LogLevel::toString(a.mmap.sync_level);
+            }
+            if(a.level != LogLevel::UNKNOWN) {
+                na["level"] = LogLevel::toString(a.level);
+            }
+            if(!a.formatter.empty()) {
+                na["formatter"] = a.formatter;
+            }
+            if(a.async) {
+                na["async"]["buffer_size"] = a.async_config.buffer_size;
+                na["async"]["buffer_count"] = a.async_config.buffer_count;
+                na["async"]["policy"] = AsyncLogWriter::ToString(a.async_config.policy);
+                na["async"]["flush_interval"] = a.async_config.flush_interval;
+            }
+            if(a.sharded) {
+                na["sharded"]["ring_size"] = a.sharded_config.ring_size;
+                na["sharded"]["policy"] = AsyncLogWriter::ToString(a.sharded_config.policy);
+                na["sharded"]["flush_interval"] = a.sharded_config.flush_interval;
+            }
+            if(!(a.flush == LogFlushPolicy())) {
+                na["flush"]["records"] = a.flush.records;
+                na["flush"]["bytes"] = a.flush.bytes;
+                na["flush"]["interval"] = a.flush.interval;
+                na["flush"]["level"] = LogLevel::toString(a.flush.level);
+            }
+            if(!a.filters.empty()) {
+                na["filters"] = DumpFilters(a.filters);
+            }
+            n["appenders"].push_back(na);
+        }
+        std::stringstream ss;
+        ss << n;
+        return ss.str();
+    }
+};
+
+/**
+ * @brief 按定义创建Appender
+ */
+static LogAppender::ptr CreateAppender(const LogAppenderDefine& a) {
+    LogAppender::ptr ap;
+    if(a.type == 1) {
+        FileLogAppneder::ptr fap(new FileLogAppneder(a.file));
+        if(a.sharded) {
+            fap->setSharded(a.sharded_config);
+        } else if(a.async) {
+            fap->setAsync(a.async_config);
+        }
+        ap = fap;
+    } else if(a.type == 2) {
+        ap.reset(new StdoutLogAppneder);
+    } else if(a.type == 3) {
+        ap.reset(new RollingFileLogAppender(a.file, a.rolling));
+    } else if(a.type == 4) {
+        ap.reset(new MmapFileLogAppender(a.file, a.mmap));
+    }
+    if(a.level != LogLevel::UNKNOWN) {
+        ap->setLevel(a.level);
+    }
+    ap->setFlushPolicy(a.flush);
+    if(!a.filters.empty()) {
+        ap->setFilter(LogFilter::ptr(new LogFilter(a.filters)));
+    }
+    if(!a.formatter.empty()) {
+        LogFormater::ptr fmt(new LogFormater(a.formatter));
+        if(fmt->isError()) {
+            std::cout << "log appender formatter=" << a.formatter << " is invalid" << std::endl;
+        } else {
+            ap->setFormater(fmt);
+        }
+    }
+    return ap;
+}
+
+static ConfigVar<std::set<LogDefine>>::ptr g_log_defines;
+static ConfigVar<LogLimit>::ptr g_log_limit;
+
+/**
+ * @brief 按配置构建的日志器，记录Appender和它们的定义，配置没有变化的Appender直接复用
+ */
+struct LogBuilt {
+    std::string formatter;
+    std::vector<std::pair<LogAppenderDefine, LogAppender::ptr>> appenders;
+};
+
+/**
+ * @brief 等待发布的日志器配置
+ */
+struct LogPending {
+    Logger::ptr logger;
+    const LogDefine* define;
+    bool formatter_ok;
+    LogFilter::ptr filter;
+    LogBuilt built;
+};
+
+static std::mutex s_log_built_mutex;
+static std::map<std::string, LogBuilt> s_log_built;
+
+/**
+ * @brief 应用log节的变化
+ * @details 先在旁边构建所有变化的日志器需要的Appender和过滤器并暂存，再用 Logger::PublishConfig()
+ *          一次发布：其他线程的日志不等待，每条日志要么完全按旧配置要么完全按新配置输出，不会丢失或重复。
+ *          发布之后再设置级别和限流，写出并释放被替换的Appender。写同一个文件的新旧Appender
+ *          之间不保证顺序，旧Appender缓冲的日志可能排在新日志之后。
+ *          定义没有变化的Appender复用原来的实例，不重新打开文件
+ */
+static void ApplyLogDefines(const std::set<LogDefine>& old_value, const std::set<LogDefine>& new_value) {
+    std::unique_lock<std::mutex> lock(s_log_built_mutex);
+    LoggerManager* mgr = LoggerMgrPtr::GetInstance();
+    std::vector<LogPending> pendings;
+    for(auto& i : new_value) {
+        auto it = old_value.find(i);
+        if(it != old_value.end() && *it == i) {
+            continue;
+        }
+
+        LogPending pending;
+        pending.logger = mgr->getLogger(i.name);
+        pending.define = &i;
+        pending.formatter_ok = i.formatter.empty() || !LogFormater(i.formatter).isError();
+        if(!pending.formatter_ok) {
+            std::cout << "log name=" << i.name << " formatter=" << i.formatter
+                      << " is invalid" << std::endl;
+        }
+        pending.built.formatter = i.formatter;
+        if(!i.filters.empty()) {
+            pending.filter.reset(new LogFilter(i.filters));
+        }
+
+        // 没有自己的格式器的Appender使用日志器的格式，日志器格式变化时不能复用
+        LogBuilt& old = s_log_built[i.name];
+        for(auto& a : i.appenders) {
+            LogAppender::ptr ap;
+            for(auto& o : old.appenders) {
+                if(o.second && o.first == a && (!a.formatter.empty() || old.formatter == i.formatter)) {
+                    ap.swap(o.second);
+                    break;
+                }
+            }
+            if(!ap) {
+                ap = CreateAppender(a);
+            }
+            pending.built.appenders.push_back(std::make_pair(a, ap));
+        }
+        pendings.push_back(pending);
+    }
+
+    // 被替换的Appender，发布之后写出缓冲，在函数返回后析构
+    std::vector<LogAppender::ptr> retired;
+    std::vector<Logger::ptr> staged;
+    for(auto& i : pendings) {
+        const LogDefine& define = *i.define;
+        if(!define.formatter.empty() && i.formatter_ok) {
+            i.logger->setFormatter(define.formatter);
+        }
+        std::vector<LogAppender::ptr> appenders;
+        for(auto& a : i.built.appenders) {
+            appenders.push_back(a.second);
+        }
+        i.logger->stageConfig(appenders, i.filter);
+        staged.push_back(i.logger);
+        LogBuilt& built = s_log_built[define.name];
+        for(auto& a : built.appenders) {
+            if(a.second) {
+                retired.push_back(a.second);
+            }
+        }
+        built = i.built;
+    }
+
+    // 删除的日志器在同一次发布中清空Appender和过滤器
+    std::vector<std::string> removed;
+    for(auto& i : old_value) {
+        if(new_value.find(i) == new_value.end()) {
+            auto it = s_log_built.find(i.name);
+            if(it != s_log_built.end()) {
+                for(auto& a : it->second.appenders) {
+                    if(a.second) {
+                        retired.push_back(a.second);
+                    }
+                }
+                s_log_built.erase(it);
+            }
+            if(i.name != mgr->getRoot()->getName()) {
+                Logger::ptr logger = mgr->getLogger(i.name);
+                logger->stageConfig(std::vector<LogAppender::ptr>(), nullptr);
+                staged.push_back(logger);
+                removed.push_back(i.name);
+            }
+        }
+    }
+
+    Logger::PublishConfig(staged);
+
+    for(auto& i : pendings) {
+        const LogDefine& define = *i.define;
+        if(define.has_limit) {
+            i.logger->setLimit(define.limit);
+        } else {
+            i.logger->clearLimit();
+        }
+        // 没有配置级别的日志器继承父日志器，root保持原来的级别
+        if(define.level != LogLevel::UNKNOWN || i.logger != mgr->getRoot()) {
+            i.logger->setLevel(define.level);
+        }
+    }
+    for(auto& i : removed) {
+        mgr->delLogger(i);
+    }
+    // 发布之后旧Appender不会再收到日志
+    for(auto& i : retired) {
+        i->flush();
+    }
 }
 
 void LoggerManager::init(){
+    std::call_once(m_inited, [this]() {
+        g_log_defines = Config::Lookup("log", std::set<LogDefine>(), "log config");
+        g_log_limit = Config::Lookup("log_limit", LogLimit(), "global per call site log rate limit");
+
+        g_log_limit->addListener([](const LogLimit& old_value, const LogLimit& new_value) {
+            Logger::SetGlobalLimit(new_value);
+        });
+        g_log_defines->addListener(ApplyLogDefines);
+
+        // 注册之前已经加载的配置
+        Logger::SetGlobalLimit(g_log_limit->getValue());
+        ApplyLogDefines(std::set<LogDefine>(), g_log_defines->getValue());
+    });
+}
+
+void LoggerManager::installCrashHandler() {
+    LogCrashHandler::Install();
+}
+
+std::vector<LoggerManager::LoggerStats> LoggerManager::getStats() {
+    std::vector<Logger::ptr> loggers;
+    {
+        RcuReadGuard guard;
+        const LoggerMap* map = m_loggers.get();
+        for(auto& i : *map) {
+            loggers.push_back(i.second);
+        }
+    }
+    if(std::find(loggers.begin(), loggers.end(), m_root) == loggers.end()) {
+        loggers.push_back(m_root);
+    }
+    std::sort(loggers.begin(), loggers.end(), [](const Logger::ptr& a, const Logger::ptr& b) {
+        return a->getName() < b->getName();
+    });
+
+    std::vector<LoggerStats> result(loggers.size());
+    for(size_t i = 0; i < loggers.size(); ++i) {
+        LoggerStats& item = result[i];
+        item.name = loggers[i]->getName();
+        item.stats = loggers[i]->getStats();
+        RcuReadGuard guard;
+        for(auto& ap : *loggers[i]->m_appenders.get()) {
+            item.appenders.push_back(std::make_pair(ap->getName(), ap->getStats()));
+        }
+    }
+    return result;
+}
 
+std::string LoggerManager::dumpStats() {
+    std::stringstream ss;
+    for(auto& i : getStats()) {
+        ss << "logger " << i.name << ": " << i.stats.toString() << std::endl;
+        for(auto& ap : i.appenders) {
+            ss << "    appender " << ap.first << ": " << ap.second.toString() << std::endl;
+        }
+    }
+    return ss.str();
+}
+
+void LoggerManager::setStatsDump(Logger::ptr logger, uint32_t interval) {
+    std::thread old;
+    {
+        std::unique_lock<std::mutex> lock(m_statsMutex);
+        m_statsLogger = interval ? logger : nullptr;
+        m_statsInterval = logger ? interval : 0;
+        m_statsCond.notify_one();
+        if(m_statsInterval == 0) {
+            old = std::move(m_statsThread);
+        } else if(!m_statsThread.joinable()) {
+            m_statsThread = std::thread([this]() {
+                std::unique_lock<std::mutex> lock(m_statsMutex);
+                while(m_statsInterval) {
+                    uint32_t interval = m_statsInterval;
+                    if(m_statsCond.wait_for(lock, std::chrono::milliseconds(interval)) == std::cv_status::timeout
+                            && m_statsLogger && interval == m_statsInterval) {
+                        Logger::ptr logger = m_statsLogger;
+                        // 输出日志和收集统计不持有锁
+                        lock.unlock();
+                        ORANGE_LOG_INFO(logger) << "log stats:\n" << dumpStats();
+                        lock.lock();
+                    }
+                }
+            });
+        }
+    }
+    if(old.joinable()) {
+        old.join();
+    }
 }
 
-}
\ No newline at end of file
+/**
+ * @brief 程序启动时注册log和log_limit配置项
+ */
+struct LogIniter {
+    LogIniter() {
+        LoggerMgrPtr::GetInstance()->init();
+    }
+};
+
+static LogIniter __log_init;
+
+}
@@ -3,6 +3,11 @@
 
 #include "singleton.h"
 #include "util.h"
+#include "async_log.h"
+#include "sharded_log.h"
+#include "log_compress.h"
+#include "log_stats.h"
+#include "rcu.h"
 #include <string>
 #include <stdint.h>
 #include <memory>
@@ -11,15 +16,41 @@
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <unordered_map>
+#include <set>
+#include <unordered_set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <stdarg.h>
+#include <string.h>
+
+/**
+ * @brief 编译期最低日志级别，数值与 LogLevel::Level 一致
+ * @details 低于该级别的日志语句条件恒为假，整条语句(包括流式参数)会被编译器消除。
+ *          一般通过 cmake -DORANGE_LOG_MIN_LEVEL=INFO 设置
+ */
+#ifndef ORANGE_LOG_MIN_LEVEL
+#define ORANGE_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * @brief 当前调用点的限流状态
+ * @details 每个调用点(文件+行号)一个静态对象，第一次执行时构造
+ */
+#define ORANGE_LOG_SITE() \
+    ([]() -> orange::LogSite& { static orange::LogSite s_orange_log_site(__FILE__, __LINE__); return s_orange_log_site; }())
 
 /**
  * @brief 使用流模式将日志级别为level的日志写入logger
+ * @details 级别过滤和限流都在构造 LogEvent 之前完成
  */
 #define ORANGE_LOG_LEVEL(logger, level) \
-    if(logger->getLevel() <= level) \
-        orange::LogEventWarp(orange::LogEvent::ptr( \
-            new orange::LogEvent(logger, level, __FILE__, __LINE__, \
-            0, orange::GetThreadId(), orange::GetFiberId(), (uint64_t)time(0)))).getSS()
+    if(ORANGE_LOG_MIN_LEVEL <= level && logger->isEnabled(level) \
+            && ORANGE_LOG_SITE().allow(logger, level)) \
+        orange::LogEventWarp(logger, level, __FILE__, __LINE__, \
+            0, orange::GetThreadId(), orange::GetFiberId(), 0).getStream()
 
 /**
  * @brief 使用流模式将日志级别为DEBUG的日志写入logger
@@ -50,10 +81,10 @@
  * @brief 使用格式化模式将日志级别为FATAL的日志写入logger
  */
 #define ORANGE_LOG_FMT_LEVEL(logger, level, fmt, ...) \
-    if(logger->getLevel() <= level) \
-        orange::LogEventWarp(orange::LogEvent::ptr( \
-            new orange::LogEvent(logger, level, __FILE__, __LINE__, \
-            0, orange::GetThreadId(), orange::GetFiberId(), (uint64_t)time(0)))).getEvent()->format(fmt, __VA_ARGS__)
+    if(ORANGE_LOG_MIN_LEVEL <= level && logger->isEnabled(level) \
+            && ORANGE_LOG_SITE().allow(logger, level)) \
+        orange::LogEventWarp(logger, level, __FILE__, __LINE__, \
+            0, orange::GetThreadId(), orange::GetFiberId(), 0).getEvent()->format(fmt, __VA_ARGS__)
 
 /**
  * @brief 使用格式化模式将日志级别为FATAL的日志写入logger
@@ -80,14 +111,69 @@
  */
 #define ORANGE_LOG_FMT_FATAL(logger, fmt, ...) ORANGE_LOG_FMT_LEVEL(logger, LogLevel::FATAL, fmt, __VA_ARGS__)
 
+/**
+ * @brief 使用{}占位符格式将日志级别为level的日志写入logger
+ * @details 例如 ORANGE_LOG_FORMAT_INFO(logger, "user {} cost {}ms", name, cost)，参数按 LogStream 的规则输出，
+ *          {{ 和 }} 输出花括号。fmt必须是字符串字面量，占位符个数和参数个数不一致时编译报错
+ */
+#define ORANGE_LOG_FORMAT_LEVEL(logger, level, fmt, ...) \
+    if(ORANGE_LOG_MIN_LEVEL <= level && logger->isEnabled(level) \
+            && ORANGE_LOG_SITE().allow(logger, level)) \
+        orange::LogEventWarp(logger, level, __FILE__, __LINE__, \
+            0, orange::GetThreadId(), orange::GetFiberId(), 0).getStream().format( \
+                orange::LogFormatChecked<orange::LogFormatArgCount(fmt), \
+                    sizeof(orange::LogFormatArgs(__VA_ARGS__)) - 1>(fmt), ##__VA_ARGS__)
+
+/**
+ * @brief 使用{}占位符格式将日志级别为DEBUG的日志写入logger
+ */
+#define ORANGE_LOG_FORMAT_DEBUG(logger, fmt, ...) ORANGE_LOG_FORMAT_LEVEL(logger, LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief 使用{}占位符格式将日志级别为INFO的日志写入logger
+ */
+#define ORANGE_LOG_FORMAT_INFO(logger, fmt, ...) ORANGE_LOG_FORMAT_LEVEL(logger, LogLevel::INFO, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief 使用{}占位符格式将日志级别为WARN的日志写入logger
+ */
+#define ORANGE_LOG_FORMAT_WARN(logger, fmt, ...) ORANGE_LOG_FORMAT_LEVEL(logger, LogLevel::WARN, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief 使用{}占位符格式将日志级别为ERROR的日志写入logger
+ */
+#define ORANGE_LOG_FORMAT_ERROR(logger, fmt, ...) ORANGE_LOG_FORMAT_LEVEL(logger, LogLevel::ERROR, fmt, ##__VA_ARGS__)
+
+/**
+ * @brief 使用{}占位符格式将日志级别为FATAL的日志写入logger
+ */
+#define ORANGE_LOG_FORMAT_FATAL(logger, fmt, ...) ORANGE_LOG_FORMAT_LEVEL(logger, LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
 /**
  * @brief 获取默认的根配置器
  */
 #define ORANGE_LOG_ROOT() orange::LoggerMgrPtr::GetInstance()->getRoot()
 
+/**
+ * @brief 按名称获取日志器，不存在时创建
+ */
+#define ORANGE_LOG_NAME(name) orange::LoggerMgrPtr::GetInstance()->getLogger(name)
+
+/**
+ * @brief 按名称获取日志器，结果缓存在调用点的静态变量中，只在第一次执行时查找
+ * @details name必须是常量(例如字符串字面量)。日志器注册后不会被释放，
+ *          父日志器的级别变化通过代数检查生效，不需要重新查找
+ */
+#define ORANGE_LOG_NAME_CACHED(name) \
+    ([]() -> orange::Logger* { \
+        static orange::Logger::ptr s_orange_logger = ORANGE_LOG_NAME(name); \
+        return s_orange_logger.get(); \
+    }())
+
 namespace orange{
 
 class Logger;
+class LogFilter;
 
 /*
 * @brief 日志等级
@@ -104,6 +190,366 @@ public:
     };
 
     static const char* toString(LogLevel::Level level);
+
+    /**
+     * @brief 字符串转日志级别，不区分大小写，不识别时返回UNKNOWN
+     */
+    static LogLevel::Level FromString(const std::string& str);
+};
+
+/**
+ * @brief 日志内容缓冲区
+ * @details 内容先写入内联数组，超出后转移到堆上；重置时保留堆空间供下次复用
+ */
+class LogStreamBuf : public std::streambuf {
+public:
+    LogStreamBuf();
+    LogStreamBuf(const LogStreamBuf&) = delete;
+    LogStreamBuf& operator=(const LogStreamBuf&) = delete;
+
+    const char* data() const { return pbase(); }
+    size_t size() const { return pptr() - pbase(); }
+
+    /**
+     * @brief 清空内容
+     */
+    void reset();
+
+    /**
+     * @brief 按printf格式直接写入缓冲区
+     */
+    void vappendf(const char* fmt, va_list al);
+
+    /**
+     * @brief 追加n字节
+     */
+    void append(const char* s, size_t n) {
+        reserve(n);
+        memcpy(pptr(), s, n);
+        pbump(n);
+    }
+
+    /**
+     * @brief 保证至少还有n字节可写并返回写入位置，写完后用 commit 提交实际写入的字节数
+     */
+    char* prepare(size_t n) {
+        reserve(n);
+        return pptr();
+    }
+    void commit(size_t n) { pbump(n); }
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+private:
+    /**
+     * @brief 保证至少还有n字节可写
+     */
+    void reserve(size_t n) {
+        if((size_t)(epptr() - pptr()) < n) {
+            grow(n);
+        }
+    }
+    void grow(size_t n);
+private:
+    static const size_t INLINE_SIZE = 512;
+    // 内联缓冲区
+    char m_inline[INLINE_SIZE];
+    // 溢出后使用的堆缓冲区
+    std::unique_ptr<char[]> m_heap;
+    size_t m_heapSize = 0;
+};
+
+/**
+ * @brief 字符串的引用，不持有内容，调用方保证引用期间内容有效
+ */
+class LogStringRef {
+public:
+    LogStringRef() : m_data(""), m_size(0) {}
+    LogStringRef(const char* data, size_t size) : m_data(data), m_size(size) {}
+    LogStringRef(const char* str) : m_data(str), m_size(strlen(str)) {}
+    LogStringRef(const std::string& str) : m_data(str.c_str()), m_size(str.size()) {}
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+    std::string str() const { return std::string(m_data, m_size); }
+
+    bool operator==(const LogStringRef& oth) const {
+        return m_size == oth.m_size && memcmp(m_data, oth.m_data, m_size) == 0;
+    }
+    bool operator!=(const LogStringRef& oth) const { return !(*this == oth); }
+private:
+    const char* m_data;
+    size_t m_size;
+};
+
+template<class T>
+struct LogKeyValue;
+
+/**
+ * @brief 编译期统计格式串中{}占位符的个数，格式错误(单独的{或})时返回-1
+ * @details C++11的constexpr只能递归，格式串长度受编译器constexpr递归深度限制(GCC默认512)
+ */
+constexpr int LogFormatArgCount(const char* fmt, int n = 0) {
+    return *fmt == 0 ? n
+        : *fmt == '{' ? (fmt[1] == '{' ? LogFormatArgCount(fmt + 2, n)
+                        : fmt[1] == '}' ? LogFormatArgCount(fmt + 2, n + 1) : -1)
+        : *fmt == '}' ? (fmt[1] == '}' ? LogFormatArgCount(fmt + 2, n) : -1)
+        : LogFormatArgCount(fmt + 1, n);
+}
+
+/**
+ * @brief 只用于在不求值的上下文中统计参数个数，sizeof结果为参数个数加1
+ */
+template<class... Args>
+char (&LogFormatArgs(const Args&...))[sizeof...(Args) + 1];
+
+/**
+ * @brief 编译期检查格式串，通过时原样返回
+ */
+template<int Placeholders, int Args>
+const char* LogFormatChecked(const char* fmt) {
+    static_assert(Placeholders >= 0, "invalid log format string: use {} for arguments, {{ and }} for braces");
+    static_assert(Placeholders == Args, "number of {} placeholders does not match number of arguments");
+    return fmt;
+}
+
+/**
+ * @brief 日志内容流
+ * @details 常用类型不经过std::ostream，直接转换后写入 LogStreamBuf：整数逐两位查表转换，
+ *          浮点数输出能还原原值的最短形式，字符串直接复制，标准容器按YAML流式风格输出([a, b]、{k: v})。
+ *          其他类型，以及设置过格式(std::hex、std::setw等)之后的内置类型交给底层的std::ostream，
+ *          自定义类型的 operator<<(std::ostream&, const T&) 仍然可用
+ */
+class LogStream {
+public:
+    LogStream(LogStreamBuf& buf, std::ostream& os)
+        : m_buf(buf)
+        , m_os(os) {
+    }
+    LogStream(const LogStream&) = delete;
+    LogStream& operator=(const LogStream&) = delete;
+
+    /**
+     * @brief 恢复流的默认格式，复用事件时调用
+     */
+    void reset();
+
+    /**
+     * @brief 底层的std::ostream
+     * @details 调用方可能直接修改它的格式，之后到 reset() 为止都交给std::ostream输出
+     */
+    std::ostream& stream() {
+        m_raw = true;
+        m_plain = false;
+        return m_os;
+    }
+
+    LogStream& write(const char* data, size_t len) {
+        m_buf.append(data, len);
+        return *this;
+    }
+
+    LogStream& operator<<(bool v) {
+        if(!m_plain) {
+            return fallback(v);
+        }
+        m_buf.append(v ? "1" : "0", 1);
+        return *this;
+    }
+    LogStream& operator<<(char v) { return appendChar(v); }
+    LogStream& operator<<(signed char v) { return appendChar(v); }
+    LogStream& operator<<(unsigned char v) { return appendChar(v); }
+    LogStream& operator<<(short v) { return m_plain ? appendInt(v) : fallback(v); }
+    LogStream& operator<<(unsigned short v) { return m_plain ? appendUInt(v) : fallback(v); }
+    LogStream& operator<<(int v) { return m_plain ? appendInt(v) : fallback(v); }
+    LogStream& operator<<(unsigned int v) { return m_plain ? appendUInt(v) : fallback(v); }
+    LogStream& operator<<(long v) { return m_plain ? appendInt(v) : fallback(v); }
+    LogStream& operator<<(unsigned long v) { return m_plain ? appendUInt(v) : fallback(v); }
+    LogStream& operator<<(long long v) { return m_plain ? appendInt(v) : fallback(v); }
+    LogStream& operator<<(unsigned long long v) { return m_plain ? appendUInt(v) : fallback(v); }
+    LogStream& operator<<(float v) { return m_plain ? appendFloat(v) : fallback(v); }
+    LogStream& operator<<(double v) { return m_plain ? appendDouble(v) : fallback(v); }
+
+    /**
+     * @brief 空指针输出"(null)"
+     */
+    LogStream& operator<<(const char* v) {
+        if(!m_plain) {
+            return v ? fallback(v) : fallback("(null)");
+        }
+        return v ? write(v, strlen(v)) : write("(null)", 6);
+    }
+    LogStream& operator<<(char* v) { return *this << (const char*)v; }
+    LogStream& operator<<(const std::string& v) { return m_plain ? write(v.c_str(), v.size()) : fallback(v); }
+    LogStream& operator<<(const LogStringRef& v) {
+        if(!m_plain) {
+            return fallback(v.str());
+        }
+        return write(v.data(), v.size());
+    }
+
+    /**
+     * @brief std::endl、std::flush 等操纵符
+     */
+    LogStream& operator<<(std::ostream& (*manip)(std::ostream&)) {
+        manip(m_os);
+        return *this;
+    }
+
+    /**
+     * @brief std::hex、std::fixed 等操纵符
+     */
+    LogStream& operator<<(std::ios_base& (*manip)(std::ios_base&)) {
+        manip(m_os);
+        updatePlain();
+        return *this;
+    }
+
+    template<class T, class A>
+    LogStream& operator<<(const std::vector<T, A>& v) { return appendSeq(v.begin(), v.end()); }
+    template<class T, class A>
+    LogStream& operator<<(const std::list<T, A>& v) { return appendSeq(v.begin(), v.end()); }
+    template<class T, class C, class A>
+    LogStream& operator<<(const std::set<T, C, A>& v) { return appendSeq(v.begin(), v.end()); }
+    template<class T, class H, class E, class A>
+    LogStream& operator<<(const std::unordered_set<T, H, E, A>& v) { return appendSeq(v.begin(), v.end()); }
+    template<class K, class V, class C, class A>
+    LogStream& operator<<(const std::map<K, V, C, A>& v) { return appendMap(v.begin(), v.end()); }
+    template<class K, class V, class H, class E, class A>
+    LogStream& operator<<(const std::unordered_map<K, V, H, E, A>& v) { return appendMap(v.begin(), v.end()); }
+
+    /**
+     * @brief 键值字段，见 LogKv
+     */
+    template<class T>
+    LogStream& operator<<(const LogKeyValue<T>& kv);
+
+    /**
+     * @brief 按{}占位符依次输出参数，{{ 和 }} 输出花括号
+     * @details 运行时不检查个数：多余的参数忽略，没有参数对应的占位符原样输出
+     */
+    template<class... Args>
+    LogStream& format(const char* fmt, const Args&... args) {
+        formatNext(fmt, args...);
+        return *this;
+    }
+
+    /**
+     * @brief 其他类型交给std::ostream
+     */
+    template<class T>
+    LogStream& operator<<(const T& v) { return fallback(v); }
+private:
+    template<class T>
+    LogStream& fallback(const T& v) {
+        m_os << v;
+        updatePlain();
+        return *this;
+    }
+
+    LogStream& appendChar(char c) {
+        if(!m_plain) {
+            return fallback(c);
+        }
+        m_buf.append(&c, 1);
+        return *this;
+    }
+
+    void formatNext(const char* fmt) {
+        while(fmt) {
+            fmt = appendFormatLiteral(fmt);
+            if(fmt) {
+                write("{}", 2);
+            }
+        }
+    }
+
+    template<class T, class... Rest>
+    void formatNext(const char* fmt, const T& v, const Rest&... rest) {
+        fmt = appendFormatLiteral(fmt);
+        if(fmt) {
+            *this << v;
+            formatNext(fmt, rest...);
+        }
+    }
+
+    /**
+     * @brief 输出到下一个占位符之前的文字
+     * @return 占位符之后的位置，已经到结尾时返回nullptr
+     */
+    const char* appendFormatLiteral(const char* fmt);
+
+    LogStream& appendInt(long long v);
+    LogStream& appendUInt(unsigned long long v);
+    LogStream& appendDouble(double v);
+    LogStream& appendFloat(float v);
+
+    template<class It>
+    LogStream& appendSeq(It begin, It end) {
+        write("[", 1);
+        for(It it = begin; it != end; ++it) {
+            if(it != begin) {
+                write(", ", 2);
+            }
+            *this << *it;
+        }
+        return write("]", 1);
+    }
+
+    template<class It>
+    LogStream& appendMap(It begin, It end) {
+        write("{", 1);
+        for(It it = begin; it != end; ++it) {
+            if(it != begin) {
+                write(", ", 2);
+            }
+            *this << it->first;
+            write(": ", 2);
+            *this << it->second;
+        }
+        return write("}", 1);
+    }
+
+    /**
+     * @brief 底层流的格式是否为默认值，是的话内置类型走快速路径
+     */
+    void updatePlain();
+private:
+    LogStreamBuf& m_buf;
+    std::ostream& m_os;
+    bool m_plain = true;
+    // 是否交出过底层的std::ostream
+    bool m_raw = false;
+};
+
+/**
+ * @brief 日志事件附带的键值字段
+ * @details 字段名和字符串值复制到事件的字段缓冲区中，offset/len是在缓冲区中的位置
+ */
+struct LogField {
+    enum Type {
+        INT = 0,
+        UINT,
+        DOUBLE,
+        BOOL,
+        STRING
+    };
+
+    uint8_t type;
+    uint32_t key_offset;
+    uint32_t key_len;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+    };
+    // STRING类型的值
+    uint32_t offset;
+    uint32_t len;
 };
 
 /*
@@ -113,9 +559,22 @@ class LogEvent
 {
 public:
     typedef std::shared_ptr<LogEvent> ptr;
-    LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level,  const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
+    /**
+     * @brief 构造日志事件
+     * @param[in] logger 日志器，需要保证在事件使用期间有效
+     * @param[in] time 时间戳(秒)，为0时采集当前的墙上时间(纳秒精度)
+     */
+    LogEvent(Logger* logger, LogLevel::Level level,  const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
+    LogEvent(const std::shared_ptr<Logger>& logger, LogLevel::Level level,  const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
+    LogEvent(const LogEvent&) = delete;
+    LogEvent& operator=(const LogEvent&) = delete;
+
+    /**
+     * @brief 复用事件对象，重新设置各字段并清空日志内容
+     */
+    void reset(Logger* logger, LogLevel::Level level,  const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
 
-    std::shared_ptr<Logger> getLogger() const { return m_logger; }
+    Logger* getLogger() const { return m_logger; }
     LogLevel::Level getLevel() const { return m_level; }
     const char* getFile() const { return m_file; }
     int32_t getLine() const { return m_line; }
@@ -123,40 +582,160 @@ public:
     uint32_t getThreadId() const { return m_threadId; }
     uint32_t getFiberId() const { return m_fiberId; }
     uint64_t getTime() const { return m_time; }
-    std::string getContext() const { return m_ss.str(); }
-    std::stringstream& getSS() { return m_ss; }
+    uint64_t getTimeNS() const { return m_timeNs; }
+    uint64_t getMonotonicNS() const { return m_monoNs; }
+    /**
+     * @brief 产生事件的线程的上下文，事件不是在threadId对应的线程中产生时为nullptr
+     */
+    const ThreadContext* getThreadContext() const { return m_context; }
+    /**
+     * @brief 产生事件时MDC的深度，之后压入的键值不属于这个事件
+     */
+    uint32_t getMDCDepth() const { return m_mdcDepth; }
+    /**
+     * @brief 设置墙上时间(纳秒)，用于还原离线记录的日志
+     */
+    void setTimeNS(uint64_t ns) { m_timeNs = ns; m_time = ns / 1000000000; }
+    std::string getContext() const { return std::string(m_buf.data(), m_buf.size()); }
+    const char* getContextData() const { return m_buf.data(); }
+    size_t getContextSize() const { return m_buf.size(); }
+    /**
+     * @brief 日志内容，不复制，下次修改事件前有效
+     */
+    LogStringRef getMessage() const { return LogStringRef(m_buf.data(), m_buf.size()); }
+    /**
+     * @brief 日志内容的std::ostream，兼容旧接口
+     * @details 走标准库的格式化，比 getStream() 慢，新代码使用 getStream()
+     */
+    std::ostream& getSS() { return m_stream.stream(); }
+    /**
+     * @brief 日志内容流，常用类型不经过std::ostream
+     */
+    LogStream& getStream() { return m_stream; }
 
     /**
     * @brief 使用格式化模式将日志内容输入日志内容流
+    * @details 直接格式化到事件的缓冲区，不分配内存；编译器按printf检查格式和参数类型
     */
-    void format(const char* fmt, ...);
-    void format(const char* fmt, va_list al);
+    void format(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+    void format(const char* fmt, va_list al) __attribute__((format(printf, 2, 0)));
+
+    /**
+     * @brief 添加键值字段，由json/logfmt格式和文本格式的%K输出
+     * @details 对象池中的事件复用字段缓冲区，稳定运行后不分配内存
+     */
+    void addField(const char* key, bool v) { addBool(key, v); }
+    void addField(const char* key, int v) { addInt(key, v); }
+    void addField(const char* key, long v) { addInt(key, v); }
+    void addField(const char* key, long long v) { addInt(key, v); }
+    void addField(const char* key, unsigned v) { addUInt(key, v); }
+    void addField(const char* key, unsigned long v) { addUInt(key, v); }
+    void addField(const char* key, unsigned long long v) { addUInt(key, v); }
+    void addField(const char* key, float v) { addDouble(key, v); }
+    void addField(const char* key, double v) { addDouble(key, v); }
+    void addField(const char* key, const char* v) { addString(key, v, strlen(v)); }
+    void addField(const char* key, const std::string& v) { addString(key, v.c_str(), v.size()); }
+
+    const std::vector<LogField>& getFields() const { return m_fields; }
+    const char* getFieldData() const { return m_fieldData.c_str(); }
+
+    /**
+     * @brief 取得日志内容流所属的事件，不是日志内容流时返回nullptr
+     */
+    static LogEvent* FromStream(std::ostream& os);
+private:
+    LogField& newField(const char* key, LogField::Type type);
+    void addInt(const char* key, int64_t v);
+    void addUInt(const char* key, uint64_t v);
+    void addDouble(const char* key, double v);
+    void addBool(const char* key, bool v);
+    void addString(const char* key, const char* v, size_t len);
+
+    /**
+     * @brief 日志内容流中保存事件指针的pword下标
+     */
+    static int StreamIndex();
 private:
     const char* m_file = nullptr;       // 文件名
     int32_t m_line = 0;                 // 行号
     uint32_t m_elapse = 0;              // 程序启动开始到现在的毫秒数
     uint32_t m_threadId = 0;            // 线程id
     uint32_t m_fiberId = 0;             // 协程id
-    uint64_t m_time;                    // 时间戳
-    std::stringstream m_ss;              // 日志内容流
-    std::shared_ptr<Logger> m_logger;   // 日志器
+    uint64_t m_time;                    // 时间戳(秒)
+    uint64_t m_timeNs;                  // 墙上时间(纳秒)
+    uint64_t m_monoNs;                  // 单调时钟(纳秒)，用于计算间隔
+    const ThreadContext* m_context = nullptr;   // 线程上下文(线程名和MDC)
+    uint32_t m_mdcDepth = 0;            // MDC深度
+    LogStreamBuf m_buf;                 // 日志内容缓冲区
+    std::ostream m_ss;                  // 日志内容流，LogStream 处理不了的类型使用
+    LogStream m_stream;                 // 日志内容流
+    Logger* m_logger;                   // 日志器
     LogLevel::Level m_level;            // 日志等级
+    std::vector<LogField> m_fields;     // 键值字段
+    std::string m_fieldData;            // 字段名和字符串值
+};
+
+/**
+ * @brief 流式日志中的键值字段，用 LogKv 构造
+ */
+template<class T>
+struct LogKeyValue {
+    const char* key;
+    const T& value;
 };
 
+/**
+ * @brief 构造键值字段，例如 ORANGE_LOG_INFO(logger) << "login" << orange::LogKv("user", name);
+ */
+template<class T>
+LogKeyValue<T> LogKv(const char* key, const T& value) {
+    return LogKeyValue<T>{key, value};
+}
+
+/**
+ * @brief 写入日志内容流时作为字段添加到事件，写入其他流时输出 key=value
+ */
+template<class T>
+std::ostream& operator<<(std::ostream& os, const LogKeyValue<T>& kv) {
+    LogEvent* event = LogEvent::FromStream(os);
+    if(event) {
+        event->addField(kv.key, kv.value);
+    } else {
+        os << kv.key << '=' << kv.value;
+    }
+    return os;
+}
+
+template<class T>
+LogStream& LogStream::operator<<(const LogKeyValue<T>& kv) {
+    m_os << kv;
+    return *this;
+}
+
 /**
  * @brief 日志事件包装器
+ * @details 事件对象取自线程级对象池，析构时写入日志器并归还，
+ *          稳定运行后一次日志调用不会分配内存
  */
 class LogEventWarp
 {
 public:
+    LogEventWarp(Logger* logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
+    LogEventWarp(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file, int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time);
     LogEventWarp(LogEvent::ptr event);
     ~LogEventWarp();
 
-    LogEvent::ptr getEvent() const {return m_event;}
-    std::stringstream& getSS();
+    LogEvent* getEvent() const {return m_event;}
+    /**
+     * @brief 见 LogEvent::getSS()
+     */
+    std::ostream& getSS();
+    LogStream& getStream();
 private:
     // 日志事件
-    LogEvent::ptr m_event;
+    LogEvent* m_event;
+    // 外部传入的事件，不属于对象池
+    LogEvent::ptr m_holder;
 };
 
 /*
@@ -166,115 +745,673 @@ class LogFormater{
 public:
     typedef std::shared_ptr<LogFormater> ptr;
 
+    /**
+     * @brief 输出格式
+     */
+    enum Mode {
+        TEXT = 0,   // 按pattern输出文本
+        JSON,       // pattern为"json"，每条日志一行JSON
+        LOGFMT      // pattern为"logfmt"，每条日志一行 key=value
+    };
+
+    /**
+     * @param[in] pattern 文本格式，或者"json"/"logfmt"使用结构化格式
+     * @details 结构化格式输出时间、级别、日志名称、线程、协程、文件、行号、消息和全部字段，
+     *          消息和字符串字段按格式转义
+     */
     LogFormater(const std::string& pattern);
 
     /**
-    * @brief 将event中内容按照 pattern 格式输入到 ostream 流中
-    * @param[out] os 字符串输出流
+    * @brief 将event中内容按照 pattern 格式化成字符串
     * @param[in] event 日志事件
     */
     std::string format(LogEvent::ptr event);
 
+    /**
+    * @brief 将event中内容按照 pattern 追加到 buf 末尾
+    * @details buf 由调用方复用，容量足够时不会分配内存
+    * @param[out] buf 输出缓冲区
+    * @param[in] event 日志事件
+    */
+    void render(std::string& buf, const LogEvent& event) const;
+
     /**
      * @brief 是否有错误
      */
     bool isError() const { return m_error;}
 
     const std::string getPattern() const{ return m_pattern;}
+
+    Mode getMode() const { return m_mode; }
 private:
-        /**
-        * @brief 初始化，按照 pattern 解析日志格式，将相应的 item 按照顺序放入 item vector中
-        */
+    /**
+    * @brief 初始化，按照 pattern 解析日志格式，编译成指令数组
+    */
     void init();
-public:
-    class FormatItem{
-    public:
-        typedef std::shared_ptr<FormatItem> ptr;
-
-        FormatItem(const std::string& str = "") {};
-        virtual ~FormatItem() = default;
-
-        /**
-        * @brief 将event中各项内容按照 item规则解析到 ostream 流中
-        * @param[out] os 字符串输出流
-        * @param[in] event 日志事件
-        */
-        virtual void format(std::ostream& os, LogEvent::ptr event) = 0;
-    };
 
+    /**
+     * @brief 编译json/logfmt格式
+     */
+    void initStructured();
+
+    /**
+    * @brief 追加一段字面量，与前一段相邻的字面量合并
+    */
+    void appendLiteral(const std::string& str);
+
+    /**
+     * @brief 追加字段指令
+     * @param[in] escape 字符串内容的转义方式，取值为Mode
+     */
+    void appendField(uint8_t field, uint8_t escape = TEXT);
+
+    /**
+     * @brief 追加时间指令
+     */
+    void appendDateTime(const std::string& fmt);
 private:
+    /**
+     * @brief 格式字段
+     */
+    enum Field {
+        LITERAL = 0,    // 字面量
+        MESSAGE,        // %m 消息
+        LEVEL,          // %p 日志级别
+        ELAPSE,         // %r 启动后的耗时
+        NAME,           // %c 日志名称
+        THREAD_ID,      // %t 线程id
+        DATETIME,       // %d 时间
+        FILENAME,       // %f 文件名
+        LINE,           // %l 行号
+        FIBER_ID,       // %F 协程id
+        NEWLINE,        // %n 换行
+        TAB,            // %T Tab
+        MSEC,           // %ms 毫秒部分
+        USEC,           // %us 微秒部分
+        NSEC,           // %ns 纳秒部分
+        FIELDS,         // %K 键值字段
+        THREAD_NAME,    // %N 线程名称
+        MDC             // %X{key} MDC中key的值，%X 全部MDC键值
+    };
+
+    /**
+     * @brief 编译后的格式指令
+     */
+    struct Op {
+        // 字段
+        uint8_t field;
+        // 字面量/时间格式在 m_literals 中的偏移
+        uint32_t offset;
+        // 字面量长度
+        uint32_t len;
+        // 转义方式
+        uint8_t escape = TEXT;
+    };
+
     // 日志格式
     std::string m_pattern;
-    // 日志解析item vector
-    std::vector<FormatItem::ptr> m_items;
+    // 输出格式
+    Mode m_mode = TEXT;
+    // 所有字面量和时间格式连续存放
+    std::string m_literals;
+    // 指令数组
+    std::vector<Op> m_ops;
     // 是否有错误
     bool m_error = false;
+    // 格式器唯一id，用于线程时间缓存
+    uint64_t m_id;
 };
 
-/*
-* @brief 日志输出地
-*/
-class LogAppender{
-public:
-    typedef std::shared_ptr<LogAppender> ptr;
-
-    virtual ~LogAppender() = default;
-    
-    virtual void log(LogLevel::Level level, LogEvent::ptr event) = 0;
+/**
+ * @brief Appender的刷新策略
+ * @details 各条件满足任意一个就调用flush()。都不设置时由Appender自己的缓冲决定何时写出。
+ *          异步模式的 FileLogAppneder 写日志时满足条件只通知后台线程，不等待写完，FATAL除外
+ */
+struct LogFlushPolicy {
+    // 累计N条后刷新，1表示每条都刷新，0不按条数
+    uint32_t records = 0;
+    // 累计N字节后刷新，0不按字节数
+    uint32_t bytes = 0;
+    // 定时刷新的间隔(毫秒)，由公共的刷新线程执行，0不定时
+    uint32_t interval = 0;
+    // 达到该级别的日志立即刷新，UNKNOWN不按级别
+    LogLevel::Level level = LogLevel::UNKNOWN;
 
-    LogFormater::ptr getFormater() const;
-    void setFormater(LogFormater::ptr formater);
+    /**
+     * @brief 是否需要在写日志时检查
+     */
+    bool isEnabled() const { return records || bytes || level != LogLevel::UNKNOWN; }
 
-    LogLevel::Level getLevel() const { return m_level;}
-    void setLevel(LogLevel::Level level) { m_level = level;}
-protected:
-    // 日志等级
-    LogLevel::Level m_level = LogLevel::DEBUG;
-    // 日志格式器
-    LogFormater::ptr m_formater;
+    bool operator==(const LogFlushPolicy& oth) const {
+        return records == oth.records
+            && bytes == oth.bytes
+            && interval == oth.interval
+            && level == oth.level;
+    }
 };
 
-/*
-* @brief 输出到控制台的Appender
-*/ 
-class StdoutLogAppneder : public LogAppender{
+/**
+ * @brief 一条日志按各个格式器格式化的结果
+ * @details Logger 写一条日志时在所有Appender之间共用，使用同一个格式器的Appender只格式化一次
+ */
+class LogRenderCache {
 public:
-    typedef std::shared_ptr<StdoutLogAppneder> ptr;
+    /**
+     * @brief 取formater格式化event的结果，没有时格式化
+     * @details 返回的指针在下一次调用前有效
+     * @param[out] rendered 这次调用是否执行了格式化
+     */
+    const char* get(const LogFormater* formater, const LogEvent& event, size_t& len, bool& rendered);
 
-    void log(LogLevel::Level level, LogEvent::ptr event) override;
+    void clear() {
+        m_buf.clear();
+        m_items.clear();
+    }
+private:
+    struct Item {
+        const LogFormater* formater;
+        size_t offset;
+        size_t len;
+    };
+    // 各个格式器的结果依次追加在一起，稳定运行后不分配内存
+    std::string m_buf;
+    std::vector<Item> m_items;
 };
 
 /*
-* @brief 输出到文件的Appender
+* @brief 日志输出地
 */
-class FileLogAppneder : public LogAppender{
+class LogAppender : public std::enable_shared_from_this<LogAppender> {
 public:
-    typedef std::shared_ptr<FileLogAppneder> ptr;
+    typedef std::shared_ptr<LogAppender> ptr;
 
-    FileLogAppneder(const std::string& filename);
+    virtual ~LogAppender() = default;
 
-    void log(LogLevel::Level level, LogEvent::ptr event) override;
+    /**
+     * @brief 输出一条日志
+     * @details 默认经过级别和过滤器检查、格式化后交给 append()，需要自己处理LogEvent的Appender才重写
+     */
+    virtual void log(LogLevel::Level level, const LogEvent& event) { renderAppend(level, event); }
 
-    /*
-    * @brief 重新打开文件，文件打开成功返回true
-    */
-    bool reopen();
-private:
-    // 文件名
-    std::string m_filename;
-    // 文件流
-    std::ofstream m_filestream;
-};
+    /**
+     * @brief 由 Logger 调用，cache 中可能已有相同格式器的格式化结果
+     * @details 默认调用 log()；内置的Appender从cache取结果再调用 append()，不会重复格式化
+     */
+    virtual void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) {
+        log(level, event);
+    }
+
+    /**
+     * @brief 将缓冲中的日志写出
+     */
+    virtual void flush() {}
+
+    /**
+     * @brief 进程崩溃时把缓冲中的日志直接写入文件
+     * @details 在致命信号处理函数中调用，不能加锁、分配内存或调用非异步信号安全的函数
+     * @return 崩溃记录要写入的文件描述符，没有时返回-1
+     */
+    virtual int crashDrain() { return -1; }
+
+    /**
+     * @brief 名称，用于统计输出
+     */
+    virtual std::string getName() const { return "LogAppender"; }
+
+    /**
+     * @brief 统计计数的当前值
+     */
+    virtual LogStats::Snapshot getStats() const { return m_stats.snapshot(); }
+
+    LogFormater::ptr getFormater() const;
+    void setFormater(LogFormater::ptr formater);
+
+    LogLevel::Level getLevel() const { return m_level;}
+    void setLevel(LogLevel::Level level) { m_level = level;}
+
+    /**
+     * @brief 设置过滤器，可以在输出日志时修改
+     * @details 在格式化之前判断，ACCEPT的日志不再检查级别，DENY的日志丢弃，NEUTRAL按级别决定。
+     *          和 Logger::setFilter() 一样用RCU发布，正在判断的日志使用旧过滤器
+     */
+    void setFilter(std::shared_ptr<LogFilter> filter);
+    std::shared_ptr<LogFilter> getFilter() const;
+
+    /**
+     * @brief 设置刷新策略，需要在开始输出日志前设置
+     * @details 设置了定时刷新时注册到公共的刷新线程，Appender必须由shared_ptr管理
+     */
+    void setFlushPolicy(const LogFlushPolicy& policy);
+    const LogFlushPolicy& getFlushPolicy() const { return m_flushPolicy; }
+protected:
+    /**
+     * @brief 这一条日志是否需要输出，先经过过滤器，再检查级别
+     */
+    bool accept(LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 级别和过滤器过滤，从cache取格式化结果交给 append()，同时记录统计
+     */
+    void renderAppend(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache);
+
+    /**
+     * @brief 使用当前线程的缓存执行 renderAppend()，直接调用 log() 时使用
+     */
+    void renderAppend(LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 写入一条格式化好的日志，由 renderAppend() 调用，子类必须实现
+     */
+    virtual void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) = 0;
+
+    /**
+     * @brief 写入一条日志后是否需要刷新，没有设置条件时只判断一次
+     * @param[in] len 这条日志的字节数
+     */
+    bool shouldFlush(LogLevel::Level level, size_t len) {
+        return m_flushEnabled && checkFlush(level, len);
+    }
+
+    /**
+     * @brief 定时刷新的间隔(毫秒)，0表示不需要定时刷新
+     * @details 默认是刷新策略的间隔，自带缓冲区的子类可以给出更短的间隔
+     */
+    virtual uint32_t getFlushInterval() const { return m_flushPolicy.interval; }
+
+    /**
+     * @brief 按 getFlushInterval() 注册到公共的刷新线程，Appender必须由shared_ptr管理
+     */
+    void startFlushTimer();
+private:
+    bool checkFlush(LogLevel::Level level, size_t len);
+protected:
+    // 日志等级
+    LogLevel::Level m_level = LogLevel::DEBUG;
+    // 日志格式器
+    LogFormater::ptr m_formater;
+    // 过滤器，在RCU读临界区内访问
+    RcuPtr<std::shared_ptr<LogFilter> > m_filter;
+    // 统计计数
+    LogStats m_stats;
+private:
+    LogFlushPolicy m_flushPolicy;
+    bool m_flushEnabled = false;
+    // 上次刷新后累计的条数和字节数
+    std::atomic<uint32_t> m_flushRecords{0};
+    std::atomic<uint64_t> m_flushBytes{0};
+};
+
+/*
+* @brief 输出到控制台的Appender
+*/ 
+class StdoutLogAppneder : public LogAppender{
+public:
+    typedef std::shared_ptr<StdoutLogAppneder> ptr;
+
+    void log(LogLevel::Level level, const LogEvent& event) override;
+    void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) override;
+
+    /**
+     * @brief 刷新std::cout，默认由标准库的缓冲决定何时写出
+     */
+    void flush() override;
+
+    std::string getName() const override;
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override;
+};
+
+/*
+* @brief 输出到文件的Appender
+* @details 同步模式下日志先进入用户态缓冲区，满了或调用flush时写入文件
+*/
+class FileLogAppneder : public LogAppender{
+public:
+    typedef std::shared_ptr<FileLogAppneder> ptr;
+    // 同步模式缓冲区大小(字节)
+    static const size_t BUFFER_SIZE = 8192;
+
+    FileLogAppneder(const std::string& filename);
+    ~FileLogAppneder();
+
+    void log(LogLevel::Level level, const LogEvent& event) override;
+    void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) override;
+
+    /**
+     * @brief 同步模式下写出缓冲区，异步模式下等待已提交的日志写入文件
+     */
+    void flush() override;
+
+    int crashDrain() override;
+
+    std::string getName() const override;
+
+    /**
+     * @brief 统计计数，包括异步写入器丢弃的条数和队列积压的最大字节数
+     */
+    LogStats::Snapshot getStats() const override;
+
+    /*
+    * @brief 重新打开文件，文件打开成功返回true
+    */
+    bool reopen();
+
+    /**
+     * @brief 开启异步模式，日志由后台线程批量写入文件
+     * @details 需要在开始写日志之前设置
+     */
+    void setAsync(const AsyncLogWriter::Config& config);
+
+    /**
+     * @brief 开启分片异步模式，每个线程写入自己的环形缓冲区，后台线程按时间归并后用writev写出
+     * @details 适合大量线程同时写同一个文件，需要在开始写日志之前设置
+     */
+    void setSharded(const ShardedLogWriter::Config& config);
+
+    bool isAsync() const { return m_async || m_sharded; }
+
+    /**
+     * @brief 异步模式下被丢弃的日志条数
+     */
+    uint64_t getDropped() const {
+        return (m_async ? m_async->getDropped() : 0) + (m_sharded ? m_sharded->getDropped() : 0);
+    }
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override;
+private:
+    /**
+     * @brief 将一段数据写入文件
+     */
+    void write(const char* data, size_t len);
+
+    /**
+     * @brief 分片模式下将一组数据写入文件
+     */
+    void writev(struct iovec* iov, int cnt);
+
+    /**
+     * @brief 把缓冲区写入m_fd，需要持有m_mutex
+     */
+    void flushBuffer();
+private:
+    // 文件名
+    std::string m_filename;
+    // 保护缓冲区和文件描述符
+    std::mutex m_mutex;
+    // 以追加方式打开的文件描述符
+    int m_fd = -1;
+    // 同步写入的缓冲区
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_bufferLen = 0;
+    // 异步写入器，为空时同步写入
+    AsyncLogWriter::ptr m_async;
+    // 分片异步写入器
+    ShardedLogWriter::ptr m_sharded;
+};
+
+/**
+ * @brief 按大小和时间滚动的文件Appender
+ * @details 通过O_APPEND打开的文件描述符写入，日志先进入用户态缓冲区，
+ *          满了或者超过刷新间隔再一次性write。当前文件达到大小上限或跨过时间间隔时，
+ *          把它改名为 文件名.年月日-时分秒 并打开新文件，改名不持有写锁，
+ *          其他线程在此期间继续写入旧文件。开启压缩后历史文件由后台线程压缩成 .olz，
+ *          清理超出保留个数的历史文件也在这个线程里进行，开启压缩时在每个文件压缩完之后
+ */
+class RollingFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<RollingFileLogAppender> ptr;
+
+    /**
+     * @brief 滚动配置
+     */
+    struct Config {
+        // 单个文件的大小上限(字节)，0表示不按大小滚动
+        uint64_t max_size = 100 * 1024 * 1024;
+        // 按时间滚动的间隔(秒)，按本地时间对齐，0表示不按时间滚动
+        uint32_t interval = 0;
+        // 保留的历史文件个数，原文件和压缩后的 .olz 算一个，0表示不清理
+        uint32_t max_files = 10;
+        // 用户态缓冲区大小(字节)
+        size_t buffer_size = 64 * 1024;
+        // 缓冲区最长保留多久(毫秒)，第一次写入后注册到公共的刷新线程，没有新日志时也按时写出
+        uint32_t flush_interval = 1000;
+        // 新文件用fallocate预分配的大小(字节)，0表示不预分配
+        uint64_t preallocate = 0;
+        // 是否在后台压缩滚动出去的文件
+        bool compress = false;
+        // 压缩配置
+        LogCompressor::Config compress_config;
+
+        bool operator==(const Config& oth) const {
+            return max_size == oth.max_size
+                && interval == oth.interval
+                && max_files == oth.max_files
+                && buffer_size == oth.buffer_size
+                && flush_interval == oth.flush_interval
+                && preallocate == oth.preallocate
+                && compress == oth.compress
+                && compress_config == oth.compress_config;
+        }
+    };
+
+    RollingFileLogAppender(const std::string& filename, const Config& config);
+    RollingFileLogAppender(const std::string& filename);
+    ~RollingFileLogAppender();
+
+    void log(LogLevel::Level level, const LogEvent& event) override;
+    void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) override;
+
+    /**
+     * @brief 把缓冲区写入文件
+     */
+    void flush() override;
+
+    /**
+     * @brief 立即滚动到新文件
+     */
+    void rotate();
+
+    /**
+     * @brief 等待已滚动出去的文件压缩和清理完成
+     */
+    void waitCompress();
+
+    int crashDrain() override;
+
+    std::string getName() const override;
+
+    const std::string& getFilename() const { return m_filename; }
+    const Config& getConfig() const { return m_config; }
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override;
+
+    /**
+     * @brief 刷新策略的间隔和flush_interval中较短的一个
+     */
+    uint32_t getFlushInterval() const override;
+private:
+    /**
+     * @brief 打开当前文件，返回文件描述符
+     */
+    int openFile();
+
+    /**
+     * @brief 把缓冲区写入m_fd，需要持有m_mutex
+     */
+    void flushBuffer();
+
+    /**
+     * @brief 计算time之后的下一个滚动时刻(秒)
+     */
+    uint64_t nextRotateTime(uint64_t time) const;
+
+    /**
+     * @brief 删除超出保留个数的历史文件
+     * @details 跳过压缩中的临时文件和还在等待压缩的文件
+     */
+    void removeOldFiles();
+private:
+    std::string m_filename;
+    Config m_config;
+
+    // 保护缓冲区和文件描述符
+    std::mutex m_mutex;
+    int m_fd = -1;
+    std::unique_ptr<char[]> m_buffer;
+    size_t m_bufferLen = 0;
+    // 当前文件已写入的大小(包括缓冲区)
+    uint64_t m_size = 0;
+    // 下一次按时间滚动的时刻(秒)
+    uint64_t m_nextRotate = 0;
+    // 上一次写文件的时间(纳秒)
+    uint64_t m_lastFlush = 0;
+    // 是否有线程正在滚动
+    bool m_rotating = false;
+    // 是否已经注册了定时刷新
+    bool m_flushTimer = false;
+    // 压缩滚动出去的文件并清理历史文件的后台线程，不压缩也不清理时为空
+    LogCompressor::ptr m_compressor;
+};
+
+/**
+ * @brief 内存映射文件Appender
+ * @details 把文件按段映射到内存，日志直接memcpy到映射区，写满一段后扩展文件并映射下一段，
+ *          不需要每条日志一次系统调用。进程崩溃时已经写入映射区的日志由内核写回文件。
+ *          按间隔或遇到高级别日志时调用msync落盘，关闭时把文件截断到实际长度
+ */
+class MmapFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<MmapFileLogAppender> ptr;
+
+    /**
+     * @brief 映射和落盘配置
+     */
+    struct Config {
+        // 每段映射的大小(字节)，向上取整为页大小的整数倍
+        size_t segment_size = 32 * 1024 * 1024;
+        // 定期msync的间隔(毫秒)，0表示不定期落盘
+        uint32_t sync_interval = 1000;
+        // 不低于该级别的日志写入后立即msync，UNKNOWN表示不按级别落盘
+        LogLevel::Level sync_level = LogLevel::ERROR;
+
+        bool operator==(const Config& oth) const {
+            return segment_size == oth.segment_size
+                && sync_interval == oth.sync_interval
+                && sync_level == oth.sync_level;
+        }
+    };
+
+    MmapFileLogAppender(const std::string& filename, const Config& config);
+    MmapFileLogAppender(const std::string& filename);
+    ~MmapFileLogAppender();
+
+    void log(LogLevel::Level level, const LogEvent& event) override;
+    void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) override;
+
+    /**
+     * @brief 把已写入的内容同步到磁盘
+     */
+    void flush() override;
+
+    std::string getName() const override;
+
+    const std::string& getFilename() const { return m_filename; }
+    const Config& getConfig() const { return m_config; }
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override;
+private:
+    /**
+     * @brief 映射offset所在的段，需要持有m_mutex
+     */
+    bool mapSegment(uint64_t offset);
+
+    /**
+     * @brief 解除当前段的映射，需要持有m_mutex
+     */
+    void unmapSegment();
+
+    /**
+     * @brief 同步上次同步之后写入的内容，需要持有m_mutex
+     */
+    void sync();
+private:
+    std::string m_filename;
+    Config m_config;
+
+    std::mutex m_mutex;
+    int m_fd = -1;
+    // 当前段的映射地址
+    char* m_segment = nullptr;
+    // 当前段在文件中的起始位置
+    uint64_t m_segmentOffset = 0;
+    // 日志写到的位置
+    uint64_t m_offset = 0;
+    // 已同步到的位置
+    uint64_t m_synced = 0;
+    // 上次同步的时间(纳秒)
+    uint64_t m_lastSync = 0;
+};
+
+/**
+ * @brief 日志限流配置
+ * @details 对每个调用点分别生效：令牌桶限制每秒条数，采样每N条只保留1条
+ */
+struct LogLimit {
+    // 每个调用点每秒允许的条数，0表示不限速
+    uint32_t rate = 0;
+    // 令牌桶容量，允许的突发条数，0表示与rate相同
+    uint32_t burst = 0;
+    // 每N条只输出1条，0和1表示不采样
+    uint32_t sample = 0;
+    // 输出"suppressed N messages"汇总的最短间隔(毫秒)
+    uint32_t summary_interval = 1000;
+
+    bool isEnabled() const { return rate || sample > 1; }
+
+    bool operator==(const LogLimit& oth) const {
+        return rate == oth.rate
+            && burst == oth.burst
+            && sample == oth.sample
+            && summary_interval == oth.summary_interval;
+    }
+};
+
+/**
+ * @brief 可以并发读写的限流配置
+ * @details 各字段单独原子读写，修改过程中读到新旧混合的值只会影响一两条日志
+ */
+class AtomicLogLimit {
+public:
+    void store(const LogLimit& limit);
+    LogLimit load() const;
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+private:
+    std::atomic<bool> m_enabled{false};
+    std::atomic<uint32_t> m_rate{0};
+    std::atomic<uint32_t> m_burst{0};
+    std::atomic<uint32_t> m_sample{0};
+    std::atomic<uint32_t> m_summaryInterval{1000};
+};
 
 /*
 * @brief 日志器
 */
+/**
+ * @brief 日志器
+ * @details 日志器按名称中的'.'组成层级，例如 net.http.server 的父日志器是 net.http，
+ *          顶层的父日志器是root。没有设置级别的日志器继承父日志器的级别，
+ *          没有Appender的日志器使用最近的有Appender的祖先的Appender
+ */
 class Logger{
+friend class LoggerManager;
 public:
     typedef std::shared_ptr<Logger> ptr;
     
     Logger(const std::string& name = "root");
+    ~Logger();
 
+    void log(LogLevel::Level level, const LogEvent& event);
     void log(LogLevel::Level level, LogEvent::ptr event);
     void debug(LogEvent::ptr event);
     void info(LogEvent::ptr event);
@@ -282,18 +1419,280 @@ public:
     void error(LogEvent::ptr event);
     void fatal(LogEvent::ptr event);
 
+    /**
+     * @brief 添加Appender
+     * @details 写时复制，正在输出日志的线程继续使用旧的集合，不会被阻塞
+     */
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
 
-    LogLevel::Level getLevel() const { return m_level; }
-    void setLevel(LogLevel::Level level) { m_level = level; }
+    /**
+     * @brief 一次性替换全部Appender，替换过程中日志不会丢失
+     */
+    void setAppenders(const std::vector<LogAppender::ptr>& appenders);
+
+    /**
+     * @brief 设置默认格式，之后添加的没有格式器的Appender使用该格式
+     * @return 格式错误返回false
+     */
+    bool setFormatter(const std::string& pattern);
+
+    /**
+     * @brief 生效的日志级别
+     */
+    LogLevel::Level getLevel() const { return (LogLevel::Level)(getEffective() & 0xf); }
+
+    /**
+     * @brief level级别的日志是否可能输出，日志宏的快速路径，不可能时计入过滤条数，
+     *        共用统计条带的线程不计入
+     * @details 有过滤器时比较的是按过滤器的级别和日志器名称条件算出的放行级别，
+     *          还需要其他条件时由 filter() 和 log() 逐条判断
+     */
+    bool isEnabled(LogLevel::Level level) const {
+        if((LogLevel::Level)(getEffective() >> 4 & 0xf) <= level) {
+            return true;
+        }
+        m_stats.addExclusive(LogStats::FILTERED);
+        return false;
+    }
+
+    /**
+     * @brief 生效的过滤器是否需要逐条判断，只由级别决定时为false
+     */
+    bool hasFilter() const { return getEffective() & FILTER_FLAG; }
+
+    /**
+     * @brief 在构造LogEvent之前用生效的过滤器判断，不需要输出时计入过滤条数
+     * @details 需要消息内容才能判断的放行，由 log() 再判断
+     */
+    bool filter(LogLevel::Level level, const char* file) const;
+
+    /**
+     * @brief 设置过滤器，nullptr表示继承父日志器的过滤器
+     * @details 没有自己的过滤器的日志器使用最近的有过滤器的祖先的过滤器，过滤器的日志器条件
+     *          按写日志的日志器名称判断。在格式化之前判断，ACCEPT的日志不再检查级别，
+     *          DENY的日志丢弃，NEUTRAL按级别决定
+     */
+    void setFilter(std::shared_ptr<LogFilter> filter);
+
+    /**
+     * @brief 本日志器设置的过滤器
+     */
+    std::shared_ptr<LogFilter> getFilter() const;
+
+    /**
+     * @brief 设置本日志器的级别，UNKNOWN表示继承父日志器
+     */
+    void setLevel(LogLevel::Level level);
+
+    /**
+     * @brief 本日志器设置的级别，没有设置时为UNKNOWN
+     */
+    LogLevel::Level getOwnLevel() const { return m_level.load(std::memory_order_relaxed); }
+
+    const std::string& getName() const { return m_name; };
+
+    /**
+     * @brief 按格式器的输出格式转义好的名称，构造时生成，结构化格式输出时不再逐条转义
+     * @param[in] mode LogFormater::Mode
+     */
+    const std::string& getEscapedName(uint8_t mode) const {
+        return mode == LogFormater::TEXT ? m_name : m_escapedName[mode - 1];
+    }
+
+    /**
+     * @brief 设置本日志器的限流配置，覆盖全局配置
+     */
+    void setLimit(const LogLimit& limit);
+
+    /**
+     * @brief 清除本日志器的限流配置，改用全局配置
+     */
+    void clearLimit();
+
+    /**
+     * @brief 当前生效的限流配置
+     */
+    LogLimit getLimit() const;
+
+    /**
+     * @brief 是否需要限流，日志宏的快速路径
+     */
+    bool isLimited() const {
+        return m_hasLimit.load(std::memory_order_relaxed) ? m_limit.isEnabled() : s_globalLimit.isEnabled();
+    }
+
+    /**
+     * @brief 设置全局限流配置，对没有单独配置的日志器生效
+     */
+    static void SetGlobalLimit(const LogLimit& limit);
+    static LogLimit GetGlobalLimit();
+
+    /**
+     * @brief 本日志器的统计计数，不包括子日志器
+     */
+    LogStats::Snapshot getStats() const { return m_stats.snapshot(); }
+
+    /**
+     * @brief 在日志器之外处理的记录(限流、二进制日志)计数
+     */
+    void addStat(LogStats::Counter counter, uint64_t v = 1) const { m_stats.add(counter, v); }
+
+    /**
+     * @brief 暂存下一版配置的Appender和过滤器，PublishConfig() 之前对日志不可见
+     * @details 没有格式器的Appender使用日志器的格式。同一时间只能有一个线程暂存和发布
+     */
+    void stageConfig(const std::vector<LogAppender::ptr>& appenders, std::shared_ptr<LogFilter> filter);
 
-    std::string getName() const { return m_name; };
+    /**
+     * @brief 一次发布所有暂存的配置
+     * @details 只修改全局的配置代数，输出日志的线程不加锁也不等待：之前开始的日志完整地使用旧配置，
+     *          之后开始的日志完整地使用新配置，不会看到一部分日志器是新配置、一部分是旧配置。
+     *          返回前等待使用旧配置的日志结束，再把暂存的配置写回各日志器，之后被替换的Appender
+     *          不会再收到日志。期间直接调用 setAppenders() 等修改这些日志器的结果会被覆盖。
+     *          不能在RCU读临界区内调用
+     * @param[in] loggers 调用过 stageConfig() 的日志器
+     */
+    static void PublishConfig(const std::vector<Logger::ptr>& loggers);
+private:
+    static const uint64_t FILTER_FLAG = 0x100;
+    typedef std::vector<LogAppender::ptr> AppenderList;
+
+    /**
+     * @brief 暂存的配置，config是发布它的配置代数
+     */
+    struct StagedConfig {
+        AppenderList appenders;
+        std::shared_ptr<LogFilter> filter;
+        uint64_t config;
+    };
+
+    /**
+     * @brief 按当前配置过滤并发给Appender，必须在RCU读临界区内调用
+     */
+    void dispatch(LogLevel::Level level, const LogEvent& event);
+
+    /**
+     * @brief 配置代数config下已经发布的暂存配置，没有时为nullptr，必须在RCU读临界区内调用
+     */
+    const StagedConfig* getStaged(uint64_t config) const {
+        const StagedConfig* staged = m_staged.load(std::memory_order_seq_cst);
+        return staged && staged->config <= config ? staged : nullptr;
+    }
+
+    /**
+     * @brief 配置代数config下本日志器的Appender集合，必须在RCU读临界区内调用
+     */
+    const AppenderList* getAppenderList(uint64_t config) const {
+        const StagedConfig* staged = getStaged(config);
+        return staged ? &staged->appenders : m_appenders.get();
+    }
+
+    /**
+     * @brief 配置代数config下本日志器的过滤器，必须在RCU读临界区内调用
+     */
+    const LogFilter* getOwnFilter(uint64_t config) const {
+        const StagedConfig* staged = getStaged(config);
+        return staged ? staged->filter.get() : m_filter.get()->get();
+    }
+
+    /**
+     * @brief 生效的级别和过滤器标志
+     * @details 低4位是级别，4-7位是放行级别，第8位表示过滤器需要逐条判断，高位是计算时的代数。
+     *          任何日志器的级别、过滤器或父子关系变化都会使代数加一，代数不一致时才沿父日志器重新计算
+     */
+    uint64_t getEffective() const {
+        uint64_t v = m_effective.load(std::memory_order_acquire);
+        if((v >> 16) == s_generation.load(std::memory_order_acquire)) {
+            return v;
+        }
+        return resolve();
+    }
+
+    /**
+     * @brief 沿父日志器计算生效的级别和过滤器并缓存
+     */
+    uint64_t resolve() const;
+
+    /**
+     * @brief 配置代数config下生效的过滤器，必须在RCU读临界区内调用
+     */
+    const LogFilter* findFilter(uint64_t config) const;
+
+    /**
+     * @brief 按过滤器的结果和级别决定是否输出
+     */
+    bool decide(int result, LogLevel::Level level) const;
+
+    /**
+     * @brief 复制oth自己的级别、格式、Appender、过滤器和限流配置，不包括名称和父日志器
+     */
+    void assign(const Logger& oth);
+
+    /**
+     * @brief 设置父日志器，只由LoggerManager在持有注册表写锁时调用
+     */
+    void setParent(const Logger::ptr& parent);
 private:
-    std::string m_name;                     // 日志名称
-    LogLevel::Level m_level;                // 日志级别
-    std::list<LogAppender::ptr> m_appenders;// Appender集合 
-    LogFormater::ptr m_formatter;           // 默认的格式器
+    std::string m_name;                         // 日志名称
+    std::string m_escapedName[2];               // JSON和logfmt转义后的名称
+    std::atomic<LogLevel::Level> m_level;       // 日志级别
+    mutable std::atomic<uint64_t> m_effective;  // 生效的级别和过滤器标志，高位是计算时的代数
+    std::atomic<Logger*> m_parent;              // 父日志器，在RCU读临界区内访问
+    Logger::ptr m_parentHolder;                 // 持有父日志器
+    RcuPtr<AppenderList> m_appenders;           // Appender集合，log()只读快照
+    LogFormater::ptr m_formatter;               // 默认的格式器
+    RcuPtr<std::shared_ptr<LogFilter> > m_filter; // 过滤器，在RCU读临界区内访问
+    std::atomic<StagedConfig*> m_staged;        // 暂存的下一版配置，发布后写回上面两项
+    std::atomic<bool> m_hasLimit;               // 是否单独配置了限流
+    AtomicLogLimit m_limit;                     // 本日志器的限流配置
+    static AtomicLogLimit s_globalLimit;        // 全局限流配置
+    mutable LogStats m_stats;                   // 统计计数
+    static std::atomic<uint64_t> s_generation;  // 级别、过滤器和层级关系的代数
+    static std::atomic<uint64_t> s_config;      // 已发布的配置代数
+};
+
+/**
+ * @brief 日志调用点的限流状态
+ * @details 令牌桶用GCRA算法实现，只有一个原子变量，多个线程在同一调用点并发时不加锁。
+ *          被限流的条数累计起来，间隔summary_interval输出一条汇总
+ */
+class LogSite {
+public:
+    LogSite(const char* file, int32_t line)
+        : m_file(file)
+        , m_line(line) {
+    }
+
+    /**
+     * @brief 是否允许输出这一条日志，先经过日志器的过滤器，再限流
+     */
+    template<class L>
+    bool allow(const L& logger, LogLevel::Level level) {
+        if(!logger->isLimited() && !logger->hasFilter()) {
+            return true;
+        }
+        return check(&*logger, level);
+    }
+
+    /**
+     * @brief 被限流且还没有汇总的条数
+     */
+    uint64_t getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+private:
+    bool check(Logger* logger, LogLevel::Level level);
+    bool checkLimit(Logger* logger, LogLevel::Level level);
+private:
+    const char* m_file;
+    int32_t m_line;
+    // 理论上下一条日志到达的时间(纳秒)
+    std::atomic<uint64_t> m_tat{0};
+    // 采样计数
+    std::atomic<uint64_t> m_count{0};
+    // 被限流的条数
+    std::atomic<uint64_t> m_suppressed{0};
+    // 上次输出汇总的时间(纳秒)
+    std::atomic<uint64_t> m_lastSummary{0};
 };
 
 /**
@@ -302,15 +1701,96 @@ private:
 class LoggerManager
 {
 public:
+    /**
+     * @brief 一个日志器及其Appender的统计
+     */
+    struct LoggerStats {
+        std::string name;
+        LogStats::Snapshot stats;
+        // Appender名称和统计
+        std::vector<std::pair<std::string, LogStats::Snapshot> > appenders;
+    };
+
     LoggerManager();
+    ~LoggerManager();
+
+    /**
+     * @brief 按名称查找日志器，不存在时创建，缺少的父日志器一并创建
+     * @details 已存在时不加锁，可以和addLogger/delLogger并发。新建的日志器继承父日志器的级别和Appender
+     */
     Logger::ptr getLogger(const std::string& name);
-    Logger::ptr getRoot() { return m_root; }
+
+    /**
+     * @brief 注册日志器
+     * @details 同名的日志器已经存在时保留原来的节点，把logger的级别、格式、Appender、过滤器和限流配置
+     *          复制过去，调用点缓存的句柄和子日志器继续有效，logger本身不注册
+     * @return 注册表中的日志器
+     */
+    Logger::ptr addLogger(Logger::ptr logger);
+
+    /**
+     * @brief 清除日志器的级别、Appender和限流配置，改为全部继承父日志器
+     * @details 节点保留在注册表中，子日志器和调用点缓存的句柄仍然有效
+     */
+    void delLogger(const std::string& name);
+
+    const Logger::ptr& getRoot() const { return m_root; }
+
+    /**
+     * @brief 注册配置项log和log_limit，按配置构建日志器
+     * @details 之后配置变化时在加载配置的线程中重建变化的日志器，其他线程可以继续输出日志。
+     *          多次调用只生效一次
+     */
     void init();
+
+    /**
+     * @brief 安装崩溃处理
+     * @details 收到SIGSEGV、SIGABRT、SIGBUS等信号时把所有文件Appender的缓冲写出，
+     *          再写一条带调用栈的崩溃记录，然后按默认方式结束进程。
+     *          安装后输出FATAL日志会立即刷新所有Appender
+     */
+    void installCrashHandler();
+
+    /**
+     * @brief 所有日志器的统计，按名称排序
+     * @details Appender的统计列在直接持有它的日志器下
+     */
+    std::vector<LoggerStats> getStats();
+
+    /**
+     * @brief 把统计输出为文本，每个日志器和Appender一行
+     */
+    std::string dumpStats();
+
+    /**
+     * @brief 每隔interval毫秒把统计以INFO级别写入logger，interval为0时停止
+     */
+    void setStatsDump(Logger::ptr logger, uint32_t interval);
+private:
+    typedef std::unordered_map<std::string, Logger::ptr> LoggerMap;
+
+    /**
+     * @brief 在写时复制的副本中查找或创建日志器
+     */
+    Logger::ptr create(LoggerMap& loggers, const std::string& name);
+
+    /**
+     * @brief 父日志器，不存在时创建
+     */
+    Logger::ptr createParent(LoggerMap& loggers, const std::string& name);
 private:
-    // 日志器的存储结构
-    std::map<std::string, Logger::ptr> m_loggers;
+    // 日志器的哈希表，读不加锁，写时复制
+    RcuPtr<LoggerMap> m_loggers;
     // 默认的日志器
     Logger::ptr m_root;
+    std::once_flag m_inited;
+
+    // 定期输出统计的线程
+    std::mutex m_statsMutex;
+    std::condition_variable m_statsCond;
+    std::thread m_statsThread;
+    Logger::ptr m_statsLogger;
+    uint32_t m_statsInterval = 0;
 };
 
 typedef Singleton<LoggerManager> LoggerMgrPtr;
@@ -0,0 +1,364 @@
+#include "log_compress.h"
+#include <zlib.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+namespace orange {
+
+namespace logz {
+
+static bool IsDigits(const char* p, size_t n) {
+    for(size_t i = 0; i < n; ++i) {
+        if(p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int ToInt(const char* p, size_t n) {
+    int v = 0;
+    for(size_t i = 0; i < n; ++i) {
+        v = v * 10 + (p[i] - '0');
+    }
+    return v;
+}
+
+uint64_t ParseTime(const char* line, size_t len) {
+    // 同一天的日志很多，缓存日期对应的零点时间，避免每行调用mktime
+    static thread_local char s_date[10] = {0};
+    static thread_local uint64_t s_midnight = 0;
+
+    // YYYY-mm-dd HH:MM:SS
+    const size_t n = 19;
+    for(size_t i = 0; i + n <= len; ++i) {
+        const char* p = line + i;
+        if(!(IsDigits(p, 4) && p[4] == '-' && IsDigits(p + 5, 2) && p[7] == '-'
+                && IsDigits(p + 8, 2) && p[10] == ' ' && IsDigits(p + 11, 2) && p[13] == ':'
+                && IsDigits(p + 14, 2) && p[16] == ':' && IsDigits(p + 17, 2))) {
+            continue;
+        }
+        if(memcmp(s_date, p, sizeof(s_date)) != 0) {
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            tm.tm_year = ToInt(p, 4) - 1900;
+            tm.tm_mon = ToInt(p + 5, 2) - 1;
+            tm.tm_mday = ToInt(p + 8, 2);
+            tm.tm_isdst = -1;
+            s_midnight = mktime(&tm);
+            memcpy(s_date, p, sizeof(s_date));
+        }
+        return s_midnight + ToInt(p + 11, 2) * 3600 + ToInt(p + 14, 2) * 60 + ToInt(p + 17, 2);
+    }
+    return 0;
+}
+
+}
+
+const char* LogCompressor::SUFFIX = ".olz";
+
+/**
+ * @brief 当前线程消耗的CPU时间(纳秒)
+ */
+static uint64_t GetThreadCpuNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+LogCompressor::LogCompressor(const Config& config)
+    : m_config(config) {
+    m_config.level = std::max(1, std::min(9, m_config.level));
+    m_config.cpu_percent = std::max(1u, std::min(100u, m_config.cpu_percent));
+    if(m_config.frame_size == 0) {
+        m_config.frame_size = Config().frame_size;
+    }
+    m_thread = std::thread(std::bind(&LogCompressor::run, this));
+}
+
+LogCompressor::LogCompressor()
+    : LogCompressor(Config()) {
+}
+
+LogCompressor::~LogCompressor() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cond.notify_one();
+    }
+    m_thread.join();
+}
+
+void LogCompressor::submit(const std::string& path) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_files.push_back(path);
+    m_cond.notify_one();
+}
+
+void LogCompressor::schedule() {
+    submit(std::string());
+}
+
+void LogCompressor::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!m_files.empty() || m_running) {
+        m_done.wait(lock);
+    }
+}
+
+bool LogCompressor::isPending(const std::string& path) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return !path.empty() && (path == m_current || std::find(m_files.begin(), m_files.end(), path) != m_files.end());
+}
+
+void LogCompressor::run() {
+    // 降低CPU和IO优先级，避免和业务争抢
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#ifdef SYS_ioprio_set
+    // IOPRIO_WHO_PROCESS, IOPRIO_CLASS_IDLE
+    syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+    while(true) {
+        std::string path;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while(m_files.empty() && !m_stopping) {
+                m_cond.wait(lock);
+            }
+            if(m_files.empty()) {
+                break;
+            }
+            path = m_files.front();
+            m_files.pop_front();
+            m_current = path;
+            ++m_running;
+        }
+        if(!path.empty()) {
+            compress(path, path + SUFFIX, true);
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_current.clear();
+        }
+        if(m_callback) {
+            m_callback();
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            --m_running;
+            m_done.notify_all();
+        }
+    }
+}
+
+void LogCompressor::throttle(uint64_t cpu_ns) {
+    if(m_config.cpu_percent >= 100) {
+        return;
+    }
+    uint64_t sleep_ns = cpu_ns * (100 - m_config.cpu_percent) / m_config.cpu_percent;
+    std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+}
+
+bool LogCompressor::compress(const std::string& path, const std::string& out, bool remove) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in) {
+        return false;
+    }
+    std::string tmp = out + ".tmp";
+    std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+    if(!os) {
+        return false;
+    }
+    os.write(logz::FILE_MAGIC, sizeof(logz::FILE_MAGIC));
+
+    std::vector<logz::FrameIndex> index;
+    std::string raw;
+    std::string comp;
+    std::vector<char> chunk(m_config.frame_size);
+    uint64_t offset = sizeof(logz::FILE_MAGIC);
+    uint64_t last_time = 0;
+    bool eof = false;
+    while(!eof || !raw.empty()) {
+        uint64_t cpu_begin = GetThreadCpuNS();
+        // 读满一帧
+        while(!eof && raw.size() < m_config.frame_size) {
+            in.read(&chunk[0], std::min(chunk.size(), m_config.frame_size - raw.size()));
+            raw.append(&chunk[0], in.gcount());
+            eof = !in;
+        }
+        if(raw.empty()) {
+            break;
+        }
+        // 帧在行尾切分，剩余部分留给下一帧
+        size_t len = raw.size();
+        if(!eof) {
+            size_t pos = raw.rfind('\n');
+            if(pos != std::string::npos) {
+                len = pos + 1;
+            }
+        }
+
+        logz::FrameHeader fh;
+        memset(&fh, 0, sizeof(fh));
+        fh.raw_len = len;
+        fh.crc = crc32(0, (const Bytef*)raw.c_str(), len);
+        for(size_t p = 0; p < len;) {
+            size_t e = raw.find('\n', p);
+            e = e == std::string::npos || e >= len ? len : e + 1;
+            uint64_t t = logz::ParseTime(raw.c_str() + p, e - p);
+            last_time = t ? t : last_time;
+            if(!fh.first_time) {
+                fh.first_time = last_time;
+            }
+            ++fh.lines;
+            p = e;
+        }
+        fh.last_time = last_time;
+
+        uLongf comp_len = compressBound(len);
+        comp.resize(comp_len);
+        if(::compress2((Bytef*)&comp[0], &comp_len, (const Bytef*)raw.c_str(), len, m_config.level) != Z_OK) {
+            os.close();
+            unlink(tmp.c_str());
+            return false;
+        }
+        fh.comp_len = comp_len;
+        os.write((const char*)&fh, sizeof(fh));
+        os.write(comp.c_str(), comp_len);
+
+        logz::FrameIndex fi;
+        fi.offset = offset;
+        fi.first_time = fh.first_time;
+        fi.last_time = fh.last_time;
+        index.push_back(fi);
+        offset += sizeof(fh) + comp_len;
+        raw.erase(0, len);
+
+        throttle(GetThreadCpuNS() - cpu_begin);
+    }
+
+    logz::Footer footer;
+    footer.index_offset = offset;
+    footer.frame_count = index.size();
+    memcpy(footer.magic, logz::FOOTER_MAGIC, sizeof(footer.magic));
+    if(!index.empty()) {
+        os.write((const char*)&index[0], index.size() * sizeof(logz::FrameIndex));
+    }
+    os.write((const char*)&footer, sizeof(footer));
+    os.close();
+    if(!os || rename(tmp.c_str(), out.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    if(remove) {
+        unlink(path.c_str());
+    }
+    return true;
+}
+
+bool LogzReader::open(const std::string& path) {
+    m_in.open(path, std::ios::binary);
+    if(!m_in) {
+        return false;
+    }
+    char magic[sizeof(logz::FILE_MAGIC)];
+    if(!m_in.read(magic, sizeof(magic)) || memcmp(magic, logz::FILE_MAGIC, sizeof(magic)) != 0) {
+        return false;
+    }
+
+    logz::Footer footer;
+    m_in.seekg(0, std::ios::end);
+    int64_t size = m_in.tellg();
+    if(size >= (int64_t)(sizeof(logz::FILE_MAGIC) + sizeof(footer))) {
+        m_in.seekg(size - sizeof(footer));
+        m_in.read((char*)&footer, sizeof(footer));
+        if(m_in && memcmp(footer.magic, logz::FOOTER_MAGIC, sizeof(footer.magic)) == 0
+                && footer.index_offset + footer.frame_count * sizeof(logz::FrameIndex) + sizeof(footer)
+                    == (uint64_t)size) {
+            m_frames.resize(footer.frame_count);
+            m_in.seekg(footer.index_offset);
+            if(footer.frame_count == 0
+                    || m_in.read((char*)&m_frames[0], footer.frame_count * sizeof(logz::FrameIndex))) {
+                return true;
+            }
+            m_frames.clear();
+        }
+    }
+    m_in.clear();
+    return scanFrames();
+}
+
+bool LogzReader::scanFrames() {
+    m_in.seekg(0, std::ios::end);
+    uint64_t size = m_in.tellg();
+    uint64_t offset = sizeof(logz::FILE_MAGIC);
+    while(offset + sizeof(logz::FrameHeader) <= size) {
+        logz::FrameHeader fh;
+        m_in.seekg(offset);
+        if(!m_in.read((char*)&fh, sizeof(fh))) {
+            break;
+        }
+        // 不完整的最后一帧
+        if(offset + sizeof(fh) + fh.comp_len > size) {
+            break;
+        }
+        logz::FrameIndex fi;
+        fi.offset = offset;
+        fi.first_time = fh.first_time;
+        fi.last_time = fh.last_time;
+        m_frames.push_back(fi);
+        offset += sizeof(fh) + fh.comp_len;
+    }
+    m_in.clear();
+    return true;
+}
+
+uint64_t LogzReader::read(uint64_t begin, uint64_t end, std::string& out) {
+    uint64_t count = 0;
+    std::string comp;
+    std::string raw;
+    for(auto& i : m_frames) {
+        if(i.last_time < begin || i.first_time > end) {
+            continue;
+        }
+        logz::FrameHeader fh;
+        m_in.seekg(i.offset);
+        if(!m_in.read((char*)&fh, sizeof(fh))) {
+            break;
+        }
+        comp.resize(fh.comp_len);
+        raw.resize(fh.raw_len);
+        if(!m_in.read(&comp[0], fh.comp_len)) {
+            break;
+        }
+        uLongf raw_len = fh.raw_len;
+        if(uncompress((Bytef*)&raw[0], &raw_len, (const Bytef*)comp.c_str(), fh.comp_len) != Z_OK
+                || raw_len != fh.raw_len
+                || crc32(0, (const Bytef*)raw.c_str(), raw_len) != fh.crc) {
+            break;
+        }
+        ++m_inflated;
+
+        uint64_t last_time = fh.first_time;
+        for(size_t p = 0; p < raw.size();) {
+            size_t e = raw.find('\n', p);
+            e = e == std::string::npos ? raw.size() : e + 1;
+            uint64_t t = logz::ParseTime(raw.c_str() + p, e - p);
+            last_time = t ? t : last_time;
+            if(last_time >= begin && last_time <= end) {
+                out.append(raw, p, e - p);
+                ++count;
+            }
+            p = e;
+        }
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,207 @@
+#ifndef __ORANGE_LOG_COMPRESS_H__
+#define __ORANGE_LOG_COMPRESS_H__
+
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace orange {
+
+namespace logz {
+
+/**
+ * @brief 压缩日志文件格式
+ * @details 文件头 | 帧头 + deflate数据 | ... | 帧索引 | 文件尾
+ *          每帧由若干完整的日志行组成，可以单独解压；帧头记录帧内日志的时间范围。
+ *          文件尾和索引用于按时间直接定位帧，缺失时(例如压缩中途退出)可以顺序扫描帧头
+ */
+static const char FILE_MAGIC[8] = {'O', 'R', 'G', 'L', 'O', 'G', 'Z', '1'};
+static const char FOOTER_MAGIC[8] = {'O', 'R', 'G', 'L', 'Z', 'E', 'N', 'D'};
+
+/**
+ * @brief 帧头
+ */
+struct FrameHeader {
+    // 解压后的长度
+    uint32_t raw_len;
+    // 压缩数据长度
+    uint32_t comp_len;
+    // 解压后数据的crc32
+    uint32_t crc;
+    // 日志行数
+    uint32_t lines;
+    // 帧内第一条和最后一条日志的时间(秒)
+    uint64_t first_time;
+    uint64_t last_time;
+};
+
+/**
+ * @brief 帧索引项
+ */
+struct FrameIndex {
+    // 帧头在文件中的位置
+    uint64_t offset;
+    uint64_t first_time;
+    uint64_t last_time;
+};
+
+/**
+ * @brief 文件尾
+ */
+struct Footer {
+    uint64_t index_offset;
+    uint64_t frame_count;
+    char magic[8];
+};
+
+/**
+ * @brief 从日志行中解析 %Y-%m-%d %H:%M:%S 格式的本地时间
+ * @return 没有找到返回0
+ */
+uint64_t ParseTime(const char* line, size_t len);
+
+}
+
+/**
+ * @brief 日志压缩器
+ * @details 在低优先级的后台线程中把已经封存的日志文件压缩成分帧格式，
+ *          压缩完成后删除原文件。写日志的线程只负责提交文件名
+ */
+class LogCompressor {
+public:
+    typedef std::shared_ptr<LogCompressor> ptr;
+    typedef std::function<void()> Callback;
+
+    /**
+     * @brief 压缩配置
+     */
+    struct Config {
+        // zlib压缩级别 1-9
+        int level = 1;
+        // 每帧解压后的大小(字节)
+        size_t frame_size = 1024 * 1024;
+        // 允许占用单核CPU的百分比 1-100
+        uint32_t cpu_percent = 10;
+
+        bool operator==(const Config& oth) const {
+            return level == oth.level
+                && frame_size == oth.frame_size
+                && cpu_percent == oth.cpu_percent;
+        }
+    };
+
+    /**
+     * @brief 压缩后文件的后缀
+     */
+    static const char* SUFFIX;
+
+    LogCompressor(const Config& config);
+    LogCompressor();
+
+    /**
+     * @brief 压缩完已提交的文件后停止后台线程
+     */
+    ~LogCompressor();
+
+    /**
+     * @brief 提交一个待压缩的文件，压缩成 path + SUFFIX
+     */
+    void submit(const std::string& path);
+
+    /**
+     * @brief 不压缩文件，只在后台线程调用一次回调
+     */
+    void schedule();
+
+    /**
+     * @brief 等待已提交的文件全部压缩完成
+     */
+    void wait();
+
+    /**
+     * @brief 设置每个文件处理完之后在后台线程中调用的回调，例如清理历史文件
+     * @details 需要在提交文件之前设置
+     */
+    void setCallback(const Callback& cb) { m_callback = cb; }
+
+    /**
+     * @brief path是否已提交但还没有压缩完成
+     */
+    bool isPending(const std::string& path);
+
+    /**
+     * @brief 在当前线程压缩一个文件
+     * @param[in] remove 成功后是否删除原文件
+     */
+    bool compress(const std::string& path, const std::string& out, bool remove);
+
+    const Config& getConfig() const { return m_config; }
+private:
+    /**
+     * @brief 后台线程
+     */
+    void run();
+
+    /**
+     * @brief 按CPU预算休眠
+     * @param[in] cpu_ns 刚才的工作消耗的CPU时间(纳秒)
+     */
+    void throttle(uint64_t cpu_ns);
+private:
+    Config m_config;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    // 等待任务完成
+    std::condition_variable m_done;
+    std::deque<std::string> m_files;
+    // 正在压缩的文件
+    std::string m_current;
+    // 正在压缩的任务数
+    uint32_t m_running = 0;
+    Callback m_callback;
+    bool m_stopping = false;
+    std::thread m_thread;
+};
+
+/**
+ * @brief 压缩日志读取器
+ * @details 根据帧索引只解压和时间范围有交集的帧
+ */
+class LogzReader {
+public:
+    bool open(const std::string& path);
+
+    size_t getFrameCount() const { return m_frames.size(); }
+
+    /**
+     * @brief 读取时间在[begin, end]内的日志行
+     * @details 没有时间的行视为与上一行同一时间
+     * @return 读取的行数
+     */
+    uint64_t read(uint64_t begin, uint64_t end, std::string& out);
+
+    /**
+     * @brief 解压的帧数，用于确认没有解压整个文件
+     */
+    uint64_t getInflated() const { return m_inflated; }
+private:
+    /**
+     * @brief 没有文件尾时顺序扫描帧头建立索引
+     */
+    bool scanFrames();
+private:
+    std::ifstream m_in;
+    std::vector<logz::FrameIndex> m_frames;
+    uint64_t m_inflated = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include "log_crash.h"
+#include "log.h"
+#include "util.h"
+#include <atomic>
+#include <mutex>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <execinfo.h>
+
+namespace orange {
+
+static std::atomic<LogAppender*> s_appenders[LogCrashHandler::MAX_APPENDERS];
+static std::mutex s_mutex;
+static std::once_flag s_installOnce;
+static std::atomic<bool> s_installed{false};
+static std::atomic<bool> s_crashing{false};
+// 安装时缓存的本地时区偏移(秒)，信号处理函数中不能调用localtime_r
+static long s_gmtoff = 0;
+
+static const int CRASH_SIGNALS[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+
+static const char* SignalName(int sig) {
+    switch(sig) {
+#define XX(name) \
+    case name: \
+        return #name
+
+    XX(SIGSEGV);
+    XX(SIGABRT);
+    XX(SIGBUS);
+    XX(SIGFPE);
+    XX(SIGILL);
+#undef XX
+    default:
+        return "UNKNOWN";
+    }
+}
+
+/**
+ * @brief 在栈上拼接崩溃记录，不分配内存
+ */
+class CrashBuffer {
+public:
+    void append(const char* str) {
+        while(*str && m_len < sizeof(m_data)) {
+            m_data[m_len++] = *str++;
+        }
+    }
+
+    void appendDec(uint64_t v, int width = 0) {
+        char tmp[24];
+        int n = 0;
+        do {
+            tmp[n++] = '0' + v % 10;
+            v /= 10;
+        } while(v);
+        while(n < width) {
+            tmp[n++] = '0';
+        }
+        appendReverse(tmp, n);
+    }
+
+    void appendHex(uint64_t v) {
+        static const char* s_hex = "0123456789abcdef";
+        char tmp[16];
+        int n = 0;
+        do {
+            tmp[n++] = s_hex[v & 0xf];
+            v >>= 4;
+        } while(v);
+        append("0x");
+        appendReverse(tmp, n);
+    }
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_len; }
+private:
+    void appendReverse(const char* tmp, int n) {
+        while(n > 0 && m_len < sizeof(m_data)) {
+            m_data[m_len++] = tmp[--n];
+        }
+    }
+private:
+    char m_data[512];
+    size_t m_len = 0;
+};
+
+/**
+ * @brief 从1970-01-01起的天数换算成年月日
+ */
+static void CivilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+}
+
+/**
+ * @brief 按默认格式的前几列拼接崩溃记录
+ */
+static void FormatCrashRecord(CrashBuffer& buf, int sig, siginfo_t* info) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t sec = ts.tv_sec + s_gmtoff;
+    int64_t days = sec >= 0 ? sec / 86400 : (sec - 86399) / 86400;
+    int64_t rem = sec - days * 86400;
+    int64_t year;
+    unsigned month, day;
+    CivilFromDays(days, year, month, day);
+
+    buf.appendDec(year, 4);
+    buf.append("-");
+    buf.appendDec(month, 2);
+    buf.append("-");
+    buf.appendDec(day, 2);
+    buf.append(" ");
+    buf.appendDec(rem / 3600, 2);
+    buf.append(":");
+    buf.appendDec(rem / 60 % 60, 2);
+    buf.append(":");
+    buf.appendDec(rem % 60, 2);
+    buf.append("\t");
+    buf.appendDec(GetThreadId());
+    buf.append("\t0\t[FATAL]\t[crash]\tcaught signal ");
+    buf.append(SignalName(sig));
+    buf.append("(");
+    buf.appendDec(sig);
+    buf.append(")");
+    if(sig == SIGSEGV || sig == SIGBUS || sig == SIGFPE || sig == SIGILL) {
+        buf.append(" at ");
+        buf.appendHex((uintptr_t)info->si_addr);
+    }
+    buf.append(", backtrace:\n");
+}
+
+static void CrashSignalHandler(int sig, siginfo_t* info, void* context) {
+    if(s_crashing.exchange(true)) {
+        // 其他线程正在处理，等它结束进程
+        while(true) {
+            pause();
+        }
+    }
+
+    int fds[LogCrashHandler::MAX_APPENDERS + 1];
+    int nfds = 0;
+    for(int i = 0; i < LogCrashHandler::MAX_APPENDERS; ++i) {
+        LogAppender* appender = s_appenders[i].load(std::memory_order_acquire);
+        if(!appender) {
+            continue;
+        }
+        int fd = appender->crashDrain();
+        bool dup = fd < 0;
+        for(int j = 0; j < nfds && !dup; ++j) {
+            dup = fds[j] == fd;
+        }
+        if(!dup) {
+            fds[nfds++] = fd;
+        }
+    }
+    fds[nfds++] = STDERR_FILENO;
+
+    CrashBuffer buf;
+    FormatCrashRecord(buf, sig, info);
+    void* frames[64];
+    int depth = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+    for(int i = 0; i < nfds; ++i) {
+        WriteAll(fds[i], buf.data(), buf.size());
+        backtrace_symbols_fd(frames, depth, fds[i]);
+    }
+
+    // 恢复默认处理，返回后重新触发，按原来的方式产生core
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void LogCrashHandler::Install() {
+    std::call_once(s_installOnce, []() {
+        // backtrace第一次调用会加载libgcc，提前调用避免在信号处理函数中分配内存
+        void* frames[1];
+        backtrace(frames, 1);
+
+        tzset();
+        time_t now = time(0);
+        struct tm tm;
+        localtime_r(&now, &tm);
+        s_gmtoff = tm.tm_gmtoff;
+
+        // 其他线程在下一次产生日志事件时设置
+        ThreadContext::GetThis().installAltStack(ALTSTACK_SIZE);
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = CrashSignalHandler;
+        sa.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&sa.sa_mask);
+        for(int sig : CRASH_SIGNALS) {
+            sigaction(sig, &sa, nullptr);
+        }
+        s_installed = true;
+    });
+}
+
+bool LogCrashHandler::IsInstalled() {
+    return s_installed.load(std::memory_order_relaxed);
+}
+
+void LogCrashHandler::Register(LogAppender* appender) {
+    std::unique_lock<std::mutex> lock(s_mutex);
+    for(auto& i : s_appenders) {
+        if(!i.load(std::memory_order_relaxed)) {
+            i.store(appender, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+void LogCrashHandler::Unregister(LogAppender* appender) {
+    std::unique_lock<std::mutex> lock(s_mutex);
+    for(auto& i : s_appenders) {
+        if(i.load(std::memory_order_relaxed) == appender) {
+            i.store(nullptr, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+std::string LogCrashHandler::Backtrace(int skip) {
+    void* frames[64];
+    int depth = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+    std::string str;
+    char** symbols = backtrace_symbols(frames, depth);
+    for(int i = skip + 1; i < depth; ++i) {
+        str.append("    ");
+        if(symbols) {
+            str.append(symbols[i]);
+        }
+        str.push_back('\n');
+    }
+    free(symbols);
+    return str;
+}
+
+void LogCrashHandler::FlushAll() {
+    // 持有锁期间Appender不会被析构
+    std::unique_lock<std::mutex> lock(s_mutex);
+    for(auto& i : s_appenders) {
+        LogAppender* appender = i.load(std::memory_order_relaxed);
+        if(appender) {
+            appender->flush();
+        }
+    }
+}
+
+}
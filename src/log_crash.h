@@ -0,0 +1,65 @@
+#ifndef __ORANGE_LOG_CRASH_H__
+#define __ORANGE_LOG_CRASH_H__
+
+#include <stddef.h>
+#include <string>
+
+namespace orange {
+
+class LogAppender;
+
+/**
+ * @brief 致命信号的日志处理
+ * @details 文件类Appender构造时登记到固定大小的表中。收到SIGSEGV、SIGABRT、SIGBUS、
+ *          SIGFPE、SIGILL时，处理函数不加锁地把各Appender缓冲区和异步写入器中积压的数据
+ *          直接write到文件，再写一条带调用栈的崩溃记录，最后恢复默认处理并重新触发信号。
+ *          整个过程只使用write、backtrace_symbols_fd这类异步信号安全的调用，
+ *          崩溃时正在被其他线程修改的缓冲区可能写出不完整的一条。
+ *          栈溢出时处理函数需要在备用栈上运行：调用 Install() 的线程在安装时设置，
+ *          其他线程在安装之后第一次产生日志事件时由 ThreadContext 设置。
+ *          安装之后从未打过日志的线程栈溢出时不会写出崩溃记录，只按默认方式结束进程
+ */
+class LogCrashHandler {
+public:
+    /**
+     * @brief 最多登记的Appender个数，超出的崩溃时不写出
+     */
+    static const int MAX_APPENDERS = 256;
+
+    /**
+     * @brief 每个线程备用栈的大小(字节)
+     */
+    static const size_t ALTSTACK_SIZE = 64 * 1024;
+
+    /**
+     * @brief 安装信号处理函数，多次调用只生效一次
+     */
+    static void Install();
+
+    static bool IsInstalled();
+
+    /**
+     * @brief 登记Appender，在构造函数中调用
+     */
+    static void Register(LogAppender* appender);
+
+    /**
+     * @brief 取消登记，必须在析构函数释放缓冲区之前调用
+     */
+    static void Unregister(LogAppender* appender);
+
+    /**
+     * @brief 在正常上下文中刷新所有登记的Appender，用于FATAL日志，不要求已经安装
+     */
+    static void FlushAll();
+
+    /**
+     * @brief 当前线程的调用栈，每帧一行，在正常上下文中使用
+     * @param[in] skip 跳过最内层的帧数，不包括本函数
+     */
+    static std::string Backtrace(int skip = 0);
+};
+
+}
+
+#endif
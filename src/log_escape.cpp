@@ -0,0 +1,180 @@
+#include "log_escape.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace orange {
+
+static inline bool IsJsonEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+static inline bool IsLogfmtQuote(unsigned char c) {
+    return c <= 0x20 || c == '"' || c == '=' || c == '\\';
+}
+
+template<bool LOGFMT>
+static size_t FindScalar(const char* data, size_t pos, size_t len) {
+    for(; pos < len; ++pos) {
+        unsigned char c = data[pos];
+        if(LOGFMT ? IsLogfmtQuote(c) : IsJsonEscape(c)) {
+            return pos;
+        }
+    }
+    return len;
+}
+
+#if defined(__x86_64__)
+/**
+ * @brief SSE2是x86-64的基础指令集，不需要检测
+ */
+template<bool LOGFMT>
+static size_t FindSSE2(const char* data, size_t pos, size_t len) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i eq = _mm_set1_epi8('=');
+    // 无符号比较 min(v, ctrl) == v 即 v <= ctrl
+    const __m128i ctrl = _mm_set1_epi8(LOGFMT ? 0x20 : 0x1f);
+    for(; pos + 16 <= len; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + pos));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+        if(LOGFMT) {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, eq));
+        }
+        int mask = _mm_movemask_epi8(m);
+        if(mask) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return FindScalar<LOGFMT>(data, pos, len);
+}
+
+template<bool LOGFMT>
+__attribute__((target("avx2")))
+static size_t FindAVX2(const char* data, size_t pos, size_t len) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i eq = _mm256_set1_epi8('=');
+    const __m256i ctrl = _mm256_set1_epi8(LOGFMT ? 0x20 : 0x1f);
+    for(; pos + 32 <= len; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + pos));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v));
+        if(LOGFMT) {
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, eq));
+        }
+        unsigned mask = _mm256_movemask_epi8(m);
+        if(mask) {
+            _mm256_zeroupper();
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    // 切换回SSE指令前清空高位，避免状态切换的开销
+    _mm256_zeroupper();
+    return FindSSE2<LOGFMT>(data, pos, len);
+}
+#endif
+
+typedef size_t (*FindFunc)(const char* data, size_t pos, size_t len);
+
+template<bool LOGFMT>
+static FindFunc SelectFind() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return &FindAVX2<LOGFMT>;
+    }
+    return &FindSSE2<LOGFMT>;
+#else
+    return &FindScalar<LOGFMT>;
+#endif
+}
+
+template<bool LOGFMT>
+static inline size_t Find(const char* data, size_t len) {
+#if defined(__x86_64__)
+    // 日志名称、文件名这类短串不值得切换到AVX2
+    if(len < 64) {
+        return FindSSE2<LOGFMT>(data, 0, len);
+    }
+#endif
+    static const FindFunc s_find = SelectFind<LOGFMT>();
+    return s_find(data, 0, len);
+}
+
+size_t FindJsonEscape(const char* data, size_t len) {
+    return Find<false>(data, len);
+}
+
+size_t FindLogfmtQuote(const char* data, size_t len) {
+    return Find<true>(data, len);
+}
+
+void AppendJsonEscaped(std::string& buf, const char* data, size_t len) {
+    static const char* s_hex = "0123456789abcdef";
+    size_t pos = 0;
+    while(pos < len) {
+        size_t e = pos + Find<false>(data + pos, len - pos);
+        buf.append(data + pos, e - pos);
+        if(e == len) {
+            break;
+        }
+        unsigned char c = data[e];
+        switch(c) {
+            case '"':
+                buf.append("\\\"", 2);
+                break;
+            case '\\':
+                buf.append("\\\\", 2);
+                break;
+            case '\n':
+                buf.append("\\n", 2);
+                break;
+            case '\r':
+                buf.append("\\r", 2);
+                break;
+            case '\t':
+                buf.append("\\t", 2);
+                break;
+            case '\b':
+                buf.append("\\b", 2);
+                break;
+            case '\f':
+                buf.append("\\f", 2);
+                break;
+            default: {
+                char tmp[6] = {'\\', 'u', '0', '0', s_hex[c >> 4], s_hex[c & 0xf]};
+                buf.append(tmp, sizeof(tmp));
+                break;
+            }
+        }
+        pos = e + 1;
+    }
+}
+
+void AppendLogfmtValue(std::string& buf, const char* data, size_t len) {
+    if(len > 0 && Find<true>(data, len) == len) {
+        buf.append(data, len);
+        return;
+    }
+    buf.push_back('"');
+    AppendJsonEscaped(buf, data, len);
+    buf.push_back('"');
+}
+
+void AppendLogfmtKey(std::string& buf, const char* data, size_t len) {
+    if(len > 0 && Find<true>(data, len) == len) {
+        buf.append(data, len);
+        return;
+    }
+    if(len == 0) {
+        buf.push_back('_');
+        return;
+    }
+    for(size_t i = 0; i < len; ++i) {
+        buf.push_back(IsLogfmtQuote(data[i]) ? '_' : data[i]);
+    }
+}
+
+}
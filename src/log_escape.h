@@ -0,0 +1,40 @@
+#ifndef __ORANGE_LOG_ESCAPE_H__
+#define __ORANGE_LOG_ESCAPE_H__
+
+#include <stddef.h>
+#include <string>
+
+namespace orange {
+
+/**
+ * @brief 查找第一个JSON字符串中需要转义的字节('"'、'\\'和控制字符)
+ * @details x86-64上按CPU支持选择AVX2或SSE2，每次检查32/16字节
+ * @return 字节的下标，没有时返回len
+ */
+size_t FindJsonEscape(const char* data, size_t len);
+
+/**
+ * @brief 查找第一个使logfmt的值需要加引号的字节(空白、控制字符、'"'、'='、'\\')
+ * @return 字节的下标，没有时返回len
+ */
+size_t FindLogfmtQuote(const char* data, size_t len);
+
+/**
+ * @brief 按JSON字符串的规则转义后追加到buf，不包括两端的引号
+ * @details 非ASCII字节原样输出，要求输入是UTF-8
+ */
+void AppendJsonEscaped(std::string& buf, const char* data, size_t len);
+
+/**
+ * @brief 追加logfmt的值，含有空白、'='等字节或为空时加引号并转义
+ */
+void AppendLogfmtValue(std::string& buf, const char* data, size_t len);
+
+/**
+ * @brief 追加logfmt的键，键不能加引号，空白、控制字符、'"'、'='和'\\'替换为'_'，空键输出'_'
+ */
+void AppendLogfmtKey(std::string& buf, const char* data, size_t len);
+
+}
+
+#endif
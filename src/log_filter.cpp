@@ -0,0 +1,194 @@
+#include "log_filter.h"
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <fnmatch.h>
+
+namespace orange {
+
+// 过滤器id生成器
+static std::atomic<uint64_t> s_filter_id(0);
+
+const size_t LogFilter::MAX_RULES;
+
+LogFilterRule::Action LogFilterRule::FromString(const std::string& str) {
+    std::string v = str;
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    if(v == "deny") {
+        return DENY;
+    }
+    return ACCEPT;
+}
+
+const char* LogFilterRule::ToString(Action action) {
+    return action == DENY ? "deny" : "accept";
+}
+
+LogFilter::LogFilter(const std::vector<LogFilterRule>& rules)
+    : m_rules(rules.begin(), rules.begin() + std::min(rules.size(), MAX_RULES))
+    , m_id(++s_filter_id) {
+    for(size_t i = 0; i < m_rules.size(); ++i) {
+        const LogFilterRule& rule = m_rules[i];
+        for(int level = LogLevel::UNKNOWN; level <= LogLevel::FATAL; ++level) {
+            if((rule.level == LogLevel::UNKNOWN || level >= rule.level)
+                    && (rule.max_level == LogLevel::UNKNOWN || level <= rule.max_level)) {
+                m_levelMask[level] |= 1u << i;
+            }
+        }
+        if(!rule.file.empty()) {
+            m_fileRules |= 1u << i;
+        }
+    }
+}
+
+/**
+ * @brief name是否是prefix或者它的子日志器
+ */
+static bool MatchLogger(const std::string& prefix, const std::string& name) {
+    return name.size() >= prefix.size()
+        && name.compare(0, prefix.size(), prefix) == 0
+        && (name.size() == prefix.size() || name[prefix.size()] == '.');
+}
+
+static bool MatchMDC(const std::vector<std::pair<std::string, std::string> >& mdc,
+                     const ThreadContext* context, size_t depth) {
+    if(!context) {
+        return false;
+    }
+    for(auto& i : mdc) {
+        const std::string* value = context->find(i.first.c_str(), i.first.size(), depth);
+        if(!value || (i.second != "*" && *value != i.second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LogFilter::Result LogFilter::match(uint32_t candidates, const std::string& logger, const char* file,
+                                   const ThreadContext* context, size_t depth, const LogStringRef* message) const {
+    uint32_t files = 0;
+    bool files_loaded = false;
+    for(; candidates; candidates &= candidates - 1) {
+        int i = __builtin_ctz(candidates);
+        const LogFilterRule& rule = m_rules[i];
+        if(!rule.logger.empty() && !MatchLogger(rule.logger, logger)) {
+            continue;
+        }
+        if(!rule.mdc.empty() && !MatchMDC(rule.mdc, context, depth)) {
+            continue;
+        }
+        if(!rule.file.empty()) {
+            if(!files_loaded) {
+                files = fileMask(file);
+                files_loaded = true;
+            }
+            if(!(files & (1u << i))) {
+                continue;
+            }
+        }
+        if(!rule.message.empty()) {
+            // 后面的规则要等这一条有结果才能决定
+            if(!message) {
+                return DEFER;
+            }
+            if(!memmem(message->data(), message->size(), rule.message.data(), rule.message.size())) {
+                continue;
+            }
+        }
+        return (Result)rule.action;
+    }
+    return NEUTRAL;
+}
+
+int LogFilter::resolve(const std::string& logger, LogLevel::Level level, bool& exact) const {
+    int min_level = LogLevel::FATAL + 1;
+    exact = true;
+    for(int lv = LogLevel::DEBUG; lv <= LogLevel::FATAL; ++lv) {
+        // 没有规则匹配时按级别决定
+        int result = lv >= level ? ACCEPT : DENY;
+        bool dynamic = false;
+        for(uint32_t mask = m_levelMask[lv]; mask; mask &= mask - 1) {
+            const LogFilterRule& rule = m_rules[__builtin_ctz(mask)];
+            if(!rule.logger.empty() && !MatchLogger(rule.logger, logger)) {
+                continue;
+            }
+            if(rule.mdc.empty() && rule.file.empty() && rule.message.empty()) {
+                result = rule.action;
+                break;
+            }
+            // 有其他条件的规则要逐条判断，带条件的DENY不匹配时由后面的规则决定
+            dynamic = true;
+            if(rule.action == LogFilterRule::ACCEPT) {
+                result = ACCEPT;
+                break;
+            }
+        }
+        if(result == DENY) {
+            // 放行级别以上有不可能输出的级别，不能只按级别判断
+            if(min_level <= LogLevel::FATAL) {
+                exact = false;
+            }
+            continue;
+        }
+        if(dynamic) {
+            exact = false;
+        }
+        min_level = std::min(min_level, lv);
+    }
+    return min_level;
+}
+
+uint32_t LogFilter::fileMask(const char* file) const {
+    if(!file) {
+        return 0;
+    }
+    /**
+     * @brief 源文件匹配结果的缓存，直接映射，冲突时覆盖
+     * @details __FILE__是字符串常量，地址不变，可以作为键
+     */
+    struct Entry {
+        uint64_t id;
+        const char* file;
+        uint32_t mask;
+    };
+    static const size_t CACHE_SIZE = 64;
+    static thread_local Entry s_cache[CACHE_SIZE];
+
+    Entry& entry = s_cache[(((uintptr_t)file >> 3) ^ (m_id * 0x9e3779b97f4a7c15ull >> 58)) % CACHE_SIZE];
+    if(entry.id == m_id && entry.file == file) {
+        return entry.mask;
+    }
+    uint32_t mask = 0;
+    for(uint32_t rules = m_fileRules; rules; rules &= rules - 1) {
+        int i = __builtin_ctz(rules);
+        if(fnmatch(m_rules[i].file.c_str(), file, 0) == 0) {
+            mask |= 1u << i;
+        }
+    }
+    entry.id = m_id;
+    entry.file = file;
+    entry.mask = mask;
+    return mask;
+}
+
+LogFilter::Result LogFilter::decide(LogLevel::Level level, const std::string& logger, const char* file) const {
+    uint32_t candidates = m_levelMask[std::min(level, LogLevel::FATAL)];
+    if(!candidates) {
+        return NEUTRAL;
+    }
+    const ThreadContext& context = ThreadContext::GetThis();
+    return match(candidates, logger, file, &context, context.size(), nullptr);
+}
+
+LogFilter::Result LogFilter::decide(LogLevel::Level level, const LogEvent& event) const {
+    uint32_t candidates = m_levelMask[std::min(level, LogLevel::FATAL)];
+    if(!candidates) {
+        return NEUTRAL;
+    }
+    static const std::string s_empty;
+    LogStringRef message = event.getMessage();
+    return match(candidates, event.getLogger() ? event.getLogger()->getName() : s_empty, event.getFile(),
+                 event.getThreadContext(), event.getMDCDepth(), &message);
+}
+
+}
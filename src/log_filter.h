@@ -0,0 +1,129 @@
+#ifndef __ORANGE_LOG_FILTER_H__
+#define __ORANGE_LOG_FILTER_H__
+
+#include "log.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace orange {
+
+/**
+ * @brief 过滤规则，所有设置了的条件都满足时规则匹配
+ */
+struct LogFilterRule {
+    enum Action {
+        ACCEPT = 1,
+        DENY = 2
+    };
+
+    // 匹配时的动作
+    Action action = ACCEPT;
+    // 级别范围[level, max_level]，UNKNOWN表示不限
+    LogLevel::Level level = LogLevel::UNKNOWN;
+    LogLevel::Level max_level = LogLevel::UNKNOWN;
+    // 日志器名称前缀，按'.'分段匹配，net匹配net和net.http，不匹配network
+    std::string logger;
+    // 源文件的通配符，fnmatch规则，'*'可以匹配'/'
+    std::string file;
+    // MDC中的键值都要存在且相等，值为"*"时只要求键存在
+    std::vector<std::pair<std::string, std::string> > mdc;
+    // 消息内容包含的子串
+    std::string message;
+
+    bool operator==(const LogFilterRule& oth) const {
+        return action == oth.action
+            && level == oth.level
+            && max_level == oth.max_level
+            && logger == oth.logger
+            && file == oth.file
+            && mdc == oth.mdc
+            && message == oth.message;
+    }
+
+    /**
+     * @brief 不区分大小写，不认识的字符串返回ACCEPT，需要校验时和 ToString() 的结果比较
+     */
+    static Action FromString(const std::string& str);
+    static const char* ToString(Action action);
+};
+
+/**
+ * @brief 编译好的过滤规则表
+ * @details 规则按顺序检查，第一条匹配的规则决定结果，都不匹配时为NEUTRAL，由级别决定。
+ *          构造时按级别预先算出每个级别可能匹配的规则集合，判断时先用位运算排除，
+ *          剩下的规则内按代价从低到高检查：日志器名称、MDC、源文件、消息内容。
+ *          日志器按 resolve() 的结果缓存自己的放行级别，只由级别和日志器名称决定结果时不再逐条判断。
+ *          源文件的匹配结果按(过滤器, __FILE__地址)缓存在线程局部的表中。
+ *          构造之后只读，可以多线程同时使用
+ */
+class LogFilter {
+public:
+    typedef std::shared_ptr<LogFilter> ptr;
+
+    /**
+     * @brief 判断结果
+     */
+    enum Result {
+        // 没有规则匹配，按级别决定
+        NEUTRAL = 0,
+        ACCEPT = LogFilterRule::ACCEPT,
+        DENY = LogFilterRule::DENY,
+        // 需要消息内容才能判断，只在构造LogEvent之前出现
+        DEFER
+    };
+
+    // 最多的规则条数
+    static const size_t MAX_RULES = 32;
+
+    /**
+     * @brief 编译规则，超过MAX_RULES的部分被忽略
+     */
+    LogFilter(const std::vector<LogFilterRule>& rules);
+
+    /**
+     * @brief 在构造LogEvent之前判断，使用当前线程的MDC
+     * @details 遇到需要消息内容的规则时返回DEFER
+     */
+    Result decide(LogLevel::Level level, const std::string& logger, const char* file) const;
+
+    /**
+     * @brief 判断一条完整的日志
+     */
+    Result decide(LogLevel::Level level, const LogEvent& event) const;
+
+    /**
+     * @brief 只用级别和日志器名称条件预先判断logger的日志
+     * @param[in] level 日志器的级别
+     * @param[out] exact 结果是否只由级别决定，为false时需要逐条调用 decide()
+     * @return 可能输出的最低级别，都不可能输出时为FATAL + 1
+     */
+    int resolve(const std::string& logger, LogLevel::Level level, bool& exact) const;
+
+    const std::vector<LogFilterRule>& getRules() const { return m_rules; }
+private:
+    /**
+     * @brief 按顺序检查candidates中的规则
+     * @param[in] message 为nullptr时遇到消息条件返回DEFER
+     */
+    Result match(uint32_t candidates, const std::string& logger, const char* file,
+                 const ThreadContext* context, size_t depth, const LogStringRef* message) const;
+
+    /**
+     * @brief 源文件条件满足的规则集合，查线程局部的缓存
+     */
+    uint32_t fileMask(const char* file) const;
+private:
+    std::vector<LogFilterRule> m_rules;
+    // 每个级别可能匹配的规则集合
+    uint32_t m_levelMask[LogLevel::FATAL + 1] = {0};
+    // 有源文件条件的规则集合
+    uint32_t m_fileRules = 0;
+    // 唯一id，源文件缓存的键
+    uint64_t m_id;
+};
+
+}
+
+#endif
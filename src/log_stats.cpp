@@ -0,0 +1,161 @@
+#include "log_stats.h"
+#include "util.h"
+#include <sstream>
+#include <new>
+#include <stdlib.h>
+
+namespace orange {
+
+namespace detail {
+__thread uint32_t t_stats_stripe __attribute__((tls_model("initial-exec"))) = 0;
+}
+
+const uint32_t LogStats::SHARED;
+
+// 独占条带是否被线程占用，最后一个条带共用，不在这里
+static std::atomic<bool> s_stripe_used[LogStats::STRIPES - 1];
+
+/**
+ * @brief 线程退出时归还独占条带
+ */
+struct StripeHolder {
+    ~StripeHolder() {
+        uint32_t stripe = detail::t_stats_stripe;
+        if(stripe && !(stripe & LogStats::SHARED)) {
+            // release: 本线程对条带的写入先于下一个占用者的读取
+            s_stripe_used[stripe - 1].store(false, std::memory_order_release);
+        }
+        // 之后析构的线程局部对象里还可能打日志，改用共用条带，不再占用独占条带
+        detail::t_stats_stripe = LogStats::STRIPES | LogStats::SHARED;
+    }
+};
+
+uint32_t LogStats::AssignStripe() {
+    static thread_local StripeHolder s_holder;
+    (void)s_holder;
+    uint32_t stripe = STRIPES | SHARED;
+    for(int i = 0; i < STRIPES - 1; ++i) {
+        bool expected = false;
+        if(!s_stripe_used[i].load(std::memory_order_relaxed)
+                && s_stripe_used[i].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            stripe = i + 1;
+            break;
+        }
+    }
+    detail::t_stats_stripe = stripe;
+    return stripe;
+}
+
+bool LogStats::SampleTiming() {
+    static thread_local uint32_t s_tick = 0;
+    return ++s_tick % TIMING_SAMPLE == 0;
+}
+
+LogStats::LogStats() {
+    void* p = nullptr;
+    if(posix_memalign(&p, alignof(Stripe), sizeof(Stripe) * STRIPES) != 0) {
+        throw std::bad_alloc();
+    }
+    m_stripes = (Stripe*)p;
+    for(int i = 0; i < STRIPES; ++i) {
+        new(&m_stripes[i]) Stripe();
+    }
+}
+
+LogStats::~LogStats() {
+    free(m_stripes);
+    delete[] m_timers.load(std::memory_order_relaxed);
+}
+
+void LogStats::record(Timer timer, uint64_t ns) {
+    TimerStripe* timers = m_timers.load(std::memory_order_acquire);
+    if(!timers) {
+        TimerStripe* created = new TimerStripe[STRIPES]();
+        if(m_timers.compare_exchange_strong(timers, created, std::memory_order_acq_rel)) {
+            timers = created;
+        } else {
+            delete[] created;
+        }
+    }
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    if(bucket >= BUCKETS) {
+        bucket = BUCKETS - 1;
+    }
+    TimerStripe& stripe = timers[StripeIndex() & ~SHARED];
+    stripe.buckets[timer][bucket].fetch_add(1, std::memory_order_relaxed);
+    stripe.sum[timer].fetch_add(ns, std::memory_order_relaxed);
+}
+
+LogStats::Snapshot LogStats::snapshot() const {
+    Snapshot snap;
+    for(int s = 0; s < STRIPES; ++s) {
+        for(int i = 0; i < COUNTER_MAX; ++i) {
+            snap.counters[i] += m_stripes[s].counters[i].load(std::memory_order_relaxed);
+        }
+    }
+    const TimerStripe* timers = m_timers.load(std::memory_order_acquire);
+    if(timers) {
+        for(int s = 0; s < STRIPES; ++s) {
+            for(int t = 0; t < TIMER_MAX; ++t) {
+                Histogram& h = snap.timers[t];
+                for(int b = 0; b < BUCKETS; ++b) {
+                    uint64_t n = timers[s].buckets[t][b].load(std::memory_order_relaxed);
+                    h.buckets[b] += n;
+                    h.count += n;
+                }
+                h.sum += timers[s].sum[t].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return snap;
+}
+
+uint64_t LogStats::Histogram::percentile(double p) const {
+    if(!count) {
+        return 0;
+    }
+    uint64_t target = p * count;
+    uint64_t seen = 0;
+    for(int b = 0; b < BUCKETS; ++b) {
+        seen += buckets[b];
+        if(seen > target) {
+            return 2ull << b;
+        }
+    }
+    return 2ull << (BUCKETS - 1);
+}
+
+std::string LogStats::Snapshot::toString() const {
+    std::stringstream ss;
+    ss << "accepted=" << accepted()
+       << " filtered=" << filtered()
+       << " dropped=" << dropped()
+       << " bytes=" << bytes()
+       << " queue_high_water=" << queue_high_water;
+#define XX(name, timer) \
+    if(timers[timer].count) { \
+        ss << " " #name "_mean=" << timers[timer].mean() \
+           << " " #name "_p50=" << timers[timer].percentile(0.5) \
+           << " " #name "_p99=" << timers[timer].percentile(0.99); \
+    }
+
+    XX(format_ns, FORMAT_TIME);
+    XX(write_ns, WRITE_TIME);
+#undef XX
+    return ss.str();
+}
+
+LogStats::Timing::Timing(LogStats& stats)
+    : m_stats(stats)
+    , m_last(SampleTiming() ? GetMonotonicNS() : 0) {
+}
+
+void LogStats::Timing::lap(Timer timer) {
+    if(m_last) {
+        uint64_t now = GetMonotonicNS();
+        m_stats.record(timer, now - m_last);
+        m_last = now;
+    }
+}
+
+}
@@ -0,0 +1,212 @@
+#ifndef __ORANGE_LOG_STATS_H__
+#define __ORANGE_LOG_STATS_H__
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <stddef.h>
+
+namespace orange {
+
+namespace detail {
+/**
+ * @brief 当前线程的条带，0表示还没有分配，否则为下标加1，共用条带时带上LogStats::SHARED
+ * @details 常量初始化的__thread变量，日志宏内联读取时不需要经过TLS包装函数
+ */
+extern __thread uint32_t t_stats_stripe __attribute__((tls_model("initial-exec")));
+}
+
+/**
+ * @brief 日志系统自身的统计计数
+ * @details 计数分成STRIPES个条带。前STRIPES - 1个条带由线程独占，线程第一次使用时分到一个空闲的，
+ *          退出时归还；独占条带只有所属线程写入，计数用普通的读和写完成，没有原子读改写，
+ *          日志宏被禁用时的计数也只多一次线程局部变量的读取。独占条带用完后，其余线程共用最后一个条带，
+ *          用原子加；日志宏被禁用时这些线程不计数，避免每条被禁用的日志都争用同一个缓存行，
+ *          所以线程数超过STRIPES - 1时过滤条数偏小。读取时把所有条带相加，结果不是严格的瞬时值。
+ *          耗时直方图同样分条带，第一次记录时才分配。每TIMING_SAMPLE条记录采样一条，
+ *          按2的幂分桶，第i个桶记录[2^i, 2^(i+1))纳秒
+ */
+class LogStats {
+public:
+    /**
+     * @brief 计数项
+     */
+    enum Counter {
+        // 通过级别检查的条数
+        ACCEPTED = 0,
+        // 被级别过滤的条数
+        FILTERED,
+        // 被限流、采样或异步队列满丢弃的条数
+        DROPPED,
+        // 写出的字节数
+        BYTES,
+        COUNTER_MAX
+    };
+
+    /**
+     * @brief 耗时直方图
+     */
+    enum Timer {
+        // 格式化耗时
+        FORMAT_TIME = 0,
+        // 写出耗时，异步模式下是放入队列的耗时
+        WRITE_TIME,
+        TIMER_MAX
+    };
+
+    static const int STRIPES = 16;
+    // 共用条带的标志
+    static const uint32_t SHARED = 0x80000000;
+    static const int BUCKETS = 32;
+    static const uint32_t TIMING_SAMPLE = 16;
+
+    /**
+     * @brief 耗时直方图的读取结果
+     */
+    struct Histogram {
+        uint64_t buckets[BUCKETS] = {0};
+        // 采样条数和总耗时(纳秒)
+        uint64_t count = 0;
+        uint64_t sum = 0;
+
+        /**
+         * @brief 估算百分位数(纳秒)，取所在桶的上界
+         * @param[in] p 0到1之间
+         */
+        uint64_t percentile(double p) const;
+
+        uint64_t mean() const { return count ? sum / count : 0; }
+    };
+
+    /**
+     * @brief 某一时刻的统计结果
+     */
+    struct Snapshot {
+        uint64_t counters[COUNTER_MAX] = {0};
+        // 异步队列积压的最大字节数
+        uint64_t queue_high_water = 0;
+        Histogram timers[TIMER_MAX];
+
+        uint64_t accepted() const { return counters[ACCEPTED]; }
+        uint64_t filtered() const { return counters[FILTERED]; }
+        uint64_t dropped() const { return counters[DROPPED]; }
+        uint64_t bytes() const { return counters[BYTES]; }
+
+        /**
+         * @brief 输出为一行 key=value 形式的文本
+         */
+        std::string toString() const;
+    };
+
+    LogStats();
+    ~LogStats();
+    LogStats(const LogStats&) = delete;
+    LogStats& operator=(const LogStats&) = delete;
+
+    /**
+     * @brief 计数加v
+     */
+    void add(Counter counter, uint64_t v = 1) {
+        uint32_t stripe = StripeIndex();
+        Add(m_stripes[stripe & ~SHARED].counters[counter], v, stripe);
+    }
+
+    /**
+     * @brief 只在当前线程有独占条带时计数加一，共用条带的线程直接返回，不做原子读改写
+     */
+    void addExclusive(Counter counter) {
+        uint32_t stripe = StripeIndex();
+        if(!(stripe & SHARED)) {
+            Add(m_stripes[stripe].counters[counter], 1, stripe);
+        }
+    }
+
+    /**
+     * @brief 记录写出一条len字节的日志
+     */
+    void addRecord(size_t len) {
+        uint32_t stripe = StripeIndex();
+        Stripe& s = m_stripes[stripe & ~SHARED];
+        Add(s.counters[ACCEPTED], 1, stripe);
+        Add(s.counters[BYTES], len, stripe);
+    }
+
+    /**
+     * @brief 记录一次耗时
+     */
+    void record(Timer timer, uint64_t ns);
+
+    /**
+     * @brief 当前线程的这一条记录是否需要计时
+     */
+    static bool SampleTiming();
+
+    Snapshot snapshot() const;
+
+    /**
+     * @brief 一条记录格式化和写出的分段计时，不需要采样时不读时钟
+     */
+    class Timing {
+    public:
+        Timing(LogStats& stats);
+
+        /**
+         * @brief 把从上一个时刻到现在的耗时记入timer
+         */
+        void lap(Timer timer);
+    private:
+        LogStats& m_stats;
+        uint64_t m_last;
+    };
+private:
+    /**
+     * @brief 当前线程使用的条带下标，共用条带时带上SHARED
+     */
+    static uint32_t StripeIndex() {
+        uint32_t stripe = detail::t_stats_stripe;
+        if(__builtin_expect(stripe == 0, 0)) {
+            stripe = AssignStripe();
+        }
+        return stripe - 1;
+    }
+
+    /**
+     * @brief 给当前线程分配条带，返回值与 detail::t_stats_stripe 相同
+     */
+    static uint32_t AssignStripe();
+
+    /**
+     * @brief 独占条带只有本线程写，不需要原子读改写
+     */
+    static void Add(std::atomic<uint64_t>& counter, uint64_t v, uint32_t stripe) {
+        if(stripe & SHARED) {
+            counter.fetch_add(v, std::memory_order_relaxed);
+        } else {
+            counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+    }
+private:
+    /**
+     * @brief 一个条带，独占一个缓存行
+     */
+    struct alignas(64) Stripe {
+        std::atomic<uint64_t> counters[COUNTER_MAX];
+    };
+
+    /**
+     * @brief 一个条带的耗时直方图
+     */
+    struct TimerStripe {
+        std::atomic<uint64_t> buckets[TIMER_MAX][BUCKETS];
+        std::atomic<uint64_t> sum[TIMER_MAX];
+    };
+
+    // STRIPES个条带，单独按缓存行对齐分配，不要求LogStats所在的对象对齐
+    Stripe* m_stripes;
+    // STRIPES个直方图条带，只统计计数的日志器不分配
+    std::atomic<TimerStripe*> m_timers{nullptr};
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+#include "rcu.h"
+#include <assert.h>
+#include <thread>
+#include <vector>
+
+namespace orange {
+
+// 读者槽位数，超出的线程退化为共用一个计数器
+static const size_t RCU_MAX_READERS = 256;
+
+/**
+ * @brief 读者槽位，独占一个缓存行
+ */
+struct RcuSlot {
+    // 0表示不在临界区，否则为进入时的纪元
+    std::atomic<uint64_t> epoch;
+    // 槽位是否被线程占用
+    std::atomic<bool> used;
+    char pad[64 - sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<bool>)];
+};
+
+static RcuSlot s_slots[RCU_MAX_READERS];
+// 纪元从1开始，0保留给空闲状态
+static std::atomic<uint64_t> s_epoch(1);
+// 没有分到槽位的线程处于临界区的个数
+static std::atomic<uint64_t> s_overflow(0);
+
+/**
+ * @brief 线程的读者状态，线程退出时归还槽位
+ */
+struct RcuThread {
+    RcuSlot* slot = nullptr;
+    // 临界区嵌套深度
+    uint32_t depth = 0;
+    // 在临界区内退休的旧版本，离开最外层临界区时回收
+    std::vector<std::pair<void (*)(void*), void*> > retired;
+
+    RcuThread() {
+        for(size_t i = 0; i < RCU_MAX_READERS; ++i) {
+            bool expected = false;
+            if(!s_slots[i].used.load(std::memory_order_relaxed)
+                    && s_slots[i].used.compare_exchange_strong(expected, true)) {
+                slot = &s_slots[i];
+                break;
+            }
+        }
+    }
+
+    ~RcuThread() {
+        if(slot) {
+            slot->epoch.store(0, std::memory_order_release);
+            slot->used.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static RcuThread& GetRcuThread() {
+    static thread_local RcuThread s_thread;
+    return s_thread;
+}
+
+void Rcu::ReadLock() {
+    RcuThread& t = GetRcuThread();
+    if(t.depth++) {
+        return;
+    }
+    if(t.slot) {
+        // 必须是seq_cst: 槽位的写入要先于随后对RcuPtr的读取被写者看到；
+        // 纪元的读取要和写者推进纪元的fetch_add同步，不能读到过期的值
+        t.slot->epoch.store(s_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    } else {
+        s_overflow.fetch_add(1, std::memory_order_seq_cst);
+    }
+}
+
+void Rcu::ReadUnlock() {
+    RcuThread& t = GetRcuThread();
+    if(--t.depth) {
+        return;
+    }
+    if(t.slot) {
+        t.slot->epoch.store(0, std::memory_order_release);
+    } else {
+        s_overflow.fetch_sub(1, std::memory_order_release);
+    }
+    if(__builtin_expect(!t.retired.empty(), 0)) {
+        // 回收时可能再次进入临界区或退休新的版本，先取出来
+        std::vector<std::pair<void (*)(void*), void*> > retired;
+        retired.swap(t.retired);
+        Synchronize();
+        for(auto& i : retired) {
+            i.first(i.second);
+        }
+    }
+}
+
+uint32_t Rcu::GetReadDepth() {
+    return GetRcuThread().depth;
+}
+
+void Rcu::Retire(void (*cb)(void*), void* arg) {
+    RcuThread& t = GetRcuThread();
+    if(t.depth) {
+        t.retired.push_back(std::make_pair(cb, arg));
+        return;
+    }
+    Synchronize();
+    cb(arg);
+}
+
+void Rcu::Synchronize() {
+    assert(!InReadSection() && "Rcu::Synchronize() inside a read section");
+    uint64_t epoch = s_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    for(size_t i = 0; i < RCU_MAX_READERS; ++i) {
+        // 在新纪元之后进入的读者只能看到新版本，不需要等待
+        uint64_t v = 0;
+        while((v = s_slots[i].epoch.load(std::memory_order_seq_cst)) != 0 && v < epoch) {
+            std::this_thread::yield();
+        }
+    }
+    while(s_overflow.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+}
+
+}
@@ -0,0 +1,119 @@
+#ifndef __ORANGE_RCU_H__
+#define __ORANGE_RCU_H__
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+namespace orange {
+
+/**
+ * @brief 基于纪元(epoch)的读-复制-更新同步域
+ * @details 读者进入临界区时只在自己的槽位里写入当前纪元，不加锁也不会被写者阻塞；
+ *          写者发布新版本后推进纪元，等待所有还停留在旧纪元的读者离开，再回收旧版本。
+ *          全进程共用一个同步域，槽位按线程分配，线程退出时归还
+ */
+class Rcu {
+public:
+    /**
+     * @brief 读者进入临界区，可以嵌套
+     */
+    static void ReadLock();
+
+    /**
+     * @brief 读者离开临界区
+     */
+    static void ReadUnlock();
+
+    /**
+     * @brief 等待调用之前进入临界区的读者全部离开
+     * @details 只有写者调用，可能阻塞。不能在读临界区内调用，否则会等待自己而死锁
+     */
+    static void Synchronize();
+
+    /**
+     * @brief 当前线程是否在读临界区内
+     */
+    static bool InReadSection() { return GetReadDepth() != 0; }
+
+    /**
+     * @brief 当前线程读临界区的嵌套深度
+     */
+    static uint32_t GetReadDepth();
+
+    /**
+     * @brief 宽限期结束后调用cb(arg)回收旧版本
+     * @details 不在读临界区内时立即等待宽限期并回收；在读临界区内时(例如Appender里修改了日志器)
+     *          推迟到当前线程离开最外层临界区时再等待和回收
+     */
+    static void Retire(void (*cb)(void*), void* arg);
+};
+
+/**
+ * @brief 读临界区的RAII封装
+ */
+class RcuReadGuard {
+public:
+    RcuReadGuard() { Rcu::ReadLock(); }
+    ~RcuReadGuard() { Rcu::ReadUnlock(); }
+    RcuReadGuard(const RcuReadGuard&) = delete;
+    RcuReadGuard& operator=(const RcuReadGuard&) = delete;
+};
+
+/**
+ * @brief 写时复制的RCU指针
+ * @details 读者在 RcuReadGuard 内通过get()拿到当前版本的只读快照；
+ *          写者通过update()复制一份、修改后整体发布，旧版本在宽限期结束后删除。
+ *          写者之间用互斥量串行，可以在读临界区内调用update()
+ */
+template<class T>
+class RcuPtr {
+public:
+    RcuPtr()
+        :m_ptr(new T) {
+    }
+
+    ~RcuPtr() {
+        delete m_ptr.load(std::memory_order_relaxed);
+    }
+
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    /**
+     * @brief 读取当前版本，必须在 RcuReadGuard 的作用域内使用返回值
+     */
+    const T* get() const {
+        return m_ptr.load(std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief 复制当前版本，用cb修改后发布
+     * @param[in] cb 形如 bool(T&)，返回false表示没有修改，不发布新版本
+     * @return 是否发布了新版本
+     */
+    template<class CB>
+    bool update(CB cb) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        T* old = m_ptr.load(std::memory_order_relaxed);
+        T* value = new T(*old);
+        if(!cb(*value)) {
+            delete value;
+            return false;
+        }
+        m_ptr.store(value, std::memory_order_seq_cst);
+        Rcu::Retire(&RcuPtr::Delete, old);
+        return true;
+    }
+private:
+    static void Delete(void* p) {
+        delete (T*)p;
+    }
+private:
+    std::atomic<T*> m_ptr;
+    std::mutex m_mutex;
+};
+
+}
+
+#endif
@@ -0,0 +1,66 @@
+#include "ring_buffer.h"
+
+namespace orange {
+
+SpscRingBuffer::SpscRingBuffer(size_t capacity)
+    : m_head(0)
+    , m_tail(0) {
+    m_capacity = 64;
+    while(m_capacity < capacity) {
+        m_capacity <<= 1;
+    }
+    m_mask = m_capacity - 1;
+    m_data.reset(new char[m_capacity]);
+}
+
+char* SpscRingBuffer::reserve(size_t len) {
+    size_t total = Align(sizeof(Header) + len);
+    if(total > m_capacity) {
+        return nullptr;
+    }
+
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    size_t idx = tail & m_mask;
+    size_t contig = m_capacity - idx;
+    // 末尾放不下时需要额外占用剩余部分作为填充
+    size_t need = contig < total ? contig + total : total;
+    if(tail + need - m_cachedHead > m_capacity) {
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        if(tail + need - m_cachedHead > m_capacity) {
+            return nullptr;
+        }
+    }
+
+    if(contig < total) {
+        Header* pad = (Header*)(m_data.get() + idx);
+        pad->len = contig - sizeof(Header);
+        pad->pad = 1;
+        tail += contig;
+        idx = 0;
+    }
+
+    Header* header = (Header*)(m_data.get() + idx);
+    header->len = len;
+    header->pad = 0;
+    m_reserveEnd = tail + total;
+    return m_data.get() + idx + sizeof(Header);
+}
+
+void SpscRingBuffer::commit() {
+    m_tail.store(m_reserveEnd, std::memory_order_release);
+}
+
+const char* SpscRingBuffer::read(uint64_t& pos, uint64_t end, size_t& len) const {
+    while(pos < end) {
+        const Header* header = (const Header*)(m_data.get() + (pos & m_mask));
+        pos += Align(sizeof(Header) + header->len);
+        if(header->pad) {
+            continue;
+        }
+        len = header->len;
+        return (const char*)(header + 1);
+    }
+    return nullptr;
+}
+
+}
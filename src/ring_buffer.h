@@ -0,0 +1,97 @@
+#ifndef __ORANGE_RING_BUFFER_H__
+#define __ORANGE_RING_BUFFER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+
+namespace orange {
+
+/**
+ * @brief 单生产者单消费者的变长记录环形缓冲区
+ * @details 每条记录在内存中连续存放(到达末尾放不下时用填充记录跳到开头)，
+ *          消费者可以直接拿记录的指针去写文件而不需要再拷贝一次。
+ *          位置使用单调递增的64位计数，下标为 pos & (capacity - 1)
+ */
+class SpscRingBuffer {
+public:
+    typedef std::shared_ptr<SpscRingBuffer> ptr;
+
+    /**
+     * @brief 构造
+     * @param[in] capacity 容量(字节)，向上取整为2的幂
+     */
+    SpscRingBuffer(size_t capacity);
+
+    size_t capacity() const { return m_capacity; }
+
+    /**
+     * @brief 生产者预留一段连续空间
+     * @return 空间不足返回nullptr
+     */
+    char* reserve(size_t len);
+
+    /**
+     * @brief 生产者发布最近一次预留的记录
+     */
+    void commit();
+
+    /**
+     * @brief 消费者当前的读位置
+     */
+    uint64_t readPos() const { return m_head.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 生产者已发布的位置
+     */
+    uint64_t writePos() const { return m_tail.load(std::memory_order_acquire); }
+
+    /**
+     * @brief 消费者读取pos处的记录，pos前进到下一条记录
+     * @param[in,out] pos 读位置
+     * @param[in] end 读到该位置为止(一般是writePos()的返回值)
+     * @param[out] len 记录长度
+     * @return 没有记录返回nullptr
+     */
+    const char* read(uint64_t& pos, uint64_t end, size_t& len) const;
+
+    /**
+     * @brief 消费者释放pos之前的所有记录
+     */
+    void release(uint64_t pos) { m_head.store(pos, std::memory_order_release); }
+
+    bool empty() const { return readPos() == writePos(); }
+private:
+    /**
+     * @brief 记录头
+     */
+    struct Header {
+        // 记录长度(不包括头)
+        uint32_t len;
+        // 是否为填充记录
+        uint32_t pad;
+    };
+
+    static size_t Align(size_t len) { return (len + 7) & ~(size_t)7; }
+private:
+    std::unique_ptr<char[]> m_data;
+    size_t m_capacity;
+    size_t m_mask;
+
+    // 生产者和消费者的字段用填充隔开，避免伪共享(C++11的new不支持alignas超过16字节)
+    char m_pad0[64];
+    // 消费者位置
+    std::atomic<uint64_t> m_head;
+    char m_pad1[64];
+    // 生产者缓存的消费者位置，减少跨核读取
+    uint64_t m_cachedHead = 0;
+    // 生产者正在写入的位置(未发布)
+    uint64_t m_reserveEnd = 0;
+    // 生产者已发布的位置
+    std::atomic<uint64_t> m_tail;
+};
+
+}
+
+#endif
@@ -0,0 +1,244 @@
+#include "sharded_log.h"
+#include "util.h"
+#include <limits.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+namespace orange {
+
+// 写入器id生成器
+static std::atomic<uint64_t> s_sharded_id(0);
+
+ShardedLogWriter::ShardedLogWriter(writev_cb write, flush_cb flush, const Config& config)
+    : m_write(write)
+    , m_flush(flush)
+    , m_config(config)
+    , m_id(++s_sharded_id)
+    , m_dropped(0) {
+    if(m_config.ring_size == 0) {
+        m_config.ring_size = Config().ring_size;
+    }
+    if(m_config.flush_interval == 0) {
+        m_config.flush_interval = Config().flush_interval;
+    }
+    m_iov.reserve(IOV_MAX);
+    m_thread = std::thread(std::bind(&ShardedLogWriter::run, this));
+}
+
+ShardedLogWriter::ShardedLogWriter(writev_cb write, flush_cb flush)
+    : ShardedLogWriter(write, flush, Config()) {
+}
+
+ShardedLogWriter::~ShardedLogWriter() {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cond.notify_one();
+    }
+    m_thread.join();
+
+    // 线程缓存里还引用着分片，标记后由线程下次查找时清理
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for(auto& i : m_shards) {
+        i->closed.store(true, std::memory_order_release);
+    }
+    m_shards.clear();
+}
+
+ShardedLogWriter::Shard* ShardedLogWriter::getShard() {
+    /**
+     * @brief 线程持有的分片，线程退出时通知写入器
+     */
+    struct ShardCache {
+        std::vector<Shard::ptr> shards;
+
+        ~ShardCache() {
+            for(auto& i : shards) {
+                i->detached.store(true, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local ShardCache s_cache;
+
+    std::vector<Shard::ptr>& shards = s_cache.shards;
+    for(auto& i : shards) {
+        if(i->owner == m_id) {
+            return i.get();
+        }
+    }
+
+    shards.erase(std::remove_if(shards.begin(), shards.end(), [](const Shard::ptr& shard) {
+        return shard->closed.load(std::memory_order_acquire);
+    }), shards.end());
+
+    Shard::ptr shard(new Shard(m_id, m_config.ring_size));
+    shards.push_back(shard);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_shards.push_back(shard);
+    return shard.get();
+}
+
+void ShardedLogWriter::append(uint64_t time, const char* data, size_t len) {
+    Shard* shard = getShard();
+    size_t total = sizeof(time) + len;
+    if(total > shard->ring.capacity() / 2) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    char* p = nullptr;
+    while(!(p = shard->ring.reserve(total))) {
+        if(m_config.policy != AsyncLogWriter::BLOCK) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        // 环形缓冲区满时唤醒后台线程，等待它腾出空间
+        m_cond.notify_one();
+        std::this_thread::yield();
+    }
+    memcpy(p, &time, sizeof(time));
+    memcpy(p + sizeof(time), data, len);
+    shard->ring.commit();
+
+    uint64_t depth = shard->ring.writePos() - shard->ring.readPos();
+    uint64_t high = m_highWater.load(std::memory_order_relaxed);
+    while(depth > high && !m_highWater.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {
+    }
+}
+
+void ShardedLogWriter::flush() {
+    drain();
+}
+
+void ShardedLogWriter::requestFlush() {
+    if(m_flushRequested.load(std::memory_order_relaxed)
+            || m_flushRequested.exchange(true, std::memory_order_relaxed)) {
+        return;
+    }
+    // 在锁内通知，后台线程检查标志和开始等待之间不会错过
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.notify_one();
+}
+
+void ShardedLogWriter::drain() {
+    std::unique_lock<std::mutex> drain_lock(m_drainMutex);
+
+    /**
+     * @brief 分片的读取位置
+     */
+    struct Cursor {
+        Shard* shard;
+        uint64_t pos;
+        uint64_t end;
+        const char* data;
+        size_t len;
+        uint64_t time;
+
+        bool next() {
+            data = shard->ring.read(pos, end, len);
+            if(!data) {
+                return false;
+            }
+            memcpy(&time, data, sizeof(time));
+            data += sizeof(time);
+            len -= sizeof(time);
+            return true;
+        }
+    };
+
+    std::vector<Shard::ptr> shards;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // 线程已退出且写完的分片不再需要
+        m_shards.erase(std::remove_if(m_shards.begin(), m_shards.end(), [](const Shard::ptr& shard) {
+            return shard->detached.load(std::memory_order_acquire) && shard->ring.empty();
+        }), m_shards.end());
+        shards = m_shards;
+    }
+
+    std::vector<Cursor> cursors(shards.size());
+    std::vector<Cursor*> heap;
+    heap.reserve(shards.size());
+    for(size_t i = 0; i < shards.size(); ++i) {
+        Cursor& c = cursors[i];
+        c.shard = shards[i].get();
+        c.pos = c.shard->ring.readPos();
+        c.end = c.shard->ring.writePos();
+        if(c.next()) {
+            heap.push_back(&c);
+        }
+    }
+    if(heap.empty()) {
+        return;
+    }
+
+    // 小顶堆，按时间戳归并各分片
+    auto later = [](const Cursor* a, const Cursor* b) {
+        return a->time > b->time;
+    };
+    std::make_heap(heap.begin(), heap.end(), later);
+    while(!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        Cursor* c = heap.back();
+        struct iovec iov;
+        iov.iov_base = (void*)c->data;
+        iov.iov_len = c->len;
+        m_iov.push_back(iov);
+        if(m_iov.size() == IOV_MAX) {
+            m_write(&m_iov[0], m_iov.size());
+            m_iov.clear();
+        }
+        if(c->next()) {
+            std::push_heap(heap.begin(), heap.end(), later);
+        } else {
+            heap.pop_back();
+        }
+    }
+    if(!m_iov.empty()) {
+        m_write(&m_iov[0], m_iov.size());
+        m_iov.clear();
+    }
+    m_flush();
+
+    // 数据写出之后才能归还空间
+    for(auto& c : cursors) {
+        c.shard->ring.release(c.end);
+    }
+}
+
+void ShardedLogWriter::drainTo(int fd) {
+    for(auto& shard : m_shards) {
+        if(!shard) {
+            continue;
+        }
+        uint64_t pos = shard->ring.readPos();
+        uint64_t end = shard->ring.writePos();
+        size_t len = 0;
+        const char* data = nullptr;
+        while((data = shard->ring.read(pos, end, len))) {
+            // 跳过记录前的时间戳
+            WriteAll(fd, data + sizeof(uint64_t), len - sizeof(uint64_t));
+        }
+    }
+}
+
+void ShardedLogWriter::run() {
+    while(true) {
+        bool stopping = false;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if(!m_stopping && !m_flushRequested.load(std::memory_order_relaxed)) {
+                m_cond.wait_for(lock, std::chrono::milliseconds(m_config.flush_interval));
+            }
+            stopping = m_stopping;
+        }
+        m_flushRequested.store(false, std::memory_order_relaxed);
+        drain();
+        if(stopping) {
+            break;
+        }
+    }
+}
+
+}
@@ -0,0 +1,163 @@
+#ifndef __ORANGE_SHARDED_LOG_H__
+#define __ORANGE_SHARDED_LOG_H__
+
+#include "ring_buffer.h"
+#include "async_log.h"
+#include <sys/uio.h>
+#include <stdint.h>
+#include <string>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+namespace orange {
+
+/**
+ * @brief 按线程分片的异步日志写入器
+ * @details 每个写日志的线程拥有一个单生产者单消费者环形缓冲区，追加日志不加锁。
+ *          后台线程收集所有分片中已提交的记录，按时间戳归并后直接用环形缓冲区里的
+ *          内存组成iovec，以writev批量写出。归并只在一次收集的范围内进行，
+ *          提交较晚而时间戳较早的记录可能排在上一批之后
+ */
+class ShardedLogWriter {
+public:
+    typedef std::shared_ptr<ShardedLogWriter> ptr;
+    /**
+     * @brief 写出一组iovec，可以修改iov处理部分写入
+     */
+    typedef std::function<void (struct iovec* iov, int cnt)> writev_cb;
+    typedef std::function<void ()> flush_cb;
+
+    /**
+     * @brief 分片写入配置
+     */
+    struct Config {
+        // 每个线程环形缓冲区的大小(字节)
+        size_t ring_size = 1024 * 1024;
+        // 环形缓冲区满时的策略，DROP_OLDEST 按 DROP_NEWEST 处理
+        AsyncLogWriter::Policy policy = AsyncLogWriter::BLOCK;
+        // 后台线程最长多久收集一次(毫秒)
+        uint32_t flush_interval = 10;
+
+        bool operator==(const Config& oth) const {
+            return ring_size == oth.ring_size
+                && policy == oth.policy
+                && flush_interval == oth.flush_interval;
+        }
+    };
+
+    /**
+     * @brief 构造并启动后台线程
+     * @param[in] write 在后台线程中写出一批记录
+     * @param[in] flush 一批记录写完后调用
+     */
+    ShardedLogWriter(writev_cb write, flush_cb flush, const Config& config);
+    ShardedLogWriter(writev_cb write, flush_cb flush);
+
+    /**
+     * @brief 写完所有分片中已提交的记录后停止后台线程
+     */
+    ~ShardedLogWriter();
+
+    /**
+     * @brief 追加一条日志到当前线程的分片
+     * @param[in] time 日志时间戳(纳秒)，用于归并
+     */
+    void append(uint64_t time, const char* data, size_t len);
+
+    /**
+     * @brief 把调用前追加的日志全部写出
+     */
+    void flush();
+
+    /**
+     * @brief 请求后台线程尽快写出，不等待
+     * @details 已有未处理的请求时只读一次原子变量，不加锁
+     */
+    void requestFlush();
+
+    /**
+     * @brief 进程崩溃时把各分片中已提交的记录直接写入fd
+     * @details 不加锁、不分配内存，只在致命信号处理函数中使用。
+     *          按分片依次写出，不再按时间归并
+     */
+    void drainTo(int fd);
+
+    const Config& getConfig() const { return m_config; }
+
+    /**
+     * @brief 被丢弃的日志条数
+     */
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 单个分片最多积压过多少字节
+     */
+    uint64_t getHighWater() const { return m_highWater.load(std::memory_order_relaxed); }
+private:
+    /**
+     * @brief 一个线程的分片
+     */
+    struct Shard {
+        typedef std::shared_ptr<Shard> ptr;
+
+        Shard(uint64_t owner, size_t size)
+            : ring(size)
+            , owner(owner) {
+        }
+
+        SpscRingBuffer ring;
+        // 所属写入器的id
+        uint64_t owner;
+        // 写入器已销毁，线程不再使用该分片
+        std::atomic<bool> closed{false};
+        // 线程已退出，分片写完后可以移除
+        std::atomic<bool> detached{false};
+    };
+
+    /**
+     * @brief 取当前线程的分片，第一次使用时创建并注册
+     */
+    Shard* getShard();
+
+    /**
+     * @brief 收集所有分片的记录并写出
+     */
+    void drain();
+
+    /**
+     * @brief 后台线程
+     */
+    void run();
+private:
+    writev_cb m_write;
+    flush_cb m_flush;
+    Config m_config;
+    // 写入器id，线程缓存的分片以此区分写入器
+    uint64_t m_id;
+
+    // 保护分片列表和线程状态
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<Shard::ptr> m_shards;
+    bool m_stopping = false;
+    // 是否有未处理的写出请求
+    std::atomic<bool> m_flushRequested{false};
+
+    // 保证同一时间只有一个消费者
+    std::mutex m_drainMutex;
+    std::vector<struct iovec> m_iov;
+
+    std::atomic<uint64_t> m_dropped;
+    // 只在超过时修改，一般不产生竞争
+    std::atomic<uint64_t> m_highWater{0};
+    std::thread m_thread;
+};
+
+}
+
+#endif
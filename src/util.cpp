@@ -1,13 +1,394 @@
 #include "util.h"
+#include <time.h>
+#include <errno.h>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/prctl.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 namespace orange {
     
+// 0表示还没有获取；常量初始化，访问时不需要检查初始化
+static thread_local pid_t s_thread_id __attribute__((tls_model("initial-exec"))) = 0;
+
+static void ResetThreadIdAfterFork() {
+    s_thread_id = 0;
+}
+
+static int s_thread_id_atfork = pthread_atfork(nullptr, nullptr, ResetThreadIdAfterFork);
+
 pid_t GetThreadId(){
-    return syscall(SYS_gettid);
+    if(!s_thread_id) {
+        s_thread_id = syscall(SYS_gettid);
+    }
+    return s_thread_id;
+}
+
+const std::string& GetThreadName() {
+    return ThreadContext::GetThis().getName();
+}
+
+void SetThreadName(const std::string& name) {
+    ThreadContext::GetThis().setName(name);
+}
+
+ThreadContext& ThreadContext::GetThis() {
+    static thread_local ThreadContext s_context;
+    return s_context;
+}
+
+ThreadContext::ThreadContext() {
+    char name[16] = {0};
+    prctl(PR_GET_NAME, name, 0, 0, 0);
+    m_name = name;
+}
+
+ThreadContext::~ThreadContext() {
+    if(m_altStack) {
+        stack_t ss;
+        memset(&ss, 0, sizeof(ss));
+        ss.ss_flags = SS_DISABLE;
+        sigaltstack(&ss, nullptr);
+    }
+}
+
+void ThreadContext::installAltStack(size_t size) {
+    if(m_altStackChecked) {
+        return;
+    }
+    m_altStackChecked = true;
+    stack_t old;
+    if(sigaltstack(nullptr, &old) == 0 && !(old.ss_flags & SS_DISABLE)) {
+        return;
+    }
+    std::unique_ptr<char[]> stack(new char[size]);
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = stack.get();
+    ss.ss_size = size;
+    if(sigaltstack(&ss, nullptr) == 0) {
+        m_altStack.swap(stack);
+    }
+}
+
+void ThreadContext::setName(const std::string& name) {
+    m_name = name;
+    prctl(PR_SET_NAME, name.substr(0, 15).c_str(), 0, 0, 0);
+}
+
+void ThreadContext::push(const std::string& key, const std::string& value) {
+    if(m_size == m_entries.size()) {
+        m_entries.push_back(Entry());
+    }
+    Entry& entry = m_entries[m_size++];
+    entry.key = key;
+    entry.value = value;
+}
+
+void ThreadContext::pop() {
+    if(m_size > 0) {
+        --m_size;
+    }
+}
+
+const std::string* ThreadContext::find(const char* key, size_t len, size_t depth) const {
+    for(size_t i = std::min(depth, m_size); i > 0; --i) {
+        const Entry& entry = m_entries[i - 1];
+        if(entry.key.size() == len && entry.key.compare(0, len, key, len) == 0) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
 }
 
 uint32_t GetFiberId(){
     return 0;
 }
 
+uint64_t GetCurrentNS(){
+    return Clock::WallNS();
+}
+
+uint64_t GetMonotonicNS(){
+    return Clock::NowNS();
+}
+
+static uint64_t ReadClock(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool HasInvariantTsc() {
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+        return false;
+    }
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return edx & (1u << 8);
+#else
+    return false;
+#endif
+}
+
+static uint64_t ReadTsc() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+namespace {
+
+/**
+ * @brief 时钟的全部状态
+ * @details TSC换算参数用序列锁保护：写者先把m_seq改成奇数，再读TSC和单调时钟，
+ *          读者只接受读TSC前后m_seq相同且为偶数的参数。这样用旧参数算出的时间
+ *          都早于新的基准点，新基准点又不早于旧参数的外推值，时间不会回退
+ */
+struct ClockState {
+    // 第一次对齐后的间隔，之后每次翻倍直到SYNC_MAX
+    static const uint64_t SYNC_MIN = 10000000ull;
+    static const uint64_t SYNC_MAX = 1000000000ull;
+    // 初始校准时长
+    static const uint64_t CALIBRATE_NS = 1000000ull;
+
+    std::atomic<uint32_t> m_seq{0};
+    std::atomic<uint64_t> m_baseTsc{0};
+    std::atomic<uint64_t> m_baseNs{0};
+    // 每个TSC周期的纳秒数，32.32定点
+    std::atomic<uint64_t> m_mult{0};
+    // 墙上时间减单调时间
+    std::atomic<int64_t> m_wallOffset{0};
+    // 到这个单调时间后重新对齐
+    std::atomic<uint64_t> m_nextSync{0};
+    std::atomic<int> m_source{Clock::MONOTONIC};
+    uint64_t m_start = 0;
+
+    // 以下只在持有m_mutex时访问
+    std::mutex m_mutex;
+    bool m_tscUsable = false;
+    // 上一次实测的TSC和单调时间，用来计算频率
+    uint64_t m_anchorTsc = 0;
+    uint64_t m_anchorNs = 0;
+    uint64_t m_interval = SYNC_MIN;
+
+    ClockState() {
+        m_tscUsable = HasInvariantTsc();
+        if(m_tscUsable) {
+            startTsc();
+        } else {
+            syncOffset(ReadClock(CLOCK_MONOTONIC));
+        }
+        m_start = now();
+    }
+
+    Clock::Source source() const {
+        return (Clock::Source)m_source.load(std::memory_order_relaxed);
+    }
+
+    uint64_t now() {
+        uint64_t ns;
+        switch(source()) {
+            case Clock::TSC:
+                ns = tscNow();
+                break;
+            case Clock::MONOTONIC_COARSE:
+                ns = ReadClock(CLOCK_MONOTONIC_COARSE);
+                break;
+            default:
+                ns = ReadClock(CLOCK_MONOTONIC);
+                break;
+        }
+        if(ns >= m_nextSync.load(std::memory_order_relaxed)) {
+            sync();
+        }
+        return ns;
+    }
+
+    uint64_t tscNow() const {
+        uint32_t seq;
+        uint64_t tsc, base_tsc, base_ns, mult;
+        do {
+            seq = m_seq.load(std::memory_order_acquire);
+            tsc = ReadTsc();
+            base_tsc = m_baseTsc.load(std::memory_order_relaxed);
+            base_ns = m_baseNs.load(std::memory_order_relaxed);
+            mult = m_mult.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while((seq & 1) || seq != m_seq.load(std::memory_order_relaxed));
+        // 其他核心上的TSC可能略小于基准点
+        uint64_t delta = (int64_t)(tsc - base_tsc) > 0 ? tsc - base_tsc : 0;
+        return base_ns + (uint64_t)(((unsigned __int128)delta * mult) >> 32);
+    }
+
+    /**
+     * @brief 到期后由读时间的线程顺带完成对齐，其他线程正在对齐时直接返回
+     */
+    void sync() {
+        std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+        if(!lock.owns_lock()) {
+            return;
+        }
+        if(source() == Clock::TSC) {
+            syncTsc();
+        } else {
+            syncOffset(ReadClock(CLOCK_MONOTONIC));
+        }
+    }
+
+    void syncOffset(uint64_t mono) {
+        m_wallOffset.store(ReadClock(CLOCK_REALTIME) - mono, std::memory_order_relaxed);
+        m_nextSync.store(mono + SYNC_MAX, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 切换到TSC：先自旋校准频率。基准点取校准结束时的CLOCK_MONOTONIC，
+     *        不早于之前任何来源的读数
+     */
+    void startTsc() {
+        m_anchorTsc = ReadTsc();
+        m_anchorNs = ReadClock(CLOCK_MONOTONIC);
+        uint64_t mono, tsc;
+        do {
+            tsc = ReadTsc();
+            mono = ReadClock(CLOCK_MONOTONIC);
+        } while(mono - m_anchorNs < CALIBRATE_NS || tsc == m_anchorTsc);
+        uint64_t mult = (uint64_t)((((unsigned __int128)(mono - m_anchorNs)) << 32) / (tsc - m_anchorTsc));
+        m_anchorTsc = tsc;
+        m_anchorNs = mono;
+        m_interval = SYNC_MIN;
+        publish(tsc, mono, mult);
+        m_source.store(Clock::TSC, std::memory_order_relaxed);
+        m_wallOffset.store(ReadClock(CLOCK_REALTIME) - mono, std::memory_order_relaxed);
+        m_nextSync.store(mono + m_interval, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 用距上次实测的这一段重新计算频率，并让外推值在下个间隔内追上单调时钟
+     */
+    void syncTsc() {
+        m_seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        uint64_t tsc = ReadTsc();
+        uint64_t mono = ReadClock(CLOCK_MONOTONIC);
+        uint64_t base_tsc = m_baseTsc.load(std::memory_order_relaxed);
+        uint64_t base_ns = m_baseNs.load(std::memory_order_relaxed);
+        uint64_t mult = m_mult.load(std::memory_order_relaxed);
+        uint64_t delta = (int64_t)(tsc - base_tsc) > 0 ? tsc - base_tsc : 0;
+        uint64_t extrapolated = base_ns + (uint64_t)(((unsigned __int128)delta * mult) >> 32);
+
+        if(tsc > m_anchorTsc) {
+            mult = (uint64_t)((((unsigned __int128)(mono - m_anchorNs)) << 32) / (tsc - m_anchorTsc));
+        }
+        m_interval = m_interval * 2 < SYNC_MAX ? m_interval * 2 : SYNC_MAX;
+        uint64_t base = mono;
+        if(extrapolated > mono) {
+            // 已经跑快了，不能回退，只能放慢
+            base = extrapolated;
+            uint64_t ahead = extrapolated - mono;
+            if(ahead > m_interval / 2) {
+                ahead = m_interval / 2;
+            }
+            mult = (uint64_t)((unsigned __int128)mult * (m_interval - ahead) / m_interval);
+        }
+        m_anchorTsc = tsc;
+        m_anchorNs = mono;
+        m_baseTsc.store(tsc, std::memory_order_relaxed);
+        m_baseNs.store(base, std::memory_order_relaxed);
+        m_mult.store(mult, std::memory_order_relaxed);
+        m_seq.fetch_add(1, std::memory_order_release);
+        m_wallOffset.store(ReadClock(CLOCK_REALTIME) - mono, std::memory_order_relaxed);
+        m_nextSync.store(mono + m_interval, std::memory_order_relaxed);
+    }
+
+    void publish(uint64_t tsc, uint64_t ns, uint64_t mult) {
+        m_seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_baseTsc.store(tsc, std::memory_order_relaxed);
+        m_baseNs.store(ns, std::memory_order_relaxed);
+        m_mult.store(mult, std::memory_order_relaxed);
+        m_seq.fetch_add(1, std::memory_order_release);
+    }
+};
+
+}
+
+static ClockState& GetClockState() {
+    static ClockState s_state;
+    return s_state;
+}
+
+const char* Clock::ToString(Source source) {
+    switch(source) {
+#define XX(name) \
+        case name: \
+            return #name;
+
+        XX(TSC);
+        XX(MONOTONIC);
+        XX(MONOTONIC_COARSE);
+#undef XX
+        default:
+            return "UNKNOWN";
+    }
+}
+
+uint64_t Clock::NowNS() {
+    return GetClockState().now();
+}
+
+uint64_t Clock::ToWallNS(uint64_t mono) {
+    return mono + GetClockState().m_wallOffset.load(std::memory_order_relaxed);
+}
+
+uint64_t Clock::StartNS() {
+    return GetClockState().m_start;
+}
+
+Clock::Source Clock::GetSource() {
+    return GetClockState().source();
+}
+
+bool Clock::SetSource(Source source) {
+    ClockState& state = GetClockState();
+    std::unique_lock<std::mutex> lock(state.m_mutex);
+    if(source == state.source()) {
+        return true;
+    }
+    if(source == TSC) {
+        if(!state.m_tscUsable) {
+            return false;
+        }
+        state.startTsc();
+        return true;
+    }
+    state.m_source.store(source, std::memory_order_relaxed);
+    state.syncOffset(ReadClock(CLOCK_MONOTONIC));
+    return true;
+}
+
+void WriteAll(int fd, const char* data, size_t len){
+    while(len > 0 && fd >= 0) {
+        ssize_t n = ::write(fd, data, len);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
 }
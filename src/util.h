@@ -2,19 +2,195 @@
 #define __ORANGE_UTIL_H__
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
 namespace orange{
     /**
      * @brief 获取线程ID
+     * @details 每个线程第一次调用时执行gettid并缓存，fork后的子进程重新获取
      */
     pid_t GetThreadId();
 
+    /**
+     * @brief 获取当前线程的名称
+     */
+    const std::string& GetThreadName();
+
+    /**
+     * @brief 设置当前线程的名称，同时设置系统中的线程名(截断到15个字符)
+     */
+    void SetThreadName(const std::string& name);
+
     /**
      * @brief 获取协程ID
      */
     uint32_t GetFiberId();
+
+    /**
+     * @brief 获取当前墙上时间，单位纳秒，等同于 Clock::WallNS()
+     */
+    uint64_t GetCurrentNS();
+
+    /**
+     * @brief 获取单调时钟时间，单位纳秒，等同于 Clock::NowNS()
+     */
+    uint64_t GetMonotonicNS();
+
+    /**
+     * @brief 进程内共用的时钟，日志时间戳、定时和统计都从这里取时间
+     * @details x86-64上CPU声明TSC恒定(invariant TSC)时用rdtsc：第一次使用时相对CLOCK_MONOTONIC校准，
+     *          之后每秒重新对齐一次并修正频率，读一次时间只需要rdtsc和一次乘法，结果保证不回退。
+     *          不支持时使用CLOCK_MONOTONIC，也可以切换到CLOCK_MONOTONIC_COARSE换取更低的开销，
+     *          精度降为一个时钟节拍。墙上时间由单调时间加上对齐时测得的偏移得到，
+     *          系统时间被调整后最多一秒跟上
+     */
+    class Clock {
+    public:
+        /**
+         * @brief 时间来源
+         */
+        enum Source {
+            TSC = 0,
+            MONOTONIC = 1,
+            MONOTONIC_COARSE = 2
+        };
+
+        static const char* ToString(Source source);
+
+        /**
+         * @brief 单调时间(纳秒)
+         */
+        static uint64_t NowNS();
+
+        /**
+         * @brief 把NowNS()的值换算成墙上时间(纳秒)
+         */
+        static uint64_t ToWallNS(uint64_t mono);
+
+        /**
+         * @brief 当前墙上时间(纳秒)
+         */
+        static uint64_t WallNS() { return ToWallNS(NowNS()); }
+
+        /**
+         * @brief 时钟初始化(进程启动)时的单调时间(纳秒)
+         */
+        static uint64_t StartNS();
+
+        /**
+         * @brief 从进程启动到mono经过的纳秒数
+         */
+        static uint64_t ElapsedNS(uint64_t mono) { return mono - StartNS(); }
+        static uint64_t ElapsedNS() { return ElapsedNS(NowNS()); }
+
+        static Source GetSource();
+
+        /**
+         * @brief 切换时间来源，TSC不可用时返回false
+         * @details 应在程序启动时调用，切换到MONOTONIC_COARSE时读数可能回退一个时钟节拍以内
+         */
+        static bool SetSource(Source source);
+    };
+
+    /**
+     * @brief 线程局部的日志上下文：线程名和MDC(mapped diagnostic context)
+     * @details MDC是一个键值栈，通过 MDCGuard 在作用域内压入，这个作用域里打的日志都带上这些键值。
+     *          日志事件只保存上下文指针和当时的栈深度，不复制字符串，格式化需要在产生事件的线程内、
+     *          压入的键值出栈之前完成(同步、异步和分片写出都满足)。出栈的元素留作下次压入复用，
+     *          稳定运行后不分配内存
+     */
+    class ThreadContext {
+    public:
+        /**
+         * @brief MDC中的一项
+         */
+        struct Entry {
+            std::string key;
+            std::string value;
+        };
+
+        /**
+         * @brief 当前线程的上下文
+         */
+        static ThreadContext& GetThis();
+
+        const std::string& getName() const { return m_name; }
+        void setName(const std::string& name);
+
+        /**
+         * @brief 压入一个键值
+         */
+        void push(const std::string& key, const std::string& value);
+
+        /**
+         * @brief 弹出栈顶的键值
+         */
+        void pop();
+
+        /**
+         * @brief 栈中的元素个数
+         */
+        size_t size() const { return m_size; }
+
+        /**
+         * @brief 栈中第i个元素，0是栈底
+         */
+        const Entry& at(size_t i) const { return m_entries[i]; }
+
+        /**
+         * @brief 在栈底的depth个元素中从上往下查找key
+         * @return 没有找到时返回nullptr
+         */
+        const std::string* find(const char* key, size_t len, size_t depth) const;
+
+        /**
+         * @brief 给当前线程设置信号处理函数使用的备用栈，只能在所属线程调用
+         * @details 线程已经有备用栈(包括其他代码设置的)时不做任何事。线程退出时先停用再释放
+         */
+        void installAltStack(size_t size);
+
+        /**
+         * @brief 是否已经检查并设置过备用栈
+         */
+        bool hasAltStack() const { return m_altStackChecked; }
+
+        ~ThreadContext();
+    private:
+        ThreadContext();
+    private:
+        std::string m_name;
+        std::vector<Entry> m_entries;
+        size_t m_size = 0;
+        // 本对象分配的备用栈，使用其他代码设置的备用栈时为空
+        std::unique_ptr<char[]> m_altStack;
+        bool m_altStackChecked = false;
+    };
+
+    /**
+     * @brief 在作用域内给当前线程的MDC压入一个键值，离开作用域时弹出
+     */
+    class MDCGuard {
+    public:
+        MDCGuard(const std::string& key, const std::string& value) {
+            ThreadContext::GetThis().push(key, value);
+        }
+        ~MDCGuard() {
+            ThreadContext::GetThis().pop();
+        }
+        MDCGuard(const MDCGuard&) = delete;
+        MDCGuard& operator=(const MDCGuard&) = delete;
+    };
+
+    /**
+     * @brief 把数据全部写入fd，被信号中断时重试，出错时放弃剩余部分
+     * @details 只调用write，可以在信号处理函数中使用
+     */
+    void WriteAll(int fd, const char* data, size_t len);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,505 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "src/log.h"
+#include "src/log_escape.h"
+
+using namespace orange;
+
+/**
+ * 日志性能基准
+ * 每个用例先连续执行times次测量吞吐和调用线程的堆分配次数，再逐次计时测量延迟分布。
+ * 字节吞吐按一条代表性记录格式化后的长度估算。
+ * 用法: bench_log [times] [--threads N] [--samples N] [--filter STR] [--dir DIR] [--json FILE]
+ */
+
+// 当前线程的堆分配次数
+static thread_local uint64_t s_alloc_count = 0;
+
+void* operator new(size_t size) {
+    ++s_alloc_count;
+    void* p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    ++s_alloc_count;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+/**
+ * @brief 命令行参数
+ */
+struct BenchOptions {
+    // 每个线程执行的次数，关闭的日志语句执行10倍
+    uint64_t times = 1000000;
+    // 最多测量的线程数
+    int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    // 每个线程逐次计时的次数
+    uint64_t samples = 100000;
+    // 只运行名称包含该字符串的用例
+    std::string filter;
+    // 文件Appender写入的目录
+    std::string dir = "/tmp";
+    // JSON结果输出的文件，为空时不输出
+    std::string json;
+};
+
+/**
+ * @brief 一个用例的测量结果
+ */
+struct BenchResult {
+    std::string name;
+    int threads = 1;
+    uint64_t ops = 0;
+    double ns_per_op = 0;
+    double allocs_per_op = 0;
+    double bytes_per_sec = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+};
+
+static BenchOptions s_options;
+static std::vector<BenchResult> s_results;
+static size_t s_printed = 0;
+// 测量StdoutLogAppneder时标准输出被重定向，结果延后打印
+static bool s_stdout_redirected = false;
+
+// 被求值的流式参数个数，关闭的日志语句不应该求值任何参数
+static uint64_t s_evaluated = 0;
+
+static int expensive(int v) {
+    ++s_evaluated;
+    return v * 2;
+}
+
+static uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief 格式化所有日志但不输出的Appender，测量日志宏和格式化的开销
+ */
+class RenderLogAppender : public LogAppender {
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {}
+};
+
+/**
+ * @brief 在threads个线程中各执行一次cb，只有1个线程时直接在当前线程执行
+ */
+template<class CB>
+static void run_threads(int threads, CB cb) {
+    if(threads == 1) {
+        cb();
+        return;
+    }
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread(cb));
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+}
+
+static void print_results() {
+    for(; s_printed < s_results.size(); ++s_printed) {
+        const BenchResult& r = s_results[s_printed];
+        std::cout << r.name << " threads=" << r.threads << ": " << r.ns_per_op << " ns/op, "
+                  << r.allocs_per_op << " allocs/op, " << r.bytes_per_sec / (1024 * 1024) << " MB/s, "
+                  << "p50=" << r.p50 << " p90=" << r.p90 << " p99=" << r.p99
+                  << " p999=" << r.p999 << " max=" << r.max << " ns" << std::endl;
+    }
+}
+
+/**
+ * @brief 测量一个用例
+ * @param[in] threads 同时执行的线程数
+ * @param[in] times 每个线程执行的次数
+ * @param[in] bytes 每次调用输出的字节数
+ * @param[in] cb 被测量的操作，参数是调用序号
+ * @param[in] finish 所有线程结束后调用，计入吞吐的耗时，用于等待异步写出
+ */
+template<class CB>
+static void bench(const std::string& name, int threads, uint64_t times, size_t bytes
+                  , CB cb, std::function<void()> finish = nullptr) {
+    if(!s_options.filter.empty() && name.find(s_options.filter) == std::string::npos) {
+        return;
+    }
+    BenchResult r;
+    r.name = name;
+    r.threads = threads;
+    r.ops = times * threads;
+
+    std::atomic<uint64_t> allocs(0);
+    uint64_t begin = now_ns();
+    run_threads(threads, [&]() {
+        uint64_t before = s_alloc_count;
+        for(uint64_t i = 0; i < times; ++i) {
+            cb(i);
+            // 阻止编译器把整个循环优化掉
+            asm volatile("" ::: "memory");
+        }
+        allocs += s_alloc_count - before;
+    });
+    if(finish) {
+        finish();
+    }
+    uint64_t elapsed = std::max<uint64_t>(now_ns() - begin, 1);
+    r.ns_per_op = elapsed / (double)times;
+    r.allocs_per_op = allocs / (double)r.ops;
+    r.bytes_per_sec = bytes * (double)r.ops * 1e9 / elapsed;
+
+    // 逐次计时，包含一次读时钟的开销
+    uint64_t samples = std::min(times, s_options.samples);
+    std::vector<std::vector<uint32_t> > latencies(threads);
+    std::atomic<int> next(0);
+    run_threads(threads, [&]() {
+        std::vector<uint32_t>& lat = latencies[next++];
+        lat.resize(samples);
+        for(uint64_t i = 0; i < samples; ++i) {
+            uint64_t t0 = now_ns();
+            cb(i);
+            asm volatile("" ::: "memory");
+            lat[i] = std::min<uint64_t>(now_ns() - t0, UINT32_MAX);
+        }
+    });
+    if(finish) {
+        finish();
+    }
+    std::vector<uint32_t> all;
+    all.reserve(samples * threads);
+    for(auto& i : latencies) {
+        all.insert(all.end(), i.begin(), i.end());
+    }
+    std::sort(all.begin(), all.end());
+    if(!all.empty()) {
+        auto percentile = [&all](double p) -> uint64_t {
+            return all[std::min(all.size() - 1, (size_t)(p * all.size()))];
+        };
+        r.p50 = percentile(0.5);
+        r.p90 = percentile(0.9);
+        r.p99 = percentile(0.99);
+        r.p999 = percentile(0.999);
+        r.max = all.back();
+    }
+
+    s_results.push_back(r);
+    if(!s_stdout_redirected) {
+        print_results();
+    }
+}
+
+/**
+ * @brief 线程数从1开始翻倍直到max_threads，最后一次取max_threads
+ */
+template<class CB>
+static void bench_scaling(const std::string& name, size_t bytes, CB cb, std::function<void()> finish = nullptr) {
+    for(int threads = 1; ; threads = std::min(threads * 2, s_options.max_threads)) {
+        bench(name, threads, s_options.times, bytes, cb, finish);
+        if(threads == s_options.max_threads) {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief 代表性记录格式化后的字节数
+ */
+static size_t record_size(Logger::ptr logger, LogFormater::ptr formater) {
+    LogEvent event(logger, LogLevel::INFO, __FILE__, __LINE__, 0, GetThreadId(), GetFiberId(), 0);
+    event.getStream() << "bench " << s_options.times / 2 << " Hello orange " << "Success";
+    std::string buf;
+    formater->render(buf, event);
+    return buf.size();
+}
+
+static void bench_disabled() {
+    const uint64_t times = s_options.times * 10;
+    Logger::ptr logger(new Logger("bench"));
+    logger->addAppender(LogAppender::ptr(new FileLogAppneder("/dev/null")));
+    logger->setLevel(LogLevel::INFO);
+
+    std::cout << "[Bench disabled log statements] times=" << times << std::endl;
+    bench("empty loop", 1, times, 0, [](uint64_t) {});
+
+// 把编译期最低级别提高到INFO，之后展开的DEBUG语句恒为假
+#pragma push_macro("ORANGE_LOG_MIN_LEVEL")
+#undef ORANGE_LOG_MIN_LEVEL
+#define ORANGE_LOG_MIN_LEVEL 2
+    bench("compile-time disabled", 1, times, 0, [&](uint64_t i) {
+        ORANGE_LOG_DEBUG(logger) << "disabled " << expensive(i);
+        ORANGE_LOG_FMT_DEBUG(logger, "disabled %d", expensive(i));
+    });
+#pragma pop_macro("ORANGE_LOG_MIN_LEVEL")
+
+    bench("runtime disabled", 1, times, 0, [&](uint64_t i) {
+        ORANGE_LOG_DEBUG(logger) << "disabled " << expensive(i);
+        ORANGE_LOG_FMT_DEBUG(logger, "disabled %d", expensive(i));
+    });
+
+    LoggerMgrPtr::GetInstance()->getLogger("bench.net.http")->setLevel(LogLevel::INFO);
+    bench("runtime disabled by name", 1, times / 10, 0, [&](uint64_t i) {
+        ORANGE_LOG_DEBUG(ORANGE_LOG_NAME("bench.net.http")) << "disabled " << expensive(i);
+    });
+    bench("runtime disabled by cached name", 1, times, 0, [&](uint64_t i) {
+        ORANGE_LOG_DEBUG(ORANGE_LOG_NAME_CACHED("bench.net.http")) << "disabled " << expensive(i);
+    });
+}
+
+static void bench_clock() {
+    const uint64_t times = s_options.times * 10;
+    std::cout << "[Bench clock] times=" << times << std::endl;
+    bench("clock_gettime(CLOCK_REALTIME)", 1, times, 0, [](uint64_t) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+    });
+    Clock::Source origin = Clock::GetSource();
+    Clock::Source sources[] = {Clock::TSC, Clock::MONOTONIC, Clock::MONOTONIC_COARSE};
+    for(auto source : sources) {
+        if(!Clock::SetSource(source)) {
+            continue;
+        }
+        bench(std::string("Clock::WallNS ") + Clock::ToString(source), 1, times, 0, [](uint64_t) {
+            Clock::WallNS();
+        });
+    }
+    Clock::SetSource(origin);
+}
+
+static void bench_macros() {
+    std::cout << "[Bench log macros] times=" << s_options.times << std::endl;
+    Logger::ptr logger(new Logger("bench"));
+    LogAppender::ptr appender(new RenderLogAppender);
+    logger->addAppender(appender);
+    logger->setLevel(LogLevel::INFO);
+    size_t bytes = record_size(logger, appender->getFormater());
+
+    bench_scaling("stream macro", bytes, [&](uint64_t i) {
+        ORANGE_LOG_INFO(logger) << "bench " << i << " Hello orange " << "Success";
+    });
+    bench_scaling("printf macro", bytes, [&](uint64_t i) {
+        ORANGE_LOG_FMT_INFO(logger, "bench %lu Hello orange %s", (unsigned long)i, "Success");
+    });
+    bench_scaling("brace format macro", bytes, [&](uint64_t i) {
+        ORANGE_LOG_FORMAT_INFO(logger, "bench {} Hello orange {}", i, "Success");
+    });
+}
+
+static void bench_format_items() {
+    std::cout << "[Bench format items] times=" << s_options.times << std::endl;
+    static const char* patterns[] = {
+        "%m", "%p", "%r", "%c", "%t", "%n", "%d", "%f", "%l", "%F", "%T", "%ms", "%us", "%ns", "%K", "%N", "%X",
+        "%d{%Y-%m-%d %H:%M:%S}",
+        "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n",
+        "json",
+        "logfmt"
+    };
+    Logger::ptr logger(new Logger("bench"));
+    LogEvent event(logger, LogLevel::INFO, __FILE__, __LINE__, 0, GetThreadId(), GetFiberId(), 0);
+    event.getStream() << "bench 500000 Hello orange Success" << LogKv("status", 200) << LogKv("path", "/api/v1");
+    for(auto pattern : patterns) {
+        LogFormater::ptr formater(new LogFormater(pattern));
+        std::string buf;
+        formater->render(buf, event);
+        bench(std::string("format ") + pattern, 1, s_options.times, buf.size(), [&](uint64_t) {
+            buf.clear();
+            formater->render(buf, event);
+        });
+    }
+}
+
+/**
+ * @brief 用appender测量printf风格的日志
+ */
+static void bench_appender(const std::string& name, LogAppender::ptr appender) {
+    Logger::ptr logger(new Logger("bench"));
+    logger->addAppender(appender);
+    size_t bytes = record_size(logger, appender->getFormater());
+    bench_scaling(name, bytes, [&](uint64_t i) {
+        ORANGE_LOG_FMT_INFO(logger, "bench %lu Hello orange %s", (unsigned long)i, "Success");
+    }, [&]() {
+        appender->flush();
+    });
+}
+
+static void bench_appenders() {
+    std::cout << "[Bench appenders] times=" << s_options.times << " dir=" << s_options.dir << std::endl;
+
+    // 标准输出重定向到/dev/null，结果在恢复之后打印
+    std::cout.flush();
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    s_stdout_redirected = true;
+    bench_appender("stdout appender", LogAppender::ptr(new StdoutLogAppneder));
+    std::cout.flush();
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    s_stdout_redirected = false;
+    print_results();
+
+    std::string file = s_options.dir + "/orange_bench_file.log";
+    bench_appender("file appender", LogAppender::ptr(new FileLogAppneder(file)));
+    unlink(file.c_str());
+
+    // 常见配置：同一个日志器输出到两个文件，两者共用一次格式化
+    {
+        std::string second = s_options.dir + "/orange_bench_file2.log";
+        Logger::ptr logger(new Logger("bench"));
+        LogAppender::ptr first_appender(new FileLogAppneder(file));
+        LogAppender::ptr second_appender(new FileLogAppneder(second));
+        logger->addAppender(first_appender);
+        logger->addAppender(second_appender);
+        size_t bytes = record_size(logger, first_appender->getFormater());
+        bench_scaling("two file appenders", bytes * 2, [&](uint64_t i) {
+            ORANGE_LOG_FMT_INFO(logger, "bench %lu Hello orange %s", (unsigned long)i, "Success");
+        }, [&]() {
+            first_appender->flush();
+            second_appender->flush();
+        });
+        unlink(file.c_str());
+        unlink(second.c_str());
+    }
+
+    std::string async_file = s_options.dir + "/orange_bench_async.log";
+    FileLogAppneder::ptr async_appender(new FileLogAppneder(async_file));
+    async_appender->setAsync(AsyncLogWriter::Config());
+    bench_appender("file appender async", async_appender);
+    async_appender.reset();
+    unlink(async_file.c_str());
+
+    std::string sharded_file = s_options.dir + "/orange_bench_sharded.log";
+    FileLogAppneder::ptr sharded_appender(new FileLogAppneder(sharded_file));
+    sharded_appender->setSharded(ShardedLogWriter::Config());
+    bench_appender("file appender sharded", sharded_appender);
+    sharded_appender.reset();
+    unlink(sharded_file.c_str());
+
+    std::string rolling_file = s_options.dir + "/orange_bench_rolling.log";
+    RollingFileLogAppender::Config rolling_config;
+    rolling_config.max_size = 0;
+    bench_appender("rolling file appender", LogAppender::ptr(new RollingFileLogAppender(rolling_file, rolling_config)));
+    unlink(rolling_file.c_str());
+
+    std::string mmap_file = s_options.dir + "/orange_bench_mmap.log";
+    bench_appender("mmap file appender", LogAppender::ptr(new MmapFileLogAppender(mmap_file)));
+    unlink(mmap_file.c_str());
+}
+
+/**
+ * @brief 输出JSON结果，便于比较不同提交的测量结果
+ */
+static bool write_json(const std::string& path) {
+    std::string buf = "{\n";
+    buf += "  \"times\": " + std::to_string(s_options.times) + ",\n";
+    buf += "  \"samples\": " + std::to_string(s_options.samples) + ",\n";
+    buf += "  \"max_threads\": " + std::to_string(s_options.max_threads) + ",\n";
+    buf += "  \"cores\": " + std::to_string(std::thread::hardware_concurrency()) + ",\n";
+    buf += "  \"min_level\": " + std::to_string(ORANGE_LOG_MIN_LEVEL) + ",\n";
+    buf += "  \"results\": [";
+    for(size_t i = 0; i < s_results.size(); ++i) {
+        const BenchResult& r = s_results[i];
+        buf += i ? ",\n    {" : "\n    {";
+        buf += "\"name\": \"";
+        AppendJsonEscaped(buf, r.name.c_str(), r.name.size());
+        buf += "\", \"threads\": " + std::to_string(r.threads);
+        buf += ", \"ops\": " + std::to_string(r.ops);
+        buf += ", \"ns_per_op\": " + std::to_string(r.ns_per_op);
+        buf += ", \"allocs_per_op\": " + std::to_string(r.allocs_per_op);
+        buf += ", \"bytes_per_sec\": " + std::to_string(r.bytes_per_sec);
+        buf += ", \"p50_ns\": " + std::to_string(r.p50);
+        buf += ", \"p90_ns\": " + std::to_string(r.p90);
+        buf += ", \"p99_ns\": " + std::to_string(r.p99);
+        buf += ", \"p999_ns\": " + std::to_string(r.p999);
+        buf += ", \"max_ns\": " + std::to_string(r.max) + "}";
+    }
+    buf += "\n  ]\n}\n";
+
+    std::ofstream ofs(path);
+    ofs << buf;
+    return !!ofs;
+}
+
+int main(int argc, char** argv) {
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--threads" && i + 1 < argc) {
+            s_options.max_threads = std::max(1, std::stoi(argv[++i]));
+        } else if(arg == "--samples" && i + 1 < argc) {
+            s_options.samples = std::stoull(argv[++i]);
+        } else if(arg == "--filter" && i + 1 < argc) {
+            s_options.filter = argv[++i];
+        } else if(arg == "--dir" && i + 1 < argc) {
+            s_options.dir = argv[++i];
+        } else if(arg == "--json" && i + 1 < argc) {
+            s_options.json = argv[++i];
+        } else if(!arg.empty() && isdigit(arg[0])) {
+            s_options.times = std::stoull(arg);
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [times] [--threads N] [--samples N] [--filter STR] [--dir DIR] [--json FILE]" << std::endl;
+            return 2;
+        }
+    }
+
+    bench_clock();
+    bench_disabled();
+    bench_macros();
+    bench_format_items();
+    bench_appenders();
+
+    std::cout << "evaluated arguments: " << s_evaluated << std::endl;
+    if(!s_options.json.empty()) {
+        if(!write_json(s_options.json)) {
+            std::cerr << "write " << s_options.json << " failed" << std::endl;
+            return 1;
+        }
+        std::cout << "results written to " << s_options.json << std::endl;
+    }
+    return s_evaluated == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <unistd.h>
+#include "src/log.h"
+
+using namespace orange;
+
+/**
+ * @brief 用appender写times条日志，输出每条的平均耗时(纳秒)
+ */
+static void bench(const std::string& name, LogAppender::ptr appender, uint64_t times) {
+    Logger::ptr logger(new Logger("bench"));
+    logger->addAppender(appender);
+    auto begin = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < times; ++i) {
+        ORANGE_LOG_FMT_INFO(logger, "bench appender %lu Hello orange %s", (unsigned long)i, "Success");
+    }
+    appender->flush();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (double)times;
+    std::cout << name << ": " << ns << " ns/op" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    const uint64_t times = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    const std::string dir = argc > 2 ? argv[2] : "/tmp";
+
+    std::cout << "[Bench file appenders] times=" << times << " dir=" << dir << std::endl;
+    std::string file = dir + "/orange_bench_file.log";
+    bench("FileLogAppneder", LogAppender::ptr(new FileLogAppneder(file)), times);
+    unlink(file.c_str());
+
+    std::string async_file = dir + "/orange_bench_async.log";
+    FileLogAppneder::ptr async_appender(new FileLogAppneder(async_file));
+    async_appender->setAsync(AsyncLogWriter::Config());
+    bench("FileLogAppneder async", async_appender, times);
+    async_appender.reset();
+    unlink(async_file.c_str());
+
+    std::string rolling_file = dir + "/orange_bench_rolling.log";
+    RollingFileLogAppender::Config rolling_config;
+    rolling_config.max_size = 0;
+    bench("RollingFileLogAppender", LogAppender::ptr(new RollingFileLogAppender(rolling_file, rolling_config)), times);
+    unlink(rolling_file.c_str());
+
+    std::string mmap_file = dir + "/orange_bench_mmap.log";
+    bench("MmapFileLogAppender", LogAppender::ptr(new MmapFileLogAppender(mmap_file)), times);
+    unlink(mmap_file.c_str());
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "src/log.h"
+
+using namespace orange;
+
+/**
+ * @brief 什么也不做的Appender，只测量Logger本身的开销
+ */
+class NullLogAppender : public LogAppender {
+public:
+    void log(LogLevel::Level level, const LogEvent& event) override {}
+protected:
+    // 不格式化，log() 直接返回，不会调用到这里
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {}
+};
+
+/**
+ * @brief threads个线程各写times条日志，返回总吞吐(条/秒)
+ */
+static double bench(Logger::ptr logger, int threads, uint64_t times) {
+    std::vector<std::thread> workers;
+    auto begin = std::chrono::steady_clock::now();
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([logger, times]() {
+            for(uint64_t i = 0; i < times; ++i) {
+                ORANGE_LOG_INFO(logger) << "bench " << i;
+            }
+        }));
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+    auto end = std::chrono::steady_clock::now();
+    double sec = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1e9;
+    return threads * times / sec;
+}
+
+/**
+ * @brief 对同一个日志器从1到max_threads个线程逐一测量
+ */
+static void bench_scaling(const std::string& name, Logger::ptr logger, int max_threads, uint64_t times) {
+    std::cout << "[" << name << "]" << std::endl;
+    double base = 0;
+    for(int threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+        double ops = bench(logger, threads, times);
+        if(threads == 1) {
+            base = ops;
+        }
+        std::cout << "threads=" << threads << ": " << (uint64_t)ops << " ops/s, speedup "
+                  << ops / base << std::endl;
+        if(threads >= max_threads) {
+            break;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    const int max_threads = argc > 1 ? std::stoi(argv[1]) : std::thread::hardware_concurrency();
+    const uint64_t times = argc > 2 ? std::stoull(argv[2]) : 1000000;
+
+    std::cout << "[Bench logger thread scaling] times=" << times << std::endl;
+    Logger::ptr logger(new Logger("bench"));
+    logger->addAppender(LogAppender::ptr(new NullLogAppender));
+    logger->setLevel(LogLevel::INFO);
+    bench_scaling("null appender", logger, max_threads, times);
+
+    Logger::ptr async_logger(new Logger("bench_async"));
+    FileLogAppneder::ptr async_appender(new FileLogAppneder("/dev/null"));
+    async_appender->setAsync(AsyncLogWriter::Config());
+    async_logger->addAppender(async_appender);
+    async_logger->setLevel(LogLevel::INFO);
+    bench_scaling("async file appender", async_logger, max_threads, times);
+
+    Logger::ptr sharded_logger(new Logger("bench_sharded"));
+    FileLogAppneder::ptr sharded_appender(new FileLogAppneder("/dev/null"));
+    sharded_appender->setSharded(ShardedLogWriter::Config());
+    sharded_logger->addAppender(sharded_appender);
+    sharded_logger->setLevel(LogLevel::INFO);
+    bench_scaling("sharded file appender", sharded_logger, max_threads, times);
+    return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef __ORANGE_TESTS_STRING_LOG_APPENDER_H__
+#define __ORANGE_TESTS_STRING_LOG_APPENDER_H__
+
+#include <string>
+#include <mutex>
+#include "src/log.h"
+
+namespace orange {
+
+/**
+ * @brief 把格式化结果保存在内存中的Appender，测试用
+ * @details 经过 renderAppend() 的级别和过滤器检查，可以在多个线程中使用
+ */
+class StringLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<StringLogAppender> ptr;
+
+    void logRendered(LogLevel::Level level, const LogEvent& event, LogRenderCache& cache) override {
+        renderAppend(level, event, cache);
+    }
+
+    /**
+     * @brief 取出保存的内容并清空
+     */
+    std::string take() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        std::string str;
+        str.swap(m_str);
+        return str;
+    }
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_str.append(data, len);
+    }
+private:
+    std::mutex m_mutex;
+    std::string m_str;
+};
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "src/binlog.h"
+
+using namespace orange;
+
+int main(int argc, char** argv) {
+    Logger::ptr logger(new Logger("binlog"));
+    logger->addAppender(LogAppender::ptr(new StdoutLogAppneder()));
+
+    std::cout << "[Test binlog]" << std::endl;
+    std::cout << "1.Test fallback to text log" << std::endl;
+    ORANGE_LOG_BIN_INFO(logger, "fallback %d %s %.2f", 1, std::string("Success"), 3.14159);
+
+    std::cout << "2.Test binary log" << std::endl;
+    BinLogMgr::GetInstance()->open("./binlog.blog", 4096);
+    const int threads = 4;
+    const int times = 1000;
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&logger, t]() {
+            for(int i = 0; i < times; ++i) {
+                ORANGE_LOG_BIN_INFO(logger, "thread=%d i=%5d name=%s ratio=%.3f u=%lu c=%c", t, i,
+                                    "orange", i / 3.0, (unsigned long)i * 2, 'a' + i % 26);
+            }
+        }));
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+    ORANGE_LOG_BIN_DEBUG(logger, "string %s ptr %p", std::string("Success"), (void*)logger.get());
+    BinLogMgr::GetInstance()->close();
+
+    BinLogReader reader;
+    if(!reader.open("./binlog.blog")) {
+        std::cout << "open binlog.blog failed" << std::endl;
+        return 1;
+    }
+    LogFormater formater("%p %c %m%n");
+    std::string buf;
+    int count = 0;
+    const LogEvent* event = nullptr;
+    while((event = reader.next())) {
+        if(count < 3 || event->getLevel() == LogLevel::DEBUG) {
+            buf.clear();
+            formater.render(buf, *event);
+            std::cout << buf;
+        }
+        ++count;
+    }
+    std::cout << "decoded " << count << " records, expected " << threads * times + 1
+              << ", dropped " << BinLogMgr::GetInstance()->getDropped() << std::endl;
+    return count == threads * times + 1 ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <time.h>
+#include "src/log.h"
+
+using namespace orange;
+
+static uint64_t realtimeNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * @brief 多个线程连续读时钟，检查不回退
+ */
+static bool checkMonotonic(uint64_t duration_ms) {
+    std::vector<std::thread> workers;
+    std::vector<int> backwards(4, 0);
+    for(size_t t = 0; t < backwards.size(); ++t) {
+        workers.push_back(std::thread([t, duration_ms, &backwards]() {
+            uint64_t end = Clock::NowNS() + duration_ms * 1000000;
+            uint64_t last = 0;
+            while(last < end) {
+                uint64_t now = Clock::NowNS();
+                if(now < last) {
+                    ++backwards[t];
+                }
+                last = now;
+            }
+        }));
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+    int total = 0;
+    for(auto i : backwards) {
+        total += i;
+    }
+    std::cout << "backwards=" << total << std::endl;
+    return total == 0;
+}
+
+/**
+ * @brief 墙上时间和CLOCK_REALTIME的差，COARSE来源允许落后一个时钟节拍
+ */
+static bool checkWall() {
+    int64_t diff = (int64_t)(Clock::WallNS() - realtimeNS());
+    int64_t tolerance = 1000000;
+    if(Clock::GetSource() == Clock::MONOTONIC_COARSE) {
+        struct timespec res;
+        clock_getres(CLOCK_MONOTONIC_COARSE, &res);
+        tolerance += res.tv_sec * 1000000000ll + res.tv_nsec;
+    }
+    std::cout << "wall diff=" << diff << "ns" << std::endl;
+    return diff < 1000000 && diff > -tolerance;
+}
+
+static double costNS(uint64_t (*fn)()) {
+    const int times = 1000000;
+    uint64_t sum = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < times; ++i) {
+        sum += fn();
+    }
+    auto end = std::chrono::steady_clock::now();
+    // 防止循环被优化掉
+    if(sum == 1) {
+        std::cout << sum;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (double)times;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test clock]" << std::endl;
+    std::cout << "source=" << Clock::ToString(Clock::GetSource()) << std::endl;
+
+    std::cout << "1.Test monotonic across resync" << std::endl;
+    ok = checkMonotonic(1500) && ok;
+
+    std::cout << "2.Test wall time" << std::endl;
+    ok = checkWall() && ok;
+
+    std::cout << "3.Test %r elapsed" << std::endl;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Logger::ptr logger(new Logger("clock"));
+    LogEvent::ptr event(new LogEvent(logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0));
+    std::string elapse = LogFormater("%r").format(event);
+    uint64_t expect = Clock::ElapsedNS() / 1000000;
+    std::cout << "elapse=" << elapse << " expect=" << expect << std::endl;
+    ok = ok && event->getElapse() >= 20 && event->getElapse() <= expect
+            && elapse == std::to_string(event->getElapse());
+    int64_t diff = (int64_t)(event->getTimeNS() - realtimeNS());
+    ok = ok && diff < 1000000 && diff > -1000000;
+
+    std::cout << "4.Test switch source" << std::endl;
+    Clock::Source sources[] = {Clock::MONOTONIC_COARSE, Clock::MONOTONIC, Clock::TSC};
+    for(auto source : sources) {
+        bool set = Clock::SetSource(source);
+        std::cout << Clock::ToString(source) << ": set=" << set;
+        if(set) {
+            std::cout << " cost=" << costNS(Clock::NowNS) << "ns" << std::endl;
+            ok = ok && Clock::GetSource() == source && checkMonotonic(100) && checkWall();
+        } else {
+            std::cout << std::endl;
+            ok = ok && source == Clock::TSC;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -161,6 +161,18 @@ void test_class(){
     }
 }
 
+void test_log() {
+    static orange::Logger::ptr system_log = ORANGE_LOG_NAME("system");
+    ORANGE_LOG_INFO(system_log) << "before load log config";
+    std::cout << "log config before: " << Config::LookupBase("log")->toString() << std::endl;
+    YAML::Node root = YAML::LoadFile("./config/log.yaml");
+    Config::LoadFromTaml(root);
+    std::cout << "log config after: " << Config::LookupBase("log")->toString() << std::endl;
+    system_log = ORANGE_LOG_NAME("system");
+    ORANGE_LOG_INFO(system_log) << "after load log config";
+    ORANGE_LOG_INFO(ORANGE_LOG_ROOT()) << "root after load log config";
+}
+
 int main(int argc, char** argv){
 
     ORANGE_LOG_INFO(ORANGE_LOG_ROOT()) << g_int_value_config->getValue();
@@ -179,6 +191,7 @@ int main(int argc, char** argv){
     tes_yaml();
     test_config();
     test_class();
+    test_log();
 
     return 0;
 }
\ No newline at end of file
@@ -1,11 +1,48 @@
 #include<iostream>
 #include<thread>
+#include<vector>
+#include<fstream>
+#include<chrono>
+#include<atomic>
+#include<string>
+#include<cstdio>
+#include<cstdlib>
 #include "src/log.h"
 #include "src/util.h"
 
 using namespace orange;
 
+/**
+ * @brief 按顺序取出文件中每行tag之后的序号，没有序号的行记为-1
+ */
+static std::vector<int> read_numbers(const std::string& file, const std::string& tag) {
+    std::ifstream is(file);
+    std::string line;
+    std::vector<int> numbers;
+    while(std::getline(is, line)) {
+        size_t pos = line.find(tag + " ");
+        const char* begin = pos == std::string::npos ? "" : line.c_str() + pos + tag.size() + 1;
+        char* end = nullptr;
+        long n = strtol(begin, &end, 10);
+        numbers.push_back(end == begin ? -1 : (int)n);
+    }
+    return numbers;
+}
+
+/**
+ * @brief numbers是否为从first开始的连续序号
+ */
+static bool is_sequence(const std::vector<int>& numbers, int first) {
+    for(size_t i = 0; i < numbers.size(); ++i) {
+        if(numbers[i] != first + (int)i) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char** argv){
+    bool ok = true;
 
     Logger::ptr logger(new Logger());
     logger->addAppender(LogAppender::ptr(new StdoutLogAppneder()));
@@ -34,5 +71,297 @@ int main(int argc, char** argv){
     auto l = LoggerMgrPtr::GetInstance()->getLogger("xx");
     ORANGE_LOG_FATAL(l) << "Test LoggerManager Success";
 
-    return 0;
+    std::cout << "3.Test async file Log" << std::endl;
+    remove("./async_log.txt");
+    Logger::ptr asyncLogger(new Logger());
+    FileLogAppneder::ptr asyncAppender(new FileLogAppneder("./async_log.txt"));
+    AsyncLogWriter::Config config;
+    config.buffer_size = 4096;
+    config.buffer_count = 2;
+    config.policy = AsyncLogWriter::BLOCK;
+    asyncAppender->setAsync(config);
+    asyncLogger->addAppender(asyncAppender);
+    for(int i = 0; i < 1000; ++i) {
+        ORANGE_LOG_FMT_INFO(asyncLogger, "ASYNC %d Hello orange %s", i, "Success");
+    }
+    // flush()返回时之前的日志都已经写入文件
+    asyncAppender->flush();
+    std::vector<int> async_numbers = read_numbers("./async_log.txt", "ASYNC");
+    std::cout << "async lines=" << async_numbers.size() << " dropped=" << asyncAppender->getDropped() << std::endl;
+    ok = ok && asyncAppender->getDropped() == 0 && async_numbers.size() == 1000
+            && is_sequence(async_numbers, 0);
+    {
+        // 后台线程正在写的批次也计入积压，超长日志同样受限
+        std::atomic<uint64_t> written(0);
+        AsyncLogWriter::Config bound_config;
+        bound_config.buffer_size = 1024;
+        bound_config.buffer_count = 2;
+        bound_config.policy = AsyncLogWriter::DROP_NEWEST;
+        AsyncLogWriter writer([&written](const char* data, size_t len) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            written += len;
+        }, nullptr, bound_config);
+        std::string record(100, 'x');
+        std::string huge(4096, 'y');
+        for(int i = 0; i < 200; ++i) {
+            writer.append(record.c_str(), record.size());
+            if(i % 50 == 0) {
+                writer.append(huge.c_str(), huge.size());
+            }
+        }
+        writer.flush();
+        uint64_t high = writer.getHighWater();
+        std::cout << "async bound high water=" << high << " dropped=" << writer.getDropped()
+                  << " written=" << written << std::endl;
+        ok = ok && high <= 3 * 1024 && writer.getDropped() >= 4
+                && written + (writer.getDropped() - 4) * record.size() == 200 * record.size();
+    }
+    {
+        // 放得下的超长日志在BLOCK模式下等待积压写完，不丢弃
+        std::atomic<uint64_t> written(0);
+        AsyncLogWriter::Config block_config;
+        block_config.buffer_size = 1024;
+        block_config.buffer_count = 2;
+        AsyncLogWriter writer([&written](const char* data, size_t len) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            written += len;
+        }, nullptr, block_config);
+        std::string record(100, 'x');
+        std::string big(2048, 'y');
+        for(int i = 0; i < 100; ++i) {
+            writer.append(record.c_str(), record.size());
+            if(i % 25 == 0) {
+                writer.append(big.c_str(), big.size());
+            }
+        }
+        writer.flush();
+        std::cout << "async block written=" << written << " high water=" << writer.getHighWater() << std::endl;
+        ok = ok && writer.getDropped() == 0 && written == 100 * record.size() + 4 * big.size()
+                && writer.getHighWater() <= 3 * 1024;
+    }
+
+    std::cout << "4.Test sharded file Log" << std::endl;
+    remove("./sharded_log.txt");
+    Logger::ptr shardedLogger(new Logger());
+    FileLogAppneder::ptr shardedAppender(new FileLogAppneder("./sharded_log.txt"));
+    ShardedLogWriter::Config sharded_config;
+    sharded_config.ring_size = 4096;
+    shardedAppender->setSharded(sharded_config);
+    shardedLogger->addAppender(shardedAppender);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([shardedLogger, t]() {
+            for(int i = 0; i < 1000; ++i) {
+                ORANGE_LOG_FMT_INFO(shardedLogger, "SHARDED %d-%d Hello orange %s", t, i, "Success");
+            }
+        }));
+    }
+    for(auto& i : threads) {
+        i.join();
+    }
+    shardedAppender->flush();
+    std::ifstream sharded_file("./sharded_log.txt");
+    std::string line;
+    int lines = 0;
+    // 各线程之间交错，同一个线程的日志保持顺序
+    std::vector<int> sharded_next(4, 0);
+    bool sharded_order = true;
+    while(std::getline(sharded_file, line)) {
+        ++lines;
+        int t = -1;
+        int i = -1;
+        size_t pos = line.find("SHARDED ");
+        if(pos == std::string::npos || sscanf(line.c_str() + pos, "SHARDED %d-%d", &t, &i) != 2
+                || t < 0 || t >= 4 || sharded_next[t]++ != i) {
+            sharded_order = false;
+        }
+    }
+    std::cout << "sharded lines=" << lines << " dropped=" << shardedAppender->getDropped()
+              << " order=" << sharded_order << std::endl;
+    ok = ok && lines == 4000 && shardedAppender->getDropped() == 0 && sharded_order;
+
+    std::cout << "5.Test rolling file Log" << std::endl;
+    remove("./rolling_log.txt");
+    remove("./rolling_idle_log.txt");
+    Logger::ptr rollingLogger(new Logger());
+    RollingFileLogAppender::Config rolling_config;
+    rolling_config.max_size = 16 * 1024;
+    rolling_config.max_files = 3;
+    rolling_config.buffer_size = 4096;
+    rolling_config.preallocate = 16 * 1024;
+    RollingFileLogAppender::ptr rollingAppender(new RollingFileLogAppender("./rolling_log.txt", rolling_config));
+    rollingLogger->addAppender(rollingAppender);
+    for(int i = 0; i < 1000; ++i) {
+        ORANGE_LOG_FMT_INFO(rollingLogger, "ROLLING %d Hello orange %s", i, "Success");
+    }
+    rollingAppender->flush();
+    // 当前文件是最后一次滚动之后写入的部分，不超过大小上限
+    std::vector<int> rolling_numbers = read_numbers("./rolling_log.txt", "ROLLING");
+    std::ifstream rolling_file("./rolling_log.txt", std::ios::ate);
+    uint64_t rolling_size = rolling_file.tellg();
+    std::cout << "rolling current lines=" << rolling_numbers.size() << " size=" << rolling_size
+              << ", see rolling_log.txt*" << std::endl;
+    ok = ok && !rolling_numbers.empty() && rolling_numbers.size() < 1000
+            && rolling_size < rolling_config.max_size
+            && is_sequence(rolling_numbers, 1000 - (int)rolling_numbers.size());
+    {
+        // 没有新日志时由公共刷新线程按flush_interval写出缓冲区
+        RollingFileLogAppender::Config idle_config;
+        idle_config.flush_interval = 50;
+        RollingFileLogAppender::ptr idleAppender(new RollingFileLogAppender("./rolling_idle_log.txt", idle_config));
+        Logger::ptr idleLogger(new Logger());
+        idleLogger->addAppender(idleAppender);
+        for(int i = 0; i < 10; ++i) {
+            ORANGE_LOG_FMT_INFO(idleLogger, "IDLE %d", i);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        std::ifstream idle_file("./rolling_idle_log.txt");
+        int idle_lines = 0;
+        while(std::getline(idle_file, line)) {
+            ++idle_lines;
+        }
+        std::cout << "idle flushed lines=" << idle_lines << std::endl;
+        ok = ok && idle_lines == 10;
+    }
+
+    std::cout << "6.Test mmap file Log" << std::endl;
+    remove("./mmap_log.txt");
+    {
+        Logger::ptr mmapLogger(new Logger());
+        MmapFileLogAppender::Config mmap_config;
+        mmap_config.segment_size = 4096;
+        MmapFileLogAppender::ptr mmapAppender(new MmapFileLogAppender("./mmap_log.txt", mmap_config));
+        mmapLogger->addAppender(mmapAppender);
+        for(int i = 0; i < 1000; ++i) {
+            ORANGE_LOG_FMT_INFO(mmapLogger, "MMAP %d Hello orange %s", i, "Success");
+        }
+        ORANGE_LOG_FMT_ERROR(mmapLogger, "MMAP %s", "synced");
+    }
+    // 关闭时截断到实际长度，文件末尾没有空洞
+    std::vector<int> mmap_numbers = read_numbers("./mmap_log.txt", "MMAP");
+    std::cout << "mmap lines=" << mmap_numbers.size() << std::endl;
+    ok = ok && mmap_numbers.size() == 1001
+            && is_sequence(std::vector<int>(mmap_numbers.begin(), mmap_numbers.end() - 1), 0)
+            && mmap_numbers.back() == -1;
+
+    std::cout << "7.Test logger hierarchy" << std::endl;
+    Logger::ptr net = LoggerMgrPtr::GetInstance()->getLogger("net");
+    net->setLevel(LogLevel::WARN);
+    Logger::ptr server = LoggerMgrPtr::GetInstance()->getLogger("net.http.server");
+    Logger* cached = ORANGE_LOG_NAME_CACHED("net.http.server");
+    ORANGE_LOG_INFO(cached) << "INFO net.http.server should be filtered";
+    ORANGE_LOG_WARN(cached) << "WARN net.http.server inherits root appenders";
+    bool inherit_warn = !cached->isEnabled(LogLevel::INFO) && cached->isEnabled(LogLevel::WARN);
+    net->setLevel(LogLevel::DEBUG);
+    ORANGE_LOG_INFO(cached) << "INFO net.http.server enabled by parent";
+    bool parent = LoggerMgrPtr::GetInstance()->getLogger("net.http")->getLevel() == LogLevel::DEBUG;
+    std::cout << "level=" << LogLevel::toString(server->getLevel())
+              << " same=" << (cached == server.get())
+              << " parent=" << parent
+              << std::endl;
+    ok = ok && inherit_warn && cached == server.get() && parent
+            && server->getLevel() == LogLevel::DEBUG && cached->isEnabled(LogLevel::INFO);
+    // 同名注册不替换节点，缓存的句柄看到新的配置
+    Logger::ptr replacement(new Logger("net.http.server"));
+    replacement->setLevel(LogLevel::ERROR);
+    Logger::ptr registered = LoggerMgrPtr::GetInstance()->addLogger(replacement);
+    std::cout << "re-register same=" << (registered == server)
+              << " level=" << LogLevel::toString(cached->getLevel()) << std::endl;
+    ok = ok && registered == server && cached->getLevel() == LogLevel::ERROR
+            && LoggerMgrPtr::GetInstance()->getLogger("net.http.server") == server;
+    server->setLevel(LogLevel::UNKNOWN);
+
+    std::cout << "8.Test flush policy" << std::endl;
+    auto count_lines = [](const std::string& file) {
+        std::ifstream is(file);
+        std::string str;
+        int n = 0;
+        while(std::getline(is, str)) {
+            ++n;
+        }
+        return n;
+    };
+    remove("./flush_log.txt");
+    Logger::ptr flushLogger(new Logger());
+    FileLogAppneder::ptr flushAppender(new FileLogAppneder("./flush_log.txt"));
+    LogFlushPolicy policy;
+    policy.records = 10;
+    policy.level = LogLevel::ERROR;
+    flushAppender->setFlushPolicy(policy);
+    flushLogger->addAppender(flushAppender);
+    for(int i = 0; i < 25; ++i) {
+        ORANGE_LOG_FMT_INFO(flushLogger, "FLUSH %d Hello orange %s", i, "Success");
+    }
+    int by_records = count_lines("./flush_log.txt");
+    ORANGE_LOG_ERROR(flushLogger) << "FLUSH ERROR Hello orange Success";
+    int by_level = count_lines("./flush_log.txt");
+    policy = LogFlushPolicy();
+    policy.interval = 50;
+    flushAppender->setFlushPolicy(policy);
+    for(int i = 0; i < 3; ++i) {
+        ORANGE_LOG_FMT_INFO(flushLogger, "FLUSH TIMER %d Hello orange %s", i, "Success");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    int by_interval = count_lines("./flush_log.txt");
+    std::cout << "records=" << by_records << " level=" << by_level
+              << " interval=" << by_interval << std::endl;
+    // 每10条刷新一次，ERROR立即刷新，定时刷新写出剩余的3条
+    ok = ok && by_records == 20 && by_level == 26 && by_interval == 29;
+
+    // 异步模式下满足刷新条件只通知后台线程，不等待写完
+    remove("./flush_async_log.txt");
+    FileLogAppneder::ptr flushAsync(new FileLogAppneder("./flush_async_log.txt"));
+    AsyncLogWriter::Config flush_async_config;
+    flush_async_config.flush_interval = 60000;
+    flushAsync->setAsync(flush_async_config);
+    policy = LogFlushPolicy();
+    policy.level = LogLevel::ERROR;
+    flushAsync->setFlushPolicy(policy);
+    flushLogger->setAppenders(std::vector<LogAppender::ptr>(1, flushAsync));
+    ORANGE_LOG_ERROR(flushLogger) << "FLUSH ASYNC ERROR Hello orange Success";
+    int async_lines = 0;
+    for(int i = 0; i < 100 && !async_lines; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        async_lines = count_lines("./flush_async_log.txt");
+    }
+    std::cout << "async requested flush=" << async_lines << std::endl;
+    ok = ok && async_lines == 1;
+    flushLogger->setAppenders(std::vector<LogAppender::ptr>());
+
+    std::cout << "9.Test shared formatting" << std::endl;
+    remove("./shared_a_log.txt");
+    remove("./shared_b_log.txt");
+    remove("./shared_c_log.txt");
+    {
+        Logger::ptr sharedLogger(new Logger());
+        FileLogAppneder::ptr a(new FileLogAppneder("./shared_a_log.txt"));
+        FileLogAppneder::ptr b(new FileLogAppneder("./shared_b_log.txt"));
+        FileLogAppneder::ptr c(new FileLogAppneder("./shared_c_log.txt"));
+        c->setFormater(LogFormater::ptr(new LogFormater("%p %m%n")));
+        sharedLogger->addAppender(a);
+        sharedLogger->addAppender(c);
+        sharedLogger->addAppender(b);
+        for(int i = 0; i < 1000; ++i) {
+            ORANGE_LOG_FMT_INFO(sharedLogger, "SHARED %d Hello orange %s", i, "Success");
+        }
+        // b和a使用同一个格式器，不再格式化
+        uint64_t a_samples = a->getStats().timers[LogStats::FORMAT_TIME].count;
+        uint64_t b_samples = b->getStats().timers[LogStats::FORMAT_TIME].count;
+        uint64_t c_samples = c->getStats().timers[LogStats::FORMAT_TIME].count;
+        std::cout << "format samples a=" << a_samples << " b=" << b_samples
+                  << " c=" << c_samples << std::endl;
+        ok = ok && a_samples > 0 && b_samples == 0 && c_samples > 0;
+    }
+    auto read_file = [](const char* file) {
+        std::ifstream is(file);
+        return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    };
+    std::string shared_a = read_file("./shared_a_log.txt");
+    bool shared_same = shared_a == read_file("./shared_b_log.txt");
+    int shared_c_lines = count_lines("./shared_c_log.txt");
+    std::cout << "same=" << shared_same << " c lines=" << shared_c_lines << std::endl;
+    ok = ok && shared_same && count_lines("./shared_a_log.txt") == 1000 && shared_c_lines == 1000
+            && read_numbers("./shared_c_log.txt", "SHARED").back() == 999;
+
+    return ok ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+#include "src/log.h"
+
+using namespace orange;
+
+// 当前线程的堆分配次数
+static thread_local uint64_t s_alloc_count = 0;
+
+void* operator new(size_t size) {
+    ++s_alloc_count;
+    void* p = malloc(size ? size : 1);
+    if(!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    ++s_alloc_count;
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+/**
+ * @brief 统计cb执行times次的堆分配次数
+ */
+template<class CB>
+uint64_t count_alloc(int times, CB cb) {
+    // 先预热，让线程级缓冲区和事件池达到稳定状态
+    for(int i = 0; i < 100; ++i) {
+        cb(i);
+    }
+    uint64_t before = s_alloc_count;
+    for(int i = 0; i < times; ++i) {
+        cb(i);
+    }
+    return s_alloc_count - before;
+}
+
+int main(int argc, char** argv) {
+    Logger::ptr logger(new Logger("alloc"));
+    logger->addAppender(LogAppender::ptr(new FileLogAppneder("/dev/null")));
+
+    Logger::ptr asyncLogger(new Logger("alloc_async"));
+    FileLogAppneder::ptr asyncAppender(new FileLogAppneder("/dev/null"));
+    asyncAppender->setAsync(AsyncLogWriter::Config());
+    asyncLogger->addAppender(asyncAppender);
+
+    const std::string long_msg(2000, 'x');
+    const int times = 10000;
+    int failed = 0;
+
+#define XX(name, statement) { \
+        uint64_t n = count_alloc(times, [&](int i) { statement; }); \
+        std::cout << name << ": " << n << " allocations in " << times << " calls" \
+                  << (n ? " FAILED" : " OK") << std::endl; \
+        failed += n ? 1 : 0; \
+    }
+
+    std::cout << "[Test LogEvent alloc]" << std::endl;
+    XX("stream", ORANGE_LOG_INFO(logger) << "Hello orange " << i << " " << 3.14);
+    XX("format", ORANGE_LOG_FMT_INFO(logger, "Hello orange %d %s", i, "Success"));
+    XX("brace format", ORANGE_LOG_FORMAT_INFO(logger, "Hello orange {} {} {{ok}}", i, "Success"));
+    XX("long message", ORANGE_LOG_INFO(logger) << long_msg.c_str() + (i % 10));
+    logger->setLevel(LogLevel::INFO);
+    XX("filtered", ORANGE_LOG_DEBUG(logger) << "filtered " << i);
+    XX("async", ORANGE_LOG_INFO(asyncLogger) << "Hello async orange " << i);
+#undef XX
+
+    asyncAppender->flush();
+    return failed;
+}
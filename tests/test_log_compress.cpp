@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+#include "src/log.h"
+
+using namespace orange;
+
+int main(int argc, char** argv) {
+    std::cout << "[Test log compress]" << std::endl;
+    std::cout << "1.Test compress and read time range" << std::endl;
+    // 100分钟的日志，每秒一行
+    const uint64_t begin = 1700000000;
+    const int seconds = 6000;
+    {
+        std::ofstream os("./compress_log.txt");
+        char buf[64];
+        for(int i = 0; i < seconds; ++i) {
+            time_t t = begin + i;
+            struct tm tm;
+            localtime_r(&t, &tm);
+            strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+            os << "[root][INFO][" << buf << "] compress " << i << " Hello orange Success\n";
+            if(i % 100 == 0) {
+                os << "    continuation line without time\n";
+            }
+        }
+    }
+
+    LogCompressor::Config config;
+    config.frame_size = 16 * 1024;
+    config.cpu_percent = 50;
+    {
+        LogCompressor compressor(config);
+        compressor.submit("./compress_log.txt");
+        compressor.wait();
+    }
+    if(access("./compress_log.txt", F_OK) == 0) {
+        std::cout << "source file not removed" << std::endl;
+        return 1;
+    }
+
+    LogzReader reader;
+    if(!reader.open("./compress_log.txt.olz")) {
+        std::cout << "open compress_log.txt.olz failed" << std::endl;
+        return 1;
+    }
+    std::string out;
+    // 第10分钟开始的10分钟
+    uint64_t count = reader.read(begin + 600, begin + 1199, out);
+    std::cout << "frames=" << reader.getFrameCount() << " inflated=" << reader.getInflated()
+              << " lines=" << count << std::endl;
+    // 600行带时间的日志 + 6行续行
+    if(count != 606 || reader.getInflated() >= reader.getFrameCount()) {
+        return 1;
+    }
+    unlink("./compress_log.txt.olz");
+
+    std::cout << "2.Test rolling file compress" << std::endl;
+    Logger::ptr logger(new Logger());
+    RollingFileLogAppender::Config rolling_config;
+    rolling_config.max_size = 16 * 1024;
+    rolling_config.max_files = 0;
+    rolling_config.compress = true;
+    RollingFileLogAppender::ptr appender(new RollingFileLogAppender("./compress_rolling.txt", rolling_config));
+    logger->addAppender(appender);
+    for(int i = 0; i < 300; ++i) {
+        ORANGE_LOG_FMT_INFO(logger, "ROLLING COMPRESS %d Hello orange %s", i, "Success");
+    }
+    appender->rotate();
+    appender->waitCompress();
+    std::cout << "rolling compress done, see compress_rolling.txt.*.olz" << std::endl;
+
+    std::cout << "3.Test retention with compress" << std::endl;
+    {
+        rolling_config.max_size = 0;
+        rolling_config.max_files = 2;
+        RollingFileLogAppender::ptr retention(new RollingFileLogAppender("./compress_retention.txt", rolling_config));
+        logger->setAppenders(std::vector<LogAppender::ptr>(1, retention));
+        // 连续滚动，压缩器里有排队的原文件时清理不能删掉它们
+        for(int i = 0; i < 6; ++i) {
+            ORANGE_LOG_FMT_INFO(logger, "RETENTION %d Hello orange %s", i, "Success");
+            retention->rotate();
+        }
+        retention->waitCompress();
+    }
+    int olz = 0;
+    int other = 0;
+    DIR* d = opendir(".");
+    struct dirent* dp = nullptr;
+    while(d && (dp = readdir(d))) {
+        const char* name = dp->d_name;
+        if(strncmp(name, "compress_retention.txt.", 23) != 0) {
+            continue;
+        }
+        size_t len = strlen(name);
+        if(len > 4 && strcmp(name + len - 4, ".olz") == 0) {
+            ++olz;
+        } else {
+            ++other;
+        }
+        unlink(name);
+    }
+    if(d) {
+        closedir(d);
+    }
+    unlink("./compress_retention.txt");
+    std::cout << "olz=" << olz << " other=" << other << std::endl;
+    if(olz != 2 || other != 0) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "src/log.h"
+#include "tests/string_log_appender.h"
+
+using namespace orange;
+
+static bool expect(const std::string& actual, const std::string& expected) {
+    std::cout << actual;
+    if(actual != expected) {
+        std::cout << "expected: " << expected;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test log context]" << std::endl;
+
+    std::cout << "1.Test cached thread id" << std::endl;
+    ok = ok && GetThreadId() == syscall(SYS_gettid);
+    pid_t pid = fork();
+    if(pid == 0) {
+        _exit(GetThreadId() == syscall(SYS_gettid) && GetThreadId() == getpid() ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::cout << "child status=" << status << std::endl;
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    std::cout << "2.Test thread name" << std::endl;
+    Logger::ptr logger(new Logger("context"));
+    logger->setFormatter("%N %m%n");
+    StringLogAppender::ptr appender(new StringLogAppender);
+    logger->addAppender(appender);
+    SetThreadName("main_thread");
+    ORANGE_LOG_INFO(logger) << "hello";
+    std::thread worker([logger]() {
+        SetThreadName("worker_with_a_long_name");
+        ORANGE_LOG_INFO(logger) << "from worker";
+    });
+    worker.join();
+    ok = expect(appender->take(), "main_thread hello\nworker_with_a_long_name from worker\n") && ok;
+    char comm[16] = {0};
+    pthread_getname_np(pthread_self(), comm, sizeof(comm));
+    ok = ok && std::string(comm) == "main_thread";
+
+    std::cout << "3.Test MDC" << std::endl;
+    appender->setFormater(LogFormater::ptr(new LogFormater("[%X{request}|%X{user}]%X %m%n")));
+    {
+        MDCGuard request("request", "r-1");
+        ORANGE_LOG_INFO(logger) << "outer";
+        {
+            MDCGuard user("user", "alice smith");
+            MDCGuard shadow("request", "r-2");
+            ORANGE_LOG_INFO(logger) << "inner";
+        }
+        ORANGE_LOG_INFO(logger) << "outer again";
+    }
+    ORANGE_LOG_INFO(logger) << "none";
+    ok = expect(appender->take(), "[r-1|] request=r-1 outer\n"
+                                 "[r-2|alice smith] request=r-1 user=\"alice smith\" request=r-2 inner\n"
+                                 "[r-1|] request=r-1 outer again\n"
+                                 "[|] none\n") && ok;
+
+    std::cout << "4.Test event keeps MDC depth" << std::endl;
+    LogFormater::ptr formater(new LogFormater("%X"));
+    MDCGuard before("a", "1");
+    LogEvent event(logger, LogLevel::INFO, __FILE__, __LINE__, 0, GetThreadId(), GetFiberId(), 0);
+    MDCGuard after("b", "2");
+    std::string buf;
+    formater->render(buf, event);
+    ok = expect(buf + "\n", " a=1\n") && ok;
+    // 其他线程的事件不关联当前线程的上下文
+    LogEvent other(logger, LogLevel::INFO, __FILE__, __LINE__, 0, GetThreadId() + 1, GetFiberId(), 0);
+    ok = ok && other.getThreadContext() == nullptr;
+
+    std::cout << "5.Test json and logfmt" << std::endl;
+    appender->setFormater(LogFormater::ptr(new LogFormater("json")));
+    ORANGE_LOG_INFO(logger) << "structured";
+    std::string json = appender->take();
+    std::cout << json;
+    ok = ok && json.find("\"thread_name\":\"main_thread\"") != std::string::npos
+            && json.find(",\"a\":\"1\",\"b\":\"2\"}") != std::string::npos;
+    appender->setFormater(LogFormater::ptr(new LogFormater("logfmt")));
+    ORANGE_LOG_INFO(logger) << "structured";
+    std::string logfmt = appender->take();
+    std::cout << logfmt;
+    ok = ok && logfmt.find(" thread_name=main_thread ") != std::string::npos
+            && logfmt.find(" a=1 b=2\n") != std::string::npos;
+    return ok ? 0 : 1;
+}
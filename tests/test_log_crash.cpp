@@ -0,0 +1,179 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "src/log.h"
+
+using namespace orange;
+
+static const int LINES = 100;
+static const char* FILES[] = {"./crash_sync.txt", "./crash_async.txt", "./crash_sharded.txt", "./crash_rolling.txt"};
+
+/**
+ * @brief 子进程：各种Appender都只写进缓冲区，然后崩溃
+ */
+static void crashChild(int sig) {
+    struct rlimit rl = {0, 0};
+    setrlimit(RLIMIT_CORE, &rl);
+    LoggerMgrPtr::GetInstance()->installCrashHandler();
+
+    Logger::ptr logger(new Logger("crash"));
+    logger->setFormatter("%p %m%n");
+    FileLogAppneder::ptr sync(new FileLogAppneder(FILES[0]));
+    FileLogAppneder::ptr async(new FileLogAppneder(FILES[1]));
+    AsyncLogWriter::Config async_config;
+    async_config.flush_interval = 60000;
+    async->setAsync(async_config);
+    FileLogAppneder::ptr sharded(new FileLogAppneder(FILES[2]));
+    ShardedLogWriter::Config sharded_config;
+    sharded_config.flush_interval = 60000;
+    sharded->setSharded(sharded_config);
+    RollingFileLogAppender::Config rolling_config;
+    rolling_config.flush_interval = 60000;
+    RollingFileLogAppender::ptr rolling(new RollingFileLogAppender(FILES[3], rolling_config));
+    logger->addAppender(sync);
+    logger->addAppender(async);
+    logger->addAppender(sharded);
+    logger->addAppender(rolling);
+
+    for(int i = 0; i < LINES; ++i) {
+        ORANGE_LOG_INFO(logger) << "line " << i;
+    }
+    if(sig == SIGSEGV) {
+        volatile int* p = nullptr;
+        *p = 1;
+    }
+    abort();
+}
+
+/**
+ * @brief 检查文件中的日志行数和崩溃记录
+ */
+static bool check(const char* file, const std::string& signame) {
+    std::ifstream is(file);
+    std::string line;
+    int lines = 0;
+    bool crash = false;
+    bool frames = false;
+    while(std::getline(is, line)) {
+        if(line.compare(0, 10, "INFO line ") == 0) {
+            if(line != "INFO line " + std::to_string(lines)) {
+                break;
+            }
+            ++lines;
+        } else if(line.find("[crash]\tcaught signal " + signame) != std::string::npos) {
+            crash = true;
+        } else if(crash && line.find("[0x") != std::string::npos) {
+            frames = true;
+        }
+    }
+    std::cout << file << ": lines=" << lines << " crash=" << crash << " backtrace=" << frames << std::endl;
+    return lines == LINES && crash && frames;
+}
+
+/**
+ * @brief 不断递归直到栈溢出
+ */
+static int overflow(int depth) {
+    volatile char buf[1024];
+    buf[0] = (char)depth;
+    // 1G的栈也会先溢出，条件只是让编译器不把它当成无限递归
+    if(depth > (1 << 20)) {
+        return buf[0];
+    }
+    return overflow(depth + 1) + buf[0];
+}
+
+/**
+ * @brief 子进程：安装之后新建的线程先打一条日志，再栈溢出
+ */
+static void overflowChild() {
+    struct rlimit rl = {0, 0};
+    setrlimit(RLIMIT_CORE, &rl);
+    LoggerMgrPtr::GetInstance()->installCrashHandler();
+
+    Logger::ptr logger(new Logger("overflow"));
+    logger->setFormatter("%p %m%n");
+    FileLogAppneder::ptr appender(new FileLogAppneder(FILES[0]));
+    logger->addAppender(appender);
+    std::thread thr([logger]() {
+        for(int i = 0; i < LINES; ++i) {
+            ORANGE_LOG_INFO(logger) << "line " << i;
+        }
+        overflow(0);
+    });
+    thr.join();
+}
+
+static bool testSignal(int sig, const std::string& signame) {
+    for(auto file : FILES) {
+        unlink(file);
+    }
+    pid_t pid = fork();
+    if(pid == 0) {
+        // 崩溃记录也会写到stderr，测试时不需要
+        freopen("/dev/null", "w", stderr);
+        crashChild(sig);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    bool ok = WIFSIGNALED(status) && WTERMSIG(status) == sig;
+    std::cout << "child status=" << status << std::endl;
+    for(auto file : FILES) {
+        ok = check(file, signame) && ok;
+        unlink(file);
+    }
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test log crash]" << std::endl;
+    std::cout << "1.Test drain on SIGSEGV" << std::endl;
+    ok = testSignal(SIGSEGV, "SIGSEGV") && ok;
+
+    std::cout << "2.Test drain on SIGABRT" << std::endl;
+    ok = testSignal(SIGABRT, "SIGABRT") && ok;
+
+    std::cout << "3.Test stack overflow in a logging thread" << std::endl;
+    unlink(FILES[0]);
+    pid_t pid = fork();
+    if(pid == 0) {
+        freopen("/dev/null", "w", stderr);
+        overflowChild();
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::cout << "child status=" << status << std::endl;
+    ok = WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV && check(FILES[0], "SIGSEGV") && ok;
+    unlink(FILES[0]);
+
+    // 没有安装崩溃处理时FATAL也要刷新
+    std::cout << "4.Test FATAL flushes appenders" << std::endl;
+    unlink(FILES[0]);
+    {
+        Logger::ptr logger(new Logger("fatal"));
+        logger->setFormatter("%p %m%n");
+        FileLogAppneder::ptr appender(new FileLogAppneder(FILES[0]));
+        logger->addAppender(appender);
+        ORANGE_LOG_INFO(logger) << "before fatal";
+        ORANGE_LOG_FATAL(logger) << "fatal";
+
+        std::ifstream is(FILES[0]);
+        std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        std::cout << content;
+        // FATAL之后紧跟一条调用栈
+        std::string expect = "INFO before fatal\nFATAL fatal\nFATAL backtrace:\n";
+        ok = ok && content.compare(0, expect.size(), expect) == 0 && content.find("[0x") != std::string::npos;
+    }
+    unlink(FILES[0]);
+    return ok ? 0 : 1;
+}
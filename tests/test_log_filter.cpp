@@ -0,0 +1,206 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <yaml-cpp/yaml.h>
+#include "src/log.h"
+#include "src/log_filter.h"
+#include "src/config.h"
+#include "tests/string_log_appender.h"
+
+using namespace orange;
+
+static uint64_t s_evaluated = 0;
+
+static int expensive(int v) {
+    ++s_evaluated;
+    return v;
+}
+
+static LogFilterRule rule(LogFilterRule::Action action, LogLevel::Level level) {
+    LogFilterRule r;
+    r.action = action;
+    r.level = level;
+    return r;
+}
+
+static bool check(const std::string& name, const std::string& str, const std::string& expect) {
+    std::cout << name << ": " << (str == expect ? "ok" : "failed") << std::endl;
+    if(str != expect) {
+        std::cout << "  got:    " << str << "  expect: " << expect;
+    }
+    return str == expect;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test log filter]" << std::endl;
+    Logger::ptr logger = ORANGE_LOG_NAME("filter");
+    logger->setLevel(LogLevel::INFO);
+    StringLogAppender::ptr appender(new StringLogAppender);
+    appender->setFormater(LogFormater::ptr(new LogFormater("%c %p %m%n")));
+    logger->addAppender(appender);
+    Logger::ptr http = ORANGE_LOG_NAME("filter.net.http");
+    Logger::ptr db = ORANGE_LOG_NAME("filter.db");
+
+    std::cout << "1.Test accept DEBUG for one subsystem" << std::endl;
+    std::vector<LogFilterRule> rules;
+    rules.push_back(rule(LogFilterRule::ACCEPT, LogLevel::DEBUG));
+    rules.back().logger = "filter.net";
+    logger->setFilter(LogFilter::ptr(new LogFilter(rules)));
+    // 只有日志器名称条件时按日志器算出放行级别，宏里只比较级别
+    ok = ok && !http->hasFilter() && !db->hasFilter() && db->getLevel() == LogLevel::INFO;
+    ORANGE_LOG_DEBUG(http) << "http debug " << expensive(1);
+    ORANGE_LOG_DEBUG(db) << "db debug " << expensive(2);
+    ORANGE_LOG_INFO(db) << "db info";
+    // 被过滤的日志不构造LogEvent，参数也不求值
+    ok = check("subsystem", appender->take(),
+               "filter.net.http DEBUG http debug 1\nfilter.db INFO db info\n") && ok;
+    ok = ok && s_evaluated == 1 && db->getStats().filtered() == 1;
+
+    std::cout << "2.Test deny by message" << std::endl;
+    rules.clear();
+    rules.push_back(rule(LogFilterRule::DENY, LogLevel::UNKNOWN));
+    rules.back().message = "heartbeat";
+    rules.back().max_level = LogLevel::INFO;
+    logger->setFilter(LogFilter::ptr(new LogFilter(rules)));
+    ORANGE_LOG_INFO(db) << "heartbeat " << expensive(3);
+    ORANGE_LOG_WARN(db) << "heartbeat late";
+    ORANGE_LOG_INFO(db) << "query done";
+    ORANGE_LOG_DEBUG(db) << "heartbeat debug " << expensive(4);
+    ok = check("message", appender->take(), "filter.db WARN heartbeat late\nfilter.db INFO query done\n") && ok;
+    // 需要消息内容的规则要构造消息，但不格式化
+    ok = ok && s_evaluated == 2;
+
+    std::cout << "3.Test MDC and source file" << std::endl;
+    rules.clear();
+    rules.push_back(rule(LogFilterRule::DENY, LogLevel::UNKNOWN));
+    rules.back().mdc.push_back(std::make_pair("tenant", "test"));
+    rules.push_back(rule(LogFilterRule::ACCEPT, LogLevel::DEBUG));
+    rules.back().mdc.push_back(std::make_pair("user", "*"));
+    rules.back().file = "*tests/test_log_filter.cpp";
+    rules.push_back(rule(LogFilterRule::ACCEPT, LogLevel::DEBUG));
+    rules.back().file = "*other.cpp";
+    logger->setFilter(LogFilter::ptr(new LogFilter(rules)));
+    ORANGE_LOG_DEBUG(db) << "no user";
+    {
+        MDCGuard user("user", "42");
+        ORANGE_LOG_DEBUG(db) << "user debug";
+        MDCGuard tenant("tenant", "test");
+        ORANGE_LOG_ERROR(db) << "test tenant error";
+    }
+    ORANGE_LOG_INFO(db) << "after";
+    ok = check("mdc", appender->take(), "filter.db DEBUG user debug\nfilter.db INFO after\n") && ok;
+
+    std::cout << "4.Test appender filter" << std::endl;
+    logger->setFilter(nullptr);
+    ok = ok && !http->hasFilter();
+    StringLogAppender::ptr audit(new StringLogAppender);
+    audit->setFormater(LogFormater::ptr(new LogFormater("%p %m%n")));
+    audit->setLevel(LogLevel::ERROR);
+    rules.clear();
+    rules.push_back(rule(LogFilterRule::ACCEPT, LogLevel::INFO));
+    rules.back().message = "audit";
+    audit->setFilter(LogFilter::ptr(new LogFilter(rules)));
+    logger->addAppender(audit);
+    ORANGE_LOG_INFO(db) << "audit login";
+    ORANGE_LOG_INFO(db) << "plain";
+    ORANGE_LOG_ERROR(db) << "failed";
+    ok = check("appender", audit->take(), "INFO audit login\nERROR failed\n") && ok;
+    ok = check("other appender", appender->take(),
+               "filter.db INFO audit login\nfilter.db INFO plain\nfilter.db ERROR failed\n") && ok;
+    ok = ok && audit->getStats().filtered() == 1;
+    // 输出日志时替换Appender的过滤器
+    std::atomic<bool> stop(false);
+    std::thread swapper([&audit, &rules, &stop]() {
+        while(!stop.load()) {
+            audit->setFilter(LogFilter::ptr(new LogFilter(rules)));
+            audit->setFilter(nullptr);
+        }
+    });
+    for(int i = 0; i < 10000; ++i) {
+        ORANGE_LOG_INFO(db) << "audit swap " << i;
+    }
+    stop = true;
+    swapper.join();
+    appender->take();
+    audit->take();
+    logger->delAppender(audit);
+
+    std::cout << "5.Test filters from config" << std::endl;
+    LoggerMgrPtr::GetInstance()->init();
+    Config::LoadFromTaml(YAML::Load(
+        "log:\n"
+        "    - name: filter.conf\n"
+        "      level: info\n"
+        "      filters:\n"
+        "          - action: accept\n"
+        "            level: debug\n"
+        "            mdc: {trace: on}\n"
+        "          - action: deny\n"
+        "            logger: filter.conf.noisy\n"
+        "            max_level: warn\n"
+        "      appenders:\n"
+        "          - type: StdoutLogAppender\n"
+        "            formatter: \"%c %p %m%n\"\n"
+        "            filters:\n"
+        "                - action: deny\n"
+        "                  message: secret\n"));
+    Logger::ptr conf = ORANGE_LOG_NAME("filter.conf");
+    Logger::ptr noisy = ORANGE_LOG_NAME("filter.conf.noisy");
+    LogFilter::ptr filter = conf->getFilter();
+    ok = ok && filter && filter->getRules().size() == 2 && conf->hasFilter()
+            && filter->getRules()[0].mdc.size() == 1 && filter->getRules()[1].max_level == LogLevel::WARN;
+    {
+        MDCGuard trace("trace", "on");
+        ORANGE_LOG_DEBUG(conf) << "traced debug";
+        ORANGE_LOG_INFO(conf) << "secret token";
+    }
+    ORANGE_LOG_DEBUG(conf) << "untraced debug";
+    ORANGE_LOG_WARN(noisy) << "noisy warn";
+    ORANGE_LOG_ERROR(noisy) << "noisy error";
+    uint64_t filtered = conf->getStats().filtered() + noisy->getStats().filtered();
+    std::cout << "filtered=" << filtered << std::endl;
+    ok = ok && filtered == 2;
+    Config::LoadFromTaml(YAML::Load("log:\n    - name: filter.conf\n      level: info\n"));
+    ok = ok && !conf->getFilter() && !noisy->hasFilter();
+    // 拼错的动作使整个配置无效，不会当成accept
+    Config::LoadFromTaml(YAML::Load(
+        "log:\n"
+        "    - name: filter.conf\n"
+        "      filters:\n"
+        "          - action: dney\n"
+        "            logger: filter.conf.noisy\n"));
+    ok = ok && !conf->getFilter();
+    LoggerMgrPtr::GetInstance()->delLogger("filter.conf");
+
+    std::cout << "6.Test speed of filtered DEBUG" << std::endl;
+    rules.clear();
+    rules.push_back(rule(LogFilterRule::ACCEPT, LogLevel::DEBUG));
+    rules.back().logger = "filter.net";
+    rules.back().file = "*/net/*";
+    logger->setFilter(LogFilter::ptr(new LogFilter(rules)));
+    const int times = 1000000;
+    // 其他子系统在日志器级别就被排除，同一子系统需要逐条匹配源文件
+#define XX(name, logger) \
+    { \
+        auto begin = std::chrono::steady_clock::now(); \
+        for(int i = 0; i < times; ++i) { \
+            ORANGE_LOG_DEBUG(logger) << "debug " << i; \
+        } \
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / times; \
+        std::cout << name << ": " << ns << "ns/op" << std::endl; \
+    }
+
+    XX("other subsystem", db);
+    XX("same subsystem, other file", http);
+    logger->setFilter(nullptr);
+    XX("no filter", db);
+#undef XX
+    ok = ok && appender->take().empty();
+
+    logger->setAppenders(std::vector<LogAppender::ptr>());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <yaml-cpp/yaml.h>
+#include "src/log.h"
+#include "src/log_escape.h"
+#include "tests/string_log_appender.h"
+
+using namespace orange;
+
+/**
+ * @brief 逐字节的参考实现
+ */
+static size_t FindReference(const std::string& str, bool logfmt) {
+    for(size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = str[i];
+        if(c < 0x20 || c == '"' || c == '\\' || (logfmt && (c == ' ' || c == '='))) {
+            return i;
+        }
+    }
+    return str.size();
+}
+
+/**
+ * @brief 用formatter格式化times条日志，返回每条的平均耗时(纳秒)
+ */
+static double bench(const std::string& pattern, uint64_t times) {
+    Logger::ptr logger(new Logger("bench"));
+    LogFormater::ptr formater(new LogFormater(pattern));
+    LogEvent event(logger, LogLevel::INFO, __FILE__, __LINE__, 0, 1, 0, 0);
+    event.getStream() << "request finished, Hello orange Success, method=GET path=/api/v1/items status=200";
+    std::string buf;
+    auto begin = std::chrono::steady_clock::now();
+    for(uint64_t i = 0; i < times; ++i) {
+        buf.clear();
+        formater->render(buf, event);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / (double)times;
+    std::cout << pattern << ": " << ns << " ns/op" << std::endl;
+    return ns;
+}
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test log json]" << std::endl;
+    std::cout << "1.Test vectorized escape scan" << std::endl;
+    std::mt19937 rng(12345);
+    const char special[] = {'"', '\\', '\n', '\t', ' ', '=', 0x01, 0x1f, 0x20, 0x7f, (char)0x80, (char)0xff};
+    int errors = 0;
+    for(int n = 0; n < 20000; ++n) {
+        std::string str(rng() % 100, 'a');
+        for(auto& c : str) {
+            c = 'a' + rng() % 26;
+        }
+        if(!str.empty() && rng() % 4) {
+            str[rng() % str.size()] = special[rng() % sizeof(special)];
+        }
+        if(FindJsonEscape(str.c_str(), str.size()) != FindReference(str, false)
+                || FindLogfmtQuote(str.c_str(), str.size()) != FindReference(str, true)) {
+            ++errors;
+        }
+    }
+    std::cout << "errors=" << errors << std::endl;
+    ok = ok && errors == 0;
+
+    std::cout << "2.Test json format" << std::endl;
+    Logger::ptr logger(new Logger("json.test"));
+    StringLogAppender::ptr appender(new StringLogAppender);
+    appender->setFormater(LogFormater::ptr(new LogFormater("json")));
+    logger->addAppender(appender);
+    const std::string msg = "say \"hi\"\\ path\nnext\tline \x01 中文";
+    ORANGE_LOG_INFO(logger) << msg << LogKv("user", "bob \"b\"") << LogKv("status", 200)
+                            << LogKv("cost", 1.5) << LogKv("ok", true);
+    std::string str = appender->take();
+    std::cout << str;
+    YAML::Node node = YAML::Load(str);
+    ok = ok && node["msg"].as<std::string>() == msg
+            && node["user"].as<std::string>() == "bob \"b\""
+            && node["status"].as<int>() == 200
+            && node["ok"].as<bool>()
+            && node["logger"].as<std::string>() == "json.test";
+
+    std::cout << "3.Test logfmt format" << std::endl;
+    appender->setFormater(LogFormater::ptr(new LogFormater("logfmt")));
+    ORANGE_LOG_INFO(logger) << msg << LogKv("user", std::string("bob")) << LogKv("empty", "");
+    str = appender->take();
+    std::cout << str;
+    ok = ok && str.find(" user=bob empty=\"\"\n") != std::string::npos;
+
+    // 键不能加引号，非法字节替换为'_'；日志器名称构造时转义好
+    Logger::ptr spaced(new Logger("json test"));
+    spaced->addAppender(appender);
+    ORANGE_LOG_INFO(spaced) << "keys" << LogKv("bad key=\"x\"", 1) << LogKv("", 2);
+    str = appender->take();
+    std::cout << str;
+    ok = ok && str.find(" logger=\"json test\" ") != std::string::npos
+            && str.find(" bad_key__x_=1 _=2\n") != std::string::npos;
+
+    appender->setFormater(LogFormater::ptr(new LogFormater("%p %m%K%n")));
+    ORANGE_LOG_INFO(logger) << "text" << LogKv("id", 7u);
+    str = appender->take();
+    std::cout << str;
+    ok = ok && str == "INFO text id=7\n";
+
+    std::cout << "4.Bench text and structured format" << std::endl;
+    const uint64_t times = argc > 1 ? std::stoull(argv[1]) : 1000000;
+    bench("[%c][%p][%d{%Y-%m-%d %H:%M:%S}.%ms][%f][%l][%t][%F]%T%m%n", times);
+    bench("json", times);
+    bench("logfmt", times);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <yaml-cpp/yaml.h>
+#include "src/log.h"
+#include "src/config.h"
+
+using namespace orange;
+
+/**
+ * @brief 统计输出条数和汇总条数的Appender
+ */
+class CountLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+
+    void reset() { m_count = 0; m_summaries = 0; }
+
+    uint64_t m_count = 0;
+    uint64_t m_summaries = 0;
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {
+        std::string msg = event.getContext();
+        if(msg.compare(0, 10, "suppressed") == 0) {
+            ++m_summaries;
+            std::cout << msg << std::endl;
+        } else {
+            ++m_count;
+        }
+    }
+};
+
+static uint64_t s_evaluated = 0;
+
+static int expensive(int v) {
+    ++s_evaluated;
+    return v;
+}
+
+int main(int argc, char** argv) {
+    Logger::ptr logger(new Logger("limit"));
+    CountLogAppender::ptr appender(new CountLogAppender);
+    logger->addAppender(appender);
+    bool ok = true;
+
+    std::cout << "[Test log limit]" << std::endl;
+    std::cout << "1.Test token bucket" << std::endl;
+    LogLimit limit;
+    limit.rate = 100;
+    limit.burst = 100;
+    limit.summary_interval = 100;
+    logger->setLimit(limit);
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < 1000000; ++i) {
+        ORANGE_LOG_ERROR(logger) << "storm " << expensive(i);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ORANGE_LOG_ERROR(logger) << "storm end";
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << "passed=" << appender->m_count << " summaries=" << appender->m_summaries
+              << " evaluated=" << s_evaluated << " in " << sec << "s" << std::endl;
+    // 突发100条，之后每秒100条
+    ok = ok && appender->m_count <= 100 + sec * 100 + 2 && appender->m_summaries > 0
+            && s_evaluated == appender->m_count - 1;
+
+    std::cout << "2.Test sampling" << std::endl;
+    appender->reset();
+    limit = LogLimit();
+    limit.sample = 10;
+    logger->setLimit(limit);
+    for(int i = 0; i < 1000; ++i) {
+        ORANGE_LOG_FMT_INFO(logger, "sample %d", i);
+    }
+    std::cout << "passed=" << appender->m_count << std::endl;
+    ok = ok && appender->m_count == 100;
+
+    std::cout << "3.Test global limit from config" << std::endl;
+    appender->reset();
+    logger->clearLimit();
+    Config::LoadFromTaml(YAML::Load("log_limit:\n    sample: 4\n"));
+    for(int i = 0; i < 1000; ++i) {
+        ORANGE_LOG_INFO(logger) << "global " << i;
+    }
+    std::cout << "passed=" << appender->m_count << std::endl;
+    ok = ok && appender->m_count == 250;
+
+    Config::LoadFromTaml(YAML::Load("log_limit:\n    sample: 0\n"));
+    appender->reset();
+    for(int i = 0; i < 1000; ++i) {
+        ORANGE_LOG_INFO(logger) << "unlimited " << i;
+    }
+    std::cout << "passed=" << appender->m_count << std::endl;
+    ok = ok && appender->m_count == 1000;
+    return ok ? 0 : 1;
+}
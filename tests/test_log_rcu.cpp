@@ -0,0 +1,133 @@
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <string>
+#include "src/log.h"
+
+using namespace orange;
+
+/**
+ * @brief 只计数的Appender，析构后再被调用说明读到了已回收的集合
+ */
+class CountLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<CountLogAppender> ptr;
+
+    ~CountLogAppender() {
+        m_magic = 0;
+    }
+
+    void log(LogLevel::Level level, const LogEvent& event) override {
+        if(m_magic.load(std::memory_order_relaxed) != MAGIC) {
+            s_errors.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // 检查必须在访问其他成员之前，所以不走 renderAppend()
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {}
+
+    uint64_t getCount() const { return m_count; }
+
+    static std::atomic<uint64_t> s_errors;
+private:
+    static const uint32_t MAGIC = 0x4f52414e;
+    std::atomic<uint32_t> m_magic{MAGIC};
+    std::atomic<uint64_t> m_count{0};
+};
+
+std::atomic<uint64_t> CountLogAppender::s_errors(0);
+
+/**
+ * @brief 在Appender里修改日志器，Logger::log 此时还在读临界区内
+ */
+class ReconfigLogAppender : public LogAppender {
+public:
+
+    /**
+     * @brief 新加的Appender收到的日志条数之和
+     */
+    uint64_t getAddedCount() const {
+        uint64_t count = 0;
+        for(auto& i : m_added) {
+            count += i->getCount();
+        }
+        return count;
+    }
+protected:
+    void append(LogLevel::Level level, const LogEvent& event, const char* data, size_t len) override {
+        Logger* logger = event.getLogger();
+        LoggerMgrPtr::GetInstance()->getLogger("rcu.nested." + std::to_string(m_added.size()));
+        m_added.push_back(CountLogAppender::ptr(new CountLogAppender));
+        logger->addAppender(m_added.back());
+    }
+private:
+    std::vector<CountLogAppender::ptr> m_added;
+};
+
+int main(int argc, char** argv) {
+    const int threads = argc > 1 ? std::stoi(argv[1]) : 8;
+    const int times = argc > 2 ? std::stoi(argv[2]) : 200000;
+
+    Logger::ptr logger(new Logger("rcu"));
+    CountLogAppender::ptr fixed(new CountLogAppender);
+    logger->addAppender(fixed);
+    LoggerMgrPtr::GetInstance()->addLogger(logger);
+
+    std::cout << "[Test rcu] threads=" << threads << " times=" << times << std::endl;
+    std::atomic<bool> running(true);
+    std::atomic<uint64_t> lookup_errors(0);
+
+    // 不断增删Appender和日志器
+    std::thread writer([&]() {
+        uint64_t round = 0;
+        while(running.load(std::memory_order_relaxed)) {
+            CountLogAppender::ptr appender(new CountLogAppender);
+            logger->addAppender(appender);
+            Logger::ptr tmp(new Logger("tmp_" + std::to_string(round % 8)));
+            LoggerMgrPtr::GetInstance()->addLogger(tmp);
+            logger->delAppender(appender);
+            LoggerMgrPtr::GetInstance()->delLogger(tmp->getName());
+            logger->setLevel(round % 2 ? LogLevel::DEBUG : LogLevel::INFO);
+            ++round;
+        }
+        std::cout << "writer rounds: " << round << std::endl;
+    });
+
+    std::vector<std::thread> readers;
+    for(int t = 0; t < threads; ++t) {
+        readers.push_back(std::thread([&]() {
+            for(int i = 0; i < times; ++i) {
+                Logger::ptr l = LoggerMgrPtr::GetInstance()->getLogger("rcu");
+                if(l != logger) {
+                    lookup_errors.fetch_add(1, std::memory_order_relaxed);
+                }
+                ORANGE_LOG_INFO(l) << "rcu " << i;
+            }
+        }));
+    }
+    for(auto& i : readers) {
+        i.join();
+    }
+    running = false;
+    writer.join();
+
+    uint64_t expected = (uint64_t)threads * times;
+    std::cout << "fixed appender: " << fixed->getCount() << ", expected " << expected << std::endl;
+    std::cout << "use after free: " << CountLogAppender::s_errors << std::endl;
+    std::cout << "lookup errors: " << lookup_errors << std::endl;
+    bool ok = fixed->getCount() == expected && CountLogAppender::s_errors == 0 && lookup_errors == 0;
+
+    // 读临界区内的更新推迟回收，不能死锁
+    Logger::ptr nested(new Logger("nested"));
+    std::shared_ptr<ReconfigLogAppender> reconfig(new ReconfigLogAppender);
+    nested->addAppender(reconfig);
+    for(int i = 0; i < 3; ++i) {
+        ORANGE_LOG_INFO(nested) << "nested " << i;
+    }
+    // 每条日志只发给写之前已经存在的Appender: 0 + 1 + 2
+    std::cout << "nested appender records: " << reconfig->getAddedCount() << std::endl;
+    ok = ok && reconfig->getAddedCount() == 3;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#include "src/log.h"
+#include "src/config.h"
+
+using namespace orange;
+
+static const char* CONFIG_INFO =
+    "log:\n"
+    "    - name: reload\n"
+    "      level: INFO\n"
+    "      formatter: \"%m%n\"\n"
+    "      appenders:\n"
+    "          - type: FileLogAppender\n"
+    "            file: ./reload_log.txt\n";
+
+static const char* CONFIG_DEBUG =
+    "log:\n"
+    "    - name: reload\n"
+    "      level: DEBUG\n"
+    "      formatter: \"%m%n\"\n"
+    "      appenders:\n"
+    "          - type: FileLogAppender\n"
+    "            file: ./reload_log.txt\n";
+
+// 异步和同步的Appender交替，每次重新加载都换一个写同一个文件的新实例
+static const char* CONFIG_ASYNC[] = {
+    "log:\n"
+    "    - name: order\n"
+    "      level: INFO\n"
+    "      formatter: \"%m%n\"\n"
+    "      appenders:\n"
+    "          - type: FileLogAppender\n"
+    "            file: ./reload_order.txt\n"
+    "            async: {flush_interval: 1000}\n",
+    "log:\n"
+    "    - name: order\n"
+    "      level: INFO\n"
+    "      formatter: \"%m%n\"\n"
+    "      appenders:\n"
+    "          - type: FileLogAppender\n"
+    "            file: ./reload_order.txt\n"
+};
+
+int main(int argc, char** argv) {
+    const int threads = 4;
+    const int times = 20000;
+    unlink("./reload_log.txt");
+
+    std::cout << "[Test log reload]" << std::endl;
+    std::cout << "1.Test reload while logging" << std::endl;
+    Config::LoadFromTaml(YAML::Load(CONFIG_INFO));
+    Logger* logger = ORANGE_LOG_NAME_CACHED("reload.worker");
+    std::atomic<int> running(threads);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([logger, t, &running]() {
+            for(int i = 0; i < times; ++i) {
+                ORANGE_LOG_INFO(logger) << "info " << t << "-" << i;
+                ORANGE_LOG_DEBUG(logger) << "debug " << t << "-" << i;
+            }
+            --running;
+        }));
+    }
+    int reloads = 0;
+    while(running) {
+        Config::LoadFromTaml(YAML::Load(reloads % 2 ? CONFIG_INFO : CONFIG_DEBUG));
+        ++reloads;
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+    // 移除日志器，释放Appender时写出缓冲
+    Config::LoadFromTaml(YAML::Load("log: []\n"));
+
+    std::ifstream is("./reload_log.txt");
+    std::set<std::string> infos;
+    std::string line;
+    int info_lines = 0;
+    int debug_lines = 0;
+    while(std::getline(is, line)) {
+        if(line.compare(0, 5, "info ") == 0) {
+            ++info_lines;
+            infos.insert(line);
+        } else if(line.compare(0, 6, "debug ") == 0) {
+            ++debug_lines;
+        }
+    }
+    std::cout << "reloads=" << reloads << " info=" << info_lines << " unique=" << infos.size()
+              << " debug=" << debug_lines << std::endl;
+    if(info_lines != threads * times || (int)infos.size() != info_lines) {
+        return 1;
+    }
+
+    std::cout << "2.Test child inherits reloaded level" << std::endl;
+    Config::LoadFromTaml(YAML::Load(CONFIG_DEBUG));
+    std::cout << "level=" << LogLevel::toString(logger->getLevel()) << std::endl;
+    if(logger->getLevel() != LogLevel::DEBUG) {
+        return 1;
+    }
+    Config::LoadFromTaml(YAML::Load(CONFIG_INFO));
+    std::cout << "level=" << LogLevel::toString(logger->getLevel()) << std::endl;
+    if(logger->getLevel() != LogLevel::INFO) {
+        return 1;
+    }
+    unlink("./reload_log.txt");
+
+    std::cout << "3.Test no loss across replaced appenders" << std::endl;
+    unlink("./reload_order.txt");
+    Config::LoadFromTaml(YAML::Load(CONFIG_ASYNC[0]));
+    Logger* order = ORANGE_LOG_NAME_CACHED("order");
+    std::atomic<bool> stop(false);
+    std::thread writer([order, &stop]() {
+        for(int i = 0; !stop || i < 20000; ++i) {
+            ORANGE_LOG_INFO(order) << i;
+        }
+    });
+    for(int i = 1; i <= 20; ++i) {
+        Config::LoadFromTaml(YAML::Load(CONFIG_ASYNC[i % 2]));
+        usleep(1000);
+    }
+    stop = true;
+    writer.join();
+    Config::LoadFromTaml(YAML::Load("log: []\n"));
+    // 新旧Appender之间不保证顺序，但每个序号都恰好写出一次
+    std::ifstream order_file("./reload_order.txt");
+    std::vector<int> seen;
+    while(std::getline(order_file, line)) {
+        seen.push_back(std::stoi(line));
+    }
+    std::sort(seen.begin(), seen.end());
+    bool complete = !seen.empty();
+    for(size_t i = 0; i < seen.size(); ++i) {
+        if(seen[i] != (int)i) {
+            complete = false;
+            break;
+        }
+    }
+    std::cout << "lines=" << seen.size() << " complete=" << complete << std::endl;
+    unlink("./reload_order.txt");
+    return complete && seen.size() >= 20000 ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <unistd.h>
+#include "src/log.h"
+#include "tests/string_log_appender.h"
+
+using namespace orange;
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    const int threads = 4;
+    const int times = 10000;
+
+    std::cout << "[Test log stats]" << std::endl;
+    std::cout << "1.Test counters from several threads" << std::endl;
+    Logger::ptr logger = LoggerMgrPtr::GetInstance()->getLogger("stats.test");
+    logger->setLevel(LogLevel::INFO);
+    logger->setFormatter("%m%n");
+    FileLogAppneder::ptr appender(new FileLogAppneder("./stats_log.txt"));
+    appender->setAsync(AsyncLogWriter::Config());
+    appender->setLevel(LogLevel::WARN);
+    logger->addAppender(appender);
+
+    std::vector<std::thread> workers;
+    for(int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([logger]() {
+            for(int i = 0; i < times; ++i) {
+                ORANGE_LOG_DEBUG(logger) << "debug " << i;
+                ORANGE_LOG_INFO(logger) << "info " << i;
+                ORANGE_LOG_WARN(logger) << "warn " << i;
+            }
+        }));
+    }
+    for(auto& i : workers) {
+        i.join();
+    }
+    appender->flush();
+
+    LogStats::Snapshot ls = logger->getStats();
+    LogStats::Snapshot as = appender->getStats();
+    std::cout << "logger: " << ls.toString() << std::endl;
+    std::cout << "appender: " << as.toString() << std::endl;
+    // 每条warn是"warn "加序号加换行
+    uint64_t bytes = 0;
+    for(int i = 0; i < times; ++i) {
+        bytes += 6 + std::to_string(i).size();
+    }
+    ok = ok && ls.accepted() == (uint64_t)threads * times * 2
+            && ls.filtered() == (uint64_t)threads * times
+            && as.accepted() == (uint64_t)threads * times
+            && as.filtered() == (uint64_t)threads * times
+            && as.bytes() == bytes * threads
+            && as.queue_high_water > 0
+            && as.timers[LogStats::FORMAT_TIME].count > 0
+            && as.timers[LogStats::WRITE_TIME].count > 0;
+
+    std::cout << "2.Test dropped by rate limit" << std::endl;
+    LogLimit limit;
+    limit.sample = 10;
+    logger->setLimit(limit);
+    for(int i = 0; i < 100; ++i) {
+        ORANGE_LOG_WARN(logger) << "sampled " << i;
+    }
+    logger->clearLimit();
+    uint64_t dropped = logger->getStats().dropped();
+    std::cout << "dropped=" << dropped << std::endl;
+    ok = ok && dropped == 90;
+
+    std::cout << "3.Test query from LoggerManager" << std::endl;
+    bool found = false;
+    for(auto& i : LoggerMgrPtr::GetInstance()->getStats()) {
+        if(i.name == "stats.test") {
+            found = i.appenders.size() == 1
+                && i.appenders[0].first == "FileLogAppender:./stats_log.txt"
+                && i.appenders[0].second.accepted() == (uint64_t)threads * times + 10;
+        }
+    }
+    std::cout << LoggerMgrPtr::GetInstance()->dumpStats();
+    ok = ok && found;
+
+    std::cout << "4.Test periodic dump" << std::endl;
+    Logger::ptr dump_logger(new Logger("stats.dump"));
+    StringLogAppender::ptr dump_appender(new StringLogAppender);
+    dump_logger->addAppender(dump_appender);
+    LoggerMgrPtr::GetInstance()->setStatsDump(dump_logger, 50);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    LoggerMgrPtr::GetInstance()->setStatsDump(nullptr, 0);
+    std::string dump = dump_appender->take();
+    std::cout << "dump size=" << dump.size() << std::endl;
+    ok = ok && dump.find("logger stats.test: accepted=") != std::string::npos;
+
+    std::cout << "5.Test disabled logs from more threads than stripes" << std::endl;
+    Logger::ptr many_logger(new Logger("stats.many"));
+    many_logger->setLevel(LogLevel::INFO);
+    StringLogAppender::ptr many_appender(new StringLogAppender);
+    many_logger->addAppender(many_appender);
+    const int many = LogStats::STRIPES + 8;
+    std::atomic<int> arrived(0);
+    std::atomic<int> finished(0);
+    std::vector<std::thread> many_workers;
+    for(int t = 0; t < many; ++t) {
+        many_workers.push_back(std::thread([&]() {
+            // 所有线程同时存活，超过独占条带数的线程共用最后一个条带
+            ++arrived;
+            while(arrived < many) {
+                std::this_thread::yield();
+            }
+            ORANGE_LOG_DEBUG(many_logger) << "debug";
+            ORANGE_LOG_INFO(many_logger) << "info";
+            ++finished;
+            while(finished < many) {
+                std::this_thread::yield();
+            }
+        }));
+    }
+    for(auto& i : many_workers) {
+        i.join();
+    }
+    LogStats::Snapshot ms = many_logger->getStats();
+    std::cout << "many: " << ms.toString() << std::endl;
+    // 共用条带的线程在日志宏被禁用时不计数，写出的记录照常计数
+    ok = ok && ms.accepted() == (uint64_t)many
+            && ms.filtered() > 0
+            && ms.filtered() <= (uint64_t)LogStats::STRIPES - 1;
+
+    appender.reset();
+    logger->setAppenders(std::vector<LogAppender::ptr>());
+    unlink("./stats_log.txt");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <stdlib.h>
+#include "src/log.h"
+
+using namespace orange;
+
+struct Point {
+    int x;
+    int y;
+};
+
+std::ostream& operator<<(std::ostream& os, const Point& p) {
+    return os << "(" << p.x << "," << p.y << ")";
+}
+
+static Logger::ptr s_logger(new Logger("stream"));
+
+static bool check(const std::string& name, const std::string& actual, const std::string& expected) {
+    if(actual != expected) {
+        std::cout << name << ": got \"" << actual << "\" expected \"" << expected << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 同一组值分别写入 LogStream 和 std::ostringstream，结果应该一致
+ */
+#define CHECK_SAME(expr) \
+    do { \
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0); \
+        event.getStream() << expr; \
+        std::ostringstream oss; \
+        oss << expr; \
+        ok = check(#expr, event.getMessage().str(), oss.str()) && ok; \
+    } while(0)
+
+#define CHECK_STR(expr, expected) \
+    do { \
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0); \
+        event.getStream() << expr; \
+        ok = check(#expr, event.getMessage().str(), expected) && ok; \
+    } while(0)
+
+int main(int argc, char** argv) {
+    bool ok = true;
+    std::cout << "[Test log stream]" << std::endl;
+
+    std::cout << "1.Test integers and strings" << std::endl;
+    CHECK_SAME(0 << " " << -1 << " " << 7 << " " << 99 << " " << 100 << " " << -12345);
+    CHECK_SAME(std::numeric_limits<int>::min() << " " << std::numeric_limits<int>::max());
+    CHECK_SAME(std::numeric_limits<long long>::min() << " " << std::numeric_limits<unsigned long long>::max());
+    CHECK_SAME((short)-7 << (unsigned short)65535 << 10u << 11l << 12ul);
+    CHECK_SAME(true << false << 'c' << (unsigned char)'u' << (signed char)'s');
+    CHECK_SAME("literal " << std::string("string ") << (char*)"mutable");
+    CHECK_STR((const char*)nullptr, "(null)");
+    CHECK_STR(LogStringRef("view of part", 4), "view");
+
+    std::cout << "2.Test floating point" << std::endl;
+    CHECK_SAME(0.0 << " " << 1.0 << " " << -2.5 << " " << 100.0 << " " << 1e20 << " " << 1e-7);
+    CHECK_STR(0.1, "0.1");
+    CHECK_STR(3.14159265358979, "3.14159265358979");
+    CHECK_STR(0.1 + 0.2, "0.30000000000000004");
+    CHECK_STR(1.0f / 3, "0.33333334");
+    CHECK_STR(0.1f, "0.1");
+    CHECK_STR(-1234.5678, "-1234.5678");
+    CHECK_STR(0.0001, "0.0001");
+    CHECK_STR(-0.0, "-0");
+    CHECK_STR(2.5f, "2.5");
+    CHECK_STR(std::numeric_limits<double>::infinity(), "inf");
+    double values[] = {1.0 / 3, 2.0 / 3, 1e300, 5e-324, 123456.789, -0.000123};
+    for(double v : values) {
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0);
+        event.getStream() << v;
+        ok = ok && strtod(event.getMessage().str().c_str(), nullptr) == v;
+    }
+
+    std::cout << "3.Test manipulators and custom types" << std::endl;
+    CHECK_SAME(std::hex << 255 << " " << std::dec << 255);
+    CHECK_SAME(std::setw(6) << 42 << "|" << std::setfill('0') << std::setw(4) << 7);
+    CHECK_SAME(std::fixed << std::setprecision(3) << 3.14159 << " " << 2.0);
+    CHECK_SAME(std::boolalpha << true << " " << std::showpos << 5);
+    Point point = {1, 2};
+    CHECK_SAME(point << " " << 3 << std::endl);
+    // 复用的事件恢复默认格式
+    {
+        LogEventWarp warp(s_logger, LogLevel::DEBUG, __FILE__, __LINE__, 0, 0, 0, 0);
+        warp.getStream() << std::hex << std::setprecision(2) << 255;
+    }
+    {
+        LogEventWarp warp(s_logger, LogLevel::DEBUG, __FILE__, __LINE__, 0, 0, 0, 0);
+        warp.getStream() << 255 << " " << 0.125;
+        ok = check("reused event", warp.getEvent()->getMessage().str(), "255 0.125") && ok;
+    }
+    // 旧接口getSS()返回std::ostream，在上面改的格式对后面 LogStream 的输出也生效
+    {
+        LogEventWarp warp(s_logger, LogLevel::DEBUG, __FILE__, __LINE__, 0, 0, 0, 0);
+        std::ostream& os = warp.getSS();
+        warp.getStream() << 10 << " ";
+        os << std::hex;
+        warp.getStream() << 255;
+        ok = check("ostream accessor", warp.getEvent()->getMessage().str(), "10 ff") && ok;
+    }
+
+    std::cout << "4.Test containers" << std::endl;
+    std::vector<int> vec = {1, 2, 3};
+    std::list<std::string> lst = {"a", "b"};
+    std::set<double> st = {0.5, 1.5};
+    std::map<std::string, std::vector<int> > mp = {{"x", {1}}, {"y", {}}};
+    CHECK_STR(vec, "[1, 2, 3]");
+    CHECK_STR(lst, "[a, b]");
+    CHECK_STR(st, "[0.5, 1.5]");
+    CHECK_STR(mp, "{x: [1], y: []}");
+
+    std::cout << "5.Test fields" << std::endl;
+    {
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0);
+        event.getStream() << "login" << LogKv("user", "alice") << LogKv("id", 7);
+        ok = check("fields", event.getMessage().str(), "login") && ok;
+        ok = ok && event.getFields().size() == 2;
+    }
+
+    std::cout << "6.Test {} format" << std::endl;
+    {
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0);
+        event.getStream().format(LogFormatChecked<LogFormatArgCount("user {} cost {}ms {{ok}} {}"), 3>(
+                "user {} cost {}ms {{ok}} {}"), "alice", 1.5, vec);
+        ok = check("format", event.getMessage().str(), "user alice cost 1.5ms {ok} [1, 2, 3]") && ok;
+    }
+    {
+        // 运行时的格式串：多余的参数忽略，缺少参数的占位符原样输出
+        std::string fmt = "a={} b={}";
+        LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0);
+        event.getStream().format(fmt.c_str(), 1, 2, 3).format(" c={} {", 4).format(" d={}");
+        ok = check("runtime format", event.getMessage().str(), "a=1 b=2 c=4 { d={}") && ok;
+    }
+    static_assert(LogFormatArgCount("") == 0, "empty");
+    static_assert(LogFormatArgCount("{}{}{{}}") == 2, "escaped");
+    static_assert(LogFormatArgCount("{x}") == -1, "invalid");
+    static_assert(LogFormatArgCount("}") == -1, "single brace");
+    {
+        Logger::ptr logger(new Logger("format"));
+        logger->setFormatter("%m%n");
+        FileLogAppneder::ptr appender(new FileLogAppneder("./format_log.txt"));
+        logger->addAppender(appender);
+        ORANGE_LOG_FORMAT_INFO(logger, "no args");
+        ORANGE_LOG_FORMAT_INFO(logger, "{} + {} = {}", 1, 2, 1 + 2);
+        ORANGE_LOG_FMT_INFO(logger, "%s %d", "printf", 42);
+        appender->flush();
+        std::ifstream is("./format_log.txt");
+        std::string content((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        ok = check("macro", content, "no args\n1 + 2 = 3\nprintf 42\n") && ok;
+        remove("./format_log.txt");
+    }
+
+    std::cout << "7.Test speed" << std::endl;
+    // 同一个事件、同一个缓冲区，只比较 LogStream 和std::ostream的转换，每1024次清空一次内容
+    const int times = 1000000;
+    std::string name = "orange";
+    LogEvent event(s_logger, LogLevel::INFO, __FILE__, __LINE__, 0, 0, 0, 0);
+    auto begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < times; ++i) {
+        if(i % 1024 == 0) {
+            event.reset(s_logger.get(), LogLevel::INFO, __FILE__, __LINE__, 1, 0, 0, 1);
+        }
+        event.getStream() << "request " << i << " user " << name << " cost " << i * 0.5;
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for(int i = 0; i < times; ++i) {
+        if(i % 1024 == 0) {
+            event.reset(s_logger.get(), LogLevel::INFO, __FILE__, __LINE__, 1, 0, 0, 1);
+        }
+        event.getSS() << "request " << i << " user " << name << " cost " << i * 0.5;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double stream_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(middle - begin).count() / (double)times;
+    double ostream_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - middle).count() / (double)times;
+    std::cout << "LogStream: " << stream_ns << "ns std::ostream: " << ostream_ns << "ns" << std::endl;
+
+    std::cout << (ok ? "OK" : "FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
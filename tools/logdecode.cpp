@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+#include "src/binlog.h"
+
+using namespace orange;
+
+/**
+ * @brief 把二进制日志文件还原成文本
+ * @details 用法: orange_logdecode <binlog文件> [日志格式]
+ *          日志格式与 LogFormater 相同，默认与 Logger 的默认格式一致
+ */
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <binlog file> [pattern]" << std::endl;
+        return 1;
+    }
+
+    std::string pattern = argc > 2 ? argv[2] : "[%c][%p][%d{%Y-%m-%d %H:%M:%S}.%ms][%f][%l][%t][%F]%T%m%n";
+    LogFormater formater(pattern);
+    if(formater.isError()) {
+        std::cerr << "invalid pattern: " << pattern << std::endl;
+        return 1;
+    }
+
+    BinLogReader reader;
+    if(!reader.open(argv[1])) {
+        std::cerr << "open " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+
+    std::string buf;
+    const LogEvent* event = nullptr;
+    while((event = reader.next())) {
+        buf.clear();
+        formater.render(buf, *event);
+        std::cout.write(buf.c_str(), buf.size());
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <iostream>
+#include <string>
+#include "src/log_compress.h"
+
+using namespace orange;
+
+/**
+ * @brief 解压压缩日志文件中指定时间范围内的日志
+ * @details 用法: orange_logzcat <压缩文件> ["开始时间"] ["结束时间"]
+ *          时间格式为 %Y-%m-%d %H:%M:%S，省略时不限制
+ */
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.olz> [\"begin time\"] [\"end time\"]" << std::endl;
+        return 1;
+    }
+
+    uint64_t begin = 0;
+    uint64_t end = UINT64_MAX;
+    if(argc > 2 && !(begin = logz::ParseTime(argv[2], std::string(argv[2]).size()))) {
+        std::cerr << "invalid begin time: " << argv[2] << std::endl;
+        return 1;
+    }
+    if(argc > 3 && !(end = logz::ParseTime(argv[3], std::string(argv[3]).size()))) {
+        std::cerr << "invalid end time: " << argv[3] << std::endl;
+        return 1;
+    }
+
+    LogzReader reader;
+    if(!reader.open(argv[1])) {
+        std::cerr << "open " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    std::string out;
+    reader.read(begin, end, out);
+    std::cout.write(out.c_str(), out.size());
+    std::cerr << "inflated " << reader.getInflated() << "/" << reader.getFrameCount() << " frames" << std::endl;
+    return 0;
+}